@@ -3340,6 +3340,70 @@ static void test_deleted_key(void)
     setup_main_key();
 }
 
+static void check_key_lookups(HKEY hkey, const char *path, unsigned int depth, unsigned int *count)
+{
+    static WCHAR name[16384];
+    DWORD i, len;
+    HKEY subkey;
+    LONG res;
+
+    for (i = 0;; i++)
+    {
+        len = ARRAY_SIZE(name);
+        if ((res = RegEnumValueW( hkey, i, name, &len, NULL, NULL, NULL, NULL ))) break;
+        res = RegQueryValueExW( hkey, name, NULL, NULL, NULL, NULL );
+        ok(!res, "%s: value %s not found, res %d\n", path, wine_dbgstr_w(name), res);
+    }
+    ok(res == ERROR_NO_MORE_ITEMS, "%s: RegEnumValueW failed, res %d\n", path, res);
+
+    for (i = 0; *count < 5000; i++)
+    {
+        len = ARRAY_SIZE(name);
+        if ((res = RegEnumKeyExW( hkey, i, name, &len, NULL, NULL, NULL, NULL ))) break;
+        ++*count;
+        res = RegOpenKeyExW( hkey, name, 0, KEY_READ, &subkey );
+        if (res == ERROR_ACCESS_DENIED) continue;
+        ok(!res, "%s: subkey %s not found, res %d\n", path, wine_dbgstr_w(name), res);
+        if (res) continue;
+        if (depth) check_key_lookups( subkey, path, depth - 1, count );
+        RegCloseKey( subkey );
+    }
+    ok(!res || res == ERROR_NO_MORE_ITEMS, "%s: RegEnumKeyExW failed, res %d\n", path, res);
+}
+
+static void test_loaded_key_lookups(void)
+{
+    /* The keys and values are looked up by a binary search on their name,
+     * so the hives loaded at startup have to be sorted the same way; check
+     * that everything that is enumerated can also be found by its name. */
+    static const struct
+    {
+        HKEY root;
+        const char *path;
+    }
+    tests[] =
+    {
+        { HKEY_LOCAL_MACHINE, "Software\\Microsoft" },
+        { HKEY_LOCAL_MACHINE, "System\\CurrentControlSet\\Control" },
+        { HKEY_CURRENT_USER, "Software" },
+        { HKEY_CURRENT_USER, "Control Panel" },
+    };
+    unsigned int i, count;
+    HKEY hkey;
+    LONG res;
+
+    for (i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        res = RegOpenKeyExA( tests[i].root, tests[i].path, 0, KEY_READ, &hkey );
+        ok(!res, "%s: RegOpenKeyExA failed, res %d\n", tests[i].path, res);
+        if (res) continue;
+        count = 0;
+        check_key_lookups( hkey, tests[i].path, 3, &count );
+        ok(count, "%s: no subkeys found\n", tests[i].path);
+        RegCloseKey( hkey );
+    }
+}
+
 static void test_delete_value(void)
 {
     LONG res;
@@ -4508,6 +4572,7 @@ START_TEST(registry)
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
+    test_loaded_key_lookups();
     test_RegOpenCurrentUser();
     test_RegNotifyChangeKeyValue();
     test_performance_keys();
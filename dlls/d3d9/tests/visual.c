@@ -21039,6 +21039,190 @@ done:
     DestroyWindow(window);
 }
 
+static void test_converted_format_rows(void)
+{
+    /* Wined3d converts these formats on upload when the GL implementation
+     * can't use them directly. Rows are converted a vector at a time as far
+     * as possible, and the remaining texels one at a time. A 64 texel wide
+     * texture goes through the vector code, a 2 texel wide one only through
+     * the per-texel code, so drawing the same texels from both textures has
+     * to give exactly the same colors. */
+    static const struct
+    {
+        D3DFORMAT format;
+        const char *name;
+        unsigned int texel_size;
+    }
+    formats[] =
+    {
+        {D3DFMT_A4L4,     "D3DFMT_A4L4",     sizeof(BYTE)},
+        {D3DFMT_L6V5U5,   "D3DFMT_L6V5U5",   sizeof(WORD)},
+        {D3DFMT_X8L8V8U8, "D3DFMT_X8L8V8U8", sizeof(DWORD)},
+        {D3DFMT_Q8W8V8U8, "D3DFMT_Q8W8V8U8", sizeof(DWORD)},
+    };
+    static const DWORD shader_code[] =
+    {
+        0xffff0101,                                                             /* ps_1_1                     */
+        0x00000051, 0xa00f0000, 0x3f000000, 0x3f000000, 0x3f000000, 0x3f000000, /* def c0, 0.5, 0.5, 0.5, 0.5 */
+        0x00000042, 0xb00f0000,                                                 /* tex t0                     */
+        0x00000004, 0x800f0000, 0xb0e40000, 0xa0e40000, 0xa0e40000,             /* mad r0, t0, c0, c0         */
+        0x0000ffff                                                              /* end                        */
+    };
+    static const DWORD shader_code_alpha[] =
+    {
+        0xffff0101,                                                             /* ps_1_1                     */
+        0x00000051, 0xa00f0000, 0x3f000000, 0x3f000000, 0x3f000000, 0x3f000000, /* def c0, 0.5, 0.5, 0.5, 0.5 */
+        0x00000042, 0xb00f0000,                                                 /* tex t0                     */
+        0x00000004, 0x800f0000, 0xb0ff0000, 0xa0e40000, 0xa0e40000,             /* mad r0, t0.a, c0, c0       */
+        0x0000ffff                                                              /* end                        */
+    };
+    static const struct
+    {
+        struct vec4 position;
+        struct vec2 texcrd;
+    }
+    wide_quad[] =
+    {
+        {{-0.5f, -0.5f, 0.0f, 1.0f}, {0.0f, 0.0f}},
+        {{63.5f, -0.5f, 0.0f, 1.0f}, {1.0f, 0.0f}},
+        {{-0.5f,  0.5f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+        {{63.5f,  0.5f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+    },
+    narrow_quad[] =
+    {
+        {{-0.5f,  9.5f, 0.0f, 1.0f}, {0.0f, 0.0f}},
+        {{ 1.5f,  9.5f, 0.0f, 1.0f}, {1.0f, 0.0f}},
+        {{-0.5f, 41.5f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+        {{ 1.5f, 41.5f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+    };
+    IDirect3DTexture9 *wide_texture, *narrow_texture;
+    IDirect3DPixelShader9 *shaders[2];
+    struct surface_readback rb;
+    D3DLOCKED_RECT locked_rect;
+    IDirect3DSurface9 *rt;
+    IDirect3DDevice9 *device;
+    unsigned int i, j, x, y;
+    D3DCOLOR wide, narrow;
+    BYTE content[64 * 4];
+    IDirect3D9 *d3d;
+    ULONG refcount;
+    D3DCAPS9 caps;
+    HWND window;
+    HRESULT hr;
+
+    window = create_window();
+    d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    ok(!!d3d, "Failed to create a D3D object.\n");
+    if (!(device = create_device(d3d, window, window, TRUE)))
+    {
+        skip("Failed to create a D3D device, skipping tests.\n");
+        IDirect3D9_Release(d3d);
+        DestroyWindow(window);
+        return;
+    }
+
+    hr = IDirect3DDevice9_GetDeviceCaps(device, &caps);
+    ok(SUCCEEDED(hr), "Failed to get device caps, hr %#x.\n", hr);
+    if (caps.PixelShaderVersion < D3DPS_VERSION(1, 1))
+    {
+        skip("Pixel shaders not supported, skipping converted format test.\n");
+        goto done;
+    }
+
+    hr = IDirect3DDevice9_GetRenderTarget(device, 0, &rt);
+    ok(SUCCEEDED(hr), "Failed to get render target, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetRenderState(device, D3DRS_ZENABLE, D3DZB_FALSE);
+    ok(SUCCEEDED(hr), "Failed to set render state, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZRHW | D3DFVF_TEX1);
+    ok(SUCCEEDED(hr), "Failed to set FVF, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_CreatePixelShader(device, shader_code, &shaders[0]);
+    ok(SUCCEEDED(hr), "Failed to create pixel shader, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_CreatePixelShader(device, shader_code_alpha, &shaders[1]);
+    ok(SUCCEEDED(hr), "Failed to create pixel shader, hr %#x.\n", hr);
+
+    /* Every byte value shows up somewhere, in every position of a texel. */
+    for (i = 0; i < ARRAY_SIZE(content); ++i)
+        content[i] = i * 167 + (i >> 6) * 29;
+
+    for (i = 0; i < ARRAY_SIZE(formats); ++i)
+    {
+        winetest_push_context("%s", formats[i].name);
+
+        hr = IDirect3D9_CheckDeviceFormat(d3d, D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL,
+                D3DFMT_X8R8G8B8, 0, D3DRTYPE_TEXTURE, formats[i].format);
+        if (FAILED(hr))
+        {
+            skip("Format not supported, skipping.\n");
+            winetest_pop_context();
+            continue;
+        }
+
+        hr = IDirect3DDevice9_CreateTexture(device, 64, 1, 1, 0,
+                formats[i].format, D3DPOOL_MANAGED, &wide_texture, NULL);
+        ok(SUCCEEDED(hr), "Failed to create texture, hr %#x.\n", hr);
+        hr = IDirect3DTexture9_LockRect(wide_texture, 0, &locked_rect, NULL, 0);
+        ok(SUCCEEDED(hr), "Failed to lock texture, hr %#x.\n", hr);
+        memcpy(locked_rect.pBits, content, 64 * formats[i].texel_size);
+        hr = IDirect3DTexture9_UnlockRect(wide_texture, 0);
+        ok(SUCCEEDED(hr), "Failed to unlock texture, hr %#x.\n", hr);
+
+        hr = IDirect3DDevice9_CreateTexture(device, 2, 32, 1, 0,
+                formats[i].format, D3DPOOL_MANAGED, &narrow_texture, NULL);
+        ok(SUCCEEDED(hr), "Failed to create texture, hr %#x.\n", hr);
+        hr = IDirect3DTexture9_LockRect(narrow_texture, 0, &locked_rect, NULL, 0);
+        ok(SUCCEEDED(hr), "Failed to lock texture, hr %#x.\n", hr);
+        for (y = 0; y < 32; ++y)
+            memcpy((BYTE *)locked_rect.pBits + y * locked_rect.Pitch,
+                    content + y * 2 * formats[i].texel_size, 2 * formats[i].texel_size);
+        hr = IDirect3DTexture9_UnlockRect(narrow_texture, 0);
+        ok(SUCCEEDED(hr), "Failed to unlock texture, hr %#x.\n", hr);
+
+        for (j = 0; j < ARRAY_SIZE(shaders); ++j)
+        {
+            hr = IDirect3DDevice9_SetPixelShader(device, shaders[j]);
+            ok(SUCCEEDED(hr), "Failed to set pixel shader, hr %#x.\n", hr);
+
+            hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0x00330033, 0.0f, 0);
+            ok(SUCCEEDED(hr), "Failed to clear, hr %#x.\n", hr);
+            hr = IDirect3DDevice9_BeginScene(device);
+            ok(SUCCEEDED(hr), "Failed to begin scene, hr %#x.\n", hr);
+            hr = IDirect3DDevice9_SetTexture(device, 0, (IDirect3DBaseTexture9 *)wide_texture);
+            ok(SUCCEEDED(hr), "Failed to set texture, hr %#x.\n", hr);
+            hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, wide_quad, sizeof(*wide_quad));
+            ok(SUCCEEDED(hr), "Failed to draw, hr %#x.\n", hr);
+            hr = IDirect3DDevice9_SetTexture(device, 0, (IDirect3DBaseTexture9 *)narrow_texture);
+            ok(SUCCEEDED(hr), "Failed to set texture, hr %#x.\n", hr);
+            hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, narrow_quad, sizeof(*narrow_quad));
+            ok(SUCCEEDED(hr), "Failed to draw, hr %#x.\n", hr);
+            hr = IDirect3DDevice9_EndScene(device);
+            ok(SUCCEEDED(hr), "Failed to end scene, hr %#x.\n", hr);
+
+            get_rt_readback(rt, &rb);
+            for (x = 0; x < 64; ++x)
+            {
+                wide = get_readback_color(&rb, x, 0);
+                narrow = get_readback_color(&rb, x % 2, 10 + x / 2);
+                ok(wide == narrow, "Got color 0x%08x, expected 0x%08x, shader %u, texel %u.\n",
+                        wide, narrow, j, x);
+            }
+            release_surface_readback(&rb);
+        }
+
+        IDirect3DTexture9_Release(narrow_texture);
+        IDirect3DTexture9_Release(wide_texture);
+        winetest_pop_context();
+    }
+
+    IDirect3DPixelShader9_Release(shaders[1]);
+    IDirect3DPixelShader9_Release(shaders[0]);
+    IDirect3DSurface9_Release(rt);
+done:
+    refcount = IDirect3DDevice9_Release(device);
+    ok(!refcount, "Device has %u references left.\n", refcount);
+    IDirect3D9_Release(d3d);
+    DestroyWindow(window);
+}
+
 static void test_multisample_mismatch(void)
 {
     IDirect3DDevice9 *device;
@@ -27542,11 +27726,296 @@ static void test_filling_convention(void)
     DestroyWindow(window);
 }
 
+/* Runs in a child process, with the Wine shader cache enabled through the
+ * application's Direct3D settings. */
+static void shader_cache_child(void)
+{
+    IDirect3DVertexShader9 *vs;
+    IDirect3DPixelShader9 *ps;
+    IDirect3DDevice9 *device;
+    IDirect3D9 *d3d;
+    ULONG refcount;
+    D3DCOLOR color;
+    HWND window;
+    HRESULT hr;
+
+    static const DWORD vs_code[] =
+    {
+        0xfffe0101,                                 /* vs_1_1         */
+        0x0000001f, 0x80000000, 0x900f0000,         /* dcl_position v0 */
+        0x0000001f, 0x8000000a, 0x900f0001,         /* dcl_color0 v1  */
+        0x00000001, 0xc00f0000, 0x90e40000,         /* mov oPos, v0   */
+        0x00000001, 0xd00f0000, 0x90e40001,         /* mov oD0, v1    */
+        0x0000ffff
+    };
+    static const DWORD ps_code[] =
+    {
+        0xffff0200,                                                             /* ps_2_0                     */
+        0x05000051, 0xa00f0000, 0x3f800000, 0x00000000, 0x3f000000, 0x00000000, /* def c0, 1.0, 0.0, 0.5, 0.0 */
+        0x0200001f, 0x80000000, 0x900f0000,                                     /* dcl v0                     */
+        0x03000002, 0x800f0800, 0x90e40000, 0xa0e40000,                         /* add oC0, v0, c0            */
+        0x0000ffff
+    };
+    static const struct
+    {
+        struct vec3 position;
+        DWORD diffuse;
+    }
+    quad[] =
+    {
+        {{-1.0f, -1.0f, 0.0f}, 0xff00ff00},
+        {{-1.0f,  1.0f, 0.0f}, 0xff00ff00},
+        {{ 1.0f, -1.0f, 0.0f}, 0xff00ff00},
+        {{ 1.0f,  1.0f, 0.0f}, 0xff00ff00},
+    };
+
+    window = create_window();
+    d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    ok(!!d3d, "Failed to create a D3D object.\n");
+    device = create_device(d3d, window, window, TRUE);
+    ok(!!device, "Failed to create a D3D device.\n");
+    if (!device)
+        goto done;
+
+    hr = IDirect3DDevice9_CreateVertexShader(device, vs_code, &vs);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_CreatePixelShader(device, ps_code, &ps);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetVertexShader(device, vs);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetPixelShader(device, ps);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+    hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xff0000ff, 1.0f, 0);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_BeginScene(device);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad, sizeof(*quad));
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = IDirect3DDevice9_EndScene(device);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+    color = getPixelColor(device, 320, 240);
+    ok(color_match(color, 0x00ffff80, 1), "Got unexpected color 0x%08x.\n", color);
+
+    IDirect3DPixelShader9_Release(ps);
+    IDirect3DVertexShader9_Release(vs);
+    refcount = IDirect3DDevice9_Release(device);
+    ok(!refcount, "Device has %u references left.\n", refcount);
+done:
+    IDirect3D9_Release(d3d);
+    DestroyWindow(window);
+}
+
+struct shader_cache_entry
+{
+    char name[MAX_PATH];
+    BY_HANDLE_FILE_INFORMATION info;
+};
+
+/* Returns the number of entries in the cache directory. If "write_time" is
+ * not NULL, the last write time of the entries is set to it. */
+static unsigned int get_shader_cache_entries(const char *path, struct shader_cache_entry *entries,
+        unsigned int max_count, const FILETIME *write_time)
+{
+    char pattern[MAX_PATH], file_name[MAX_PATH];
+    struct shader_cache_entry *entry;
+    WIN32_FIND_DATAA data;
+    unsigned int count = 0;
+    HANDLE find, file;
+    BOOL ret;
+
+    sprintf(pattern, "%s\\*.bin", path);
+    if ((find = FindFirstFileA(pattern, &data)) == INVALID_HANDLE_VALUE)
+        return 0;
+    do
+    {
+        if (count++ >= max_count)
+            continue;
+        entry = &entries[count - 1];
+        strcpy(entry->name, data.cFileName);
+        memset(&entry->info, 0, sizeof(entry->info));
+        sprintf(file_name, "%s\\%s", path, data.cFileName);
+        file = CreateFileA(file_name, FILE_READ_ATTRIBUTES | FILE_WRITE_ATTRIBUTES,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+        ok(file != INVALID_HANDLE_VALUE, "Failed to open %s, error %u.\n", file_name, GetLastError());
+        if (file == INVALID_HANDLE_VALUE)
+            continue;
+        if (write_time)
+        {
+            ret = SetFileTime(file, NULL, NULL, write_time);
+            ok(ret, "Failed to set file time, error %u.\n", GetLastError());
+        }
+        ret = GetFileInformationByHandle(file, &entry->info);
+        ok(ret, "Failed to get file information, error %u.\n", GetLastError());
+        CloseHandle(file);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+
+    return count;
+}
+
+static void delete_shader_cache(const char *path)
+{
+    char pattern[MAX_PATH], file[MAX_PATH];
+    WIN32_FIND_DATAA data;
+    HANDLE find;
+
+    sprintf(pattern, "%s\\*", path);
+    if ((find = FindFirstFileA(pattern, &data)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+            sprintf(file, "%s\\%s", path, data.cFileName);
+            DeleteFileA(file);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+    RemoveDirectoryA(path);
+}
+
+static void test_shader_cache(void)
+{
+    /* 1 January 2000, older than anything the cache could write. */
+    static const FILETIME old_time = {0x256d4000, 0x01bf53eb};
+    char cache_path[MAX_PATH], exe_path[MAX_PATH], key_name[MAX_PATH + 64], cmdline[MAX_PATH + 32];
+    struct shader_cache_entry entries[64], first_entries[64];
+    unsigned int count, first_count = 0, i, j, k;
+    STARTUPINFOA si = {sizeof(si)};
+    PROCESS_INFORMATION pi;
+    DWORD disposition, size;
+    IDirect3DDevice9 *device;
+    const char *name, *p;
+    IDirect3D9 *d3d;
+    D3DCAPS9 caps;
+    HWND window;
+    HRESULT hr;
+    char **argv;
+    LONG error;
+    HKEY key;
+    BOOL ret;
+
+    if (strcmp(winetest_platform, "wine"))
+    {
+        skip("The shader cache is specific to Wine.\n");
+        return;
+    }
+
+    window = create_window();
+    d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    ok(!!d3d, "Failed to create a D3D object.\n");
+    if (!(device = create_device(d3d, window, window, TRUE)))
+    {
+        skip("Failed to create a D3D device, skipping tests.\n");
+        IDirect3D9_Release(d3d);
+        DestroyWindow(window);
+        return;
+    }
+    hr = IDirect3DDevice9_GetDeviceCaps(device, &caps);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    IDirect3DDevice9_Release(device);
+    IDirect3D9_Release(d3d);
+    DestroyWindow(window);
+    if (caps.VertexShaderVersion < D3DVS_VERSION(1, 1) || caps.PixelShaderVersion < D3DPS_VERSION(2, 0))
+    {
+        skip("No shader model 2 support, skipping tests.\n");
+        return;
+    }
+
+    GetTempPathA(ARRAY_SIZE(cache_path), cache_path);
+    sprintf(cache_path + strlen(cache_path), "d3d9_shader_cache_%x", GetCurrentProcessId());
+
+    GetModuleFileNameA(NULL, exe_path, ARRAY_SIZE(exe_path));
+    name = exe_path;
+    if ((p = strrchr(name, '/')))
+        name = p + 1;
+    if ((p = strrchr(name, '\\')))
+        name = p + 1;
+    sprintf(key_name, "Software\\Wine\\AppDefaults\\%s\\Direct3D", name);
+    error = RegCreateKeyExA(HKEY_CURRENT_USER, key_name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, &disposition);
+    ok(!error, "Failed to create key, error %d.\n", error);
+    if (error)
+        return;
+    size = 16;
+    error = RegSetValueExA(key, "shader_cache_size", 0, REG_DWORD, (BYTE *)&size, sizeof(size));
+    ok(!error, "Failed to set value, error %d.\n", error);
+    error = RegSetValueExA(key, "shader_cache_path", 0, REG_SZ, (BYTE *)cache_path, strlen(cache_path) + 1);
+    ok(!error, "Failed to set value, error %d.\n", error);
+
+    /* The first run stores the shaders, the second one renders with the
+     * cached shaders. Loading an entry updates its last write time, storing
+     * one replaces the file, so the second run should update the write time
+     * of every entry without adding or rewriting any. */
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" visual shader_cache", argv[0]);
+    for (i = 0; i < 2; ++i)
+    {
+        ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+        ok(ret, "Failed to create process, error %u.\n", GetLastError());
+        if (!ret)
+            break;
+        wait_child_process(pi.hProcess);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+
+        count = get_shader_cache_entries(cache_path, entries, ARRAY_SIZE(entries), i ? NULL : &old_time);
+        ok(count <= ARRAY_SIZE(entries), "Got unexpected entry count %u.\n", count);
+        count = min(count, ARRAY_SIZE(entries));
+        if (!i)
+        {
+            ok(count, "No shader cache entries were stored.\n");
+            memcpy(first_entries, entries, count * sizeof(*entries));
+            first_count = count;
+            continue;
+        }
+
+        ok(count == first_count, "Got %u entries, expected %u.\n", count, first_count);
+        for (j = 0; j < count; ++j)
+        {
+            for (k = 0; k < first_count; ++k)
+            {
+                if (!strcmp(entries[j].name, first_entries[k].name))
+                    break;
+            }
+            ok(k < first_count, "Entry %s was added.\n", entries[j].name);
+            if (k == first_count)
+                continue;
+            ok(entries[j].info.nFileIndexHigh == first_entries[k].info.nFileIndexHigh
+                    && entries[j].info.nFileIndexLow == first_entries[k].info.nFileIndexLow,
+                    "Entry %s was rewritten.\n", entries[j].name);
+            ok(CompareFileTime(&entries[j].info.ftLastWriteTime, &old_time) > 0,
+                    "Entry %s wasn't loaded.\n", entries[j].name);
+        }
+    }
+
+    RegDeleteValueA(key, "shader_cache_size");
+    RegDeleteValueA(key, "shader_cache_path");
+    RegCloseKey(key);
+    if (disposition == REG_CREATED_NEW_KEY)
+        RegDeleteKeyA(HKEY_CURRENT_USER, key_name);
+    delete_shader_cache(cache_path);
+}
+
 START_TEST(visual)
 {
     D3DADAPTER_IDENTIFIER9 identifier;
     IDirect3D9 *d3d;
+    char **argv;
     HRESULT hr;
+    int argc;
+
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 3 && !strcmp(argv[2], "shader_cache"))
+    {
+        shader_cache_child();
+        return;
+    }
 
     if (!(d3d = Direct3DCreate9(D3D_SDK_VERSION)))
     {
@@ -27660,6 +28129,7 @@ START_TEST(visual)
     test_position_index();
     test_table_fog_zw();
     test_signed_formats();
+    test_converted_format_rows();
     test_multisample_mismatch();
     test_texcoordindex();
     test_vertex_blending();
@@ -27692,4 +28162,5 @@ START_TEST(visual)
     test_sample_mask();
     test_dynamic_map_synchronization();
     test_filling_convention();
+    test_shader_cache();
 }
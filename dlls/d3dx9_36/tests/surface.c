@@ -1524,6 +1524,87 @@ static void test_D3DXLoadSurface(IDirect3DDevice9 *device)
     if(testbitmap_ok) DeleteFileA("testbitmap.bmp");
 }
 
+static BOOL compare_color(DWORD c1, DWORD c2, BYTE max_diff)
+{
+    unsigned int i;
+
+    for (i = 0; i < 32; i += 8)
+    {
+        if (abs((int)((c1 >> i) & 0xff) - (int)((c2 >> i) & 0xff)) > max_diff)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void test_dxt_compression(IDirect3DDevice9 *device)
+{
+    static const D3DFORMAT formats[] = {D3DFMT_DXT1, D3DFMT_DXT3, D3DFMT_DXT5};
+    /* Large enough for the compression to be split across threads. */
+    static const unsigned int size = 512;
+    IDirect3DSurface9 *surface, *decoded;
+    D3DLOCKED_RECT lockrect;
+    IDirect3DTexture9 *tex;
+    unsigned int i, x, y;
+    DWORD *data, color;
+    HRESULT hr;
+    RECT rect;
+
+    data = HeapAlloc(GetProcessHeap(), 0, size * size * sizeof(*data));
+    /* Each 4x4 block has a single color, so that the compressed result only
+     * differs from the source by the quantisation to 5:6:5 bits. */
+    for (y = 0; y < size; ++y)
+    {
+        for (x = 0; x < size; ++x)
+            data[y * size + x] = 0xff000000 | (x / 4 * 2) << 16 | (y / 4 * 2) << 8 | ((x / 4) ^ (y / 4)) * 2;
+    }
+    SetRect(&rect, 0, 0, size, size);
+
+    hr = IDirect3DDevice9_CreateOffscreenPlainSurface(device, size, size, D3DFMT_A8R8G8B8,
+            D3DPOOL_SCRATCH, &decoded, NULL);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+    for (i = 0; i < ARRAY_SIZE(formats); ++i)
+    {
+        hr = IDirect3DDevice9_CreateTexture(device, size, size, 1, 0, formats[i], D3DPOOL_SYSTEMMEM, &tex, NULL);
+        if (FAILED(hr))
+        {
+            skip("Failed to create texture with format %#x, hr %#x.\n", formats[i], hr);
+            continue;
+        }
+        hr = IDirect3DTexture9_GetSurfaceLevel(tex, 0, &surface);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+        hr = D3DXLoadSurfaceFromMemory(surface, NULL, NULL, data, D3DFMT_A8R8G8B8, size * sizeof(*data),
+                NULL, &rect, D3DX_FILTER_NONE, 0);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+        hr = D3DXLoadSurfaceFromSurface(decoded, NULL, NULL, surface, NULL, NULL, D3DX_FILTER_NONE, 0);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+        hr = IDirect3DSurface9_LockRect(decoded, &lockrect, NULL, D3DLOCK_READONLY);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+        for (y = 0; y < size; ++y)
+        {
+            for (x = 0; x < size; ++x)
+            {
+                color = ((DWORD *)((BYTE *)lockrect.pBits + y * lockrect.Pitch))[x];
+                if (!compare_color(color, data[y * size + x], 8))
+                    break;
+            }
+            if (x < size)
+                break;
+        }
+        ok(y == size, "Format %#x: Got unexpected color 0x%08x at (%u, %u).\n", formats[i], color, x, y);
+        hr = IDirect3DSurface9_UnlockRect(decoded);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+        check_release((IUnknown *)surface, 1);
+        check_release((IUnknown *)tex, 0);
+    }
+
+    check_release((IUnknown *)decoded, 0);
+    HeapFree(GetProcessHeap(), 0, data);
+}
+
 static void test_D3DXSaveSurfaceToFileInMemory(IDirect3DDevice9 *device)
 {
     static const struct
@@ -1787,6 +1868,7 @@ START_TEST(surface)
 
     test_D3DXGetImageInfo();
     test_D3DXLoadSurface(device);
+    test_dxt_compression(device);
     test_D3DXSaveSurfaceToFileInMemory(device);
     test_D3DXSaveSurfaceToFile(device);
 
@@ -24,6 +24,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "windef.h"
+#include "winbase.h"
 #include "txc_dxtn.h"
 
 /* weights used for error function, basically weights (unsquared 2/4/1) according to rgb->luminance conversion
@@ -755,50 +757,34 @@ static void extractsrccolors( GLubyte srcpixels[4][4][4], const GLchan *srcaddr,
 }
 
 
-void tx_compress_dxtn(GLint srccomps, GLint width, GLint height, const GLubyte *srcPixData,
-                     GLenum destFormat, GLubyte *dest, GLint dstRowStride)
+/* Compress the rows of blocks [first_row, last_row). */
+static void compress_dxtn_rows(GLint srccomps, GLint width, GLint height, const GLubyte *srcPixData,
+                               GLenum destFormat, GLubyte *dest, GLint blockRowPitch,
+                               GLint first_row, GLint last_row)
 {
-      GLubyte *blkaddr = dest;
-      GLubyte srcpixels[4][4][4];
-      const GLchan *srcaddr = srcPixData;
-      GLint numxpixels, numypixels;
-      GLint i, j;
-      GLint dstRowDiff;
-
-   switch (destFormat) {
-   case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
-   case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-      /* hmm we used to get called without dstRowStride... */
-      dstRowDiff = dstRowStride >= (width * 2) ? dstRowStride - (((width + 3) & ~3) * 2) : 0;
-/*      fprintf(stderr, "dxt1 tex width %d tex height %d dstRowStride %d\n",
-              width, height, dstRowStride); */
-      for (j = 0; j < height; j += 4) {
-         if (height > j + 3) numypixels = 4;
-         else numypixels = height - j;
-         srcaddr = srcPixData + j * width * srccomps;
-         for (i = 0; i < width; i += 4) {
-            if (width > i + 3) numxpixels = 4;
-            else numxpixels = width - i;
-            extractsrccolors(srcpixels, srcaddr, width, numxpixels, numypixels, srccomps);
+   GLubyte *blkaddr;
+   GLubyte srcpixels[4][4][4];
+   const GLchan *srcaddr;
+   GLint numxpixels, numypixels;
+   GLint i, j, row;
+
+   for (row = first_row; row < last_row; row++) {
+      j = row * 4;
+      if (height > j + 3) numypixels = 4;
+      else numypixels = height - j;
+      srcaddr = srcPixData + j * width * srccomps;
+      blkaddr = dest + row * blockRowPitch;
+      for (i = 0; i < width; i += 4) {
+         if (width > i + 3) numxpixels = 4;
+         else numxpixels = width - i;
+         extractsrccolors(srcpixels, srcaddr, width, numxpixels, numypixels, srccomps);
+         switch (destFormat) {
+         case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+         case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
             encodedxtcolorblockfaster(blkaddr, srcpixels, numxpixels, numypixels, destFormat);
-            srcaddr += srccomps * numxpixels;
             blkaddr += 8;
-         }
-         blkaddr += dstRowDiff;
-      }
-      break;
-   case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-      dstRowDiff = dstRowStride >= (width * 4) ? dstRowStride - (((width + 3) & ~3) * 4) : 0;
-/*      fprintf(stderr, "dxt3 tex width %d tex height %d dstRowStride %d\n",
-              width, height, dstRowStride); */
-      for (j = 0; j < height; j += 4) {
-         if (height > j + 3) numypixels = 4;
-         else numypixels = height - j;
-         srcaddr = srcPixData + j * width * srccomps;
-         for (i = 0; i < width; i += 4) {
-            if (width > i + 3) numxpixels = 4;
-            else numxpixels = width - i;
-            extractsrccolors(srcpixels, srcaddr, width, numxpixels, numypixels, srccomps);
+            break;
+         case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
             *blkaddr++ = (srcpixels[0][0][3] >> 4) | (srcpixels[0][1][3] & 0xf0);
             *blkaddr++ = (srcpixels[0][2][3] >> 4) | (srcpixels[0][3][3] & 0xf0);
             *blkaddr++ = (srcpixels[1][0][3] >> 4) | (srcpixels[1][1][3] & 0xf0);
@@ -808,34 +794,103 @@ void tx_compress_dxtn(GLint srccomps, GLint width, GLint height, const GLubyte *
             *blkaddr++ = (srcpixels[3][0][3] >> 4) | (srcpixels[3][1][3] & 0xf0);
             *blkaddr++ = (srcpixels[3][2][3] >> 4) | (srcpixels[3][3][3] & 0xf0);
             encodedxtcolorblockfaster(blkaddr, srcpixels, numxpixels, numypixels, destFormat);
-            srcaddr += srccomps * numxpixels;
             blkaddr += 8;
-         }
-         blkaddr += dstRowDiff;
-      }
-      break;
-   case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-      dstRowDiff = dstRowStride >= (width * 4) ? dstRowStride - (((width + 3) & ~3) * 4) : 0;
-/*      fprintf(stderr, "dxt5 tex width %d tex height %d dstRowStride %d\n",
-              width, height, dstRowStride); */
-      for (j = 0; j < height; j += 4) {
-         if (height > j + 3) numypixels = 4;
-         else numypixels = height - j;
-         srcaddr = srcPixData + j * width * srccomps;
-         for (i = 0; i < width; i += 4) {
-            if (width > i + 3) numxpixels = 4;
-            else numxpixels = width - i;
-            extractsrccolors(srcpixels, srcaddr, width, numxpixels, numypixels, srccomps);
+            break;
+         case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
             encodedxt5alpha(blkaddr, srcpixels, numxpixels, numypixels);
             encodedxtcolorblockfaster(blkaddr + 8, srcpixels, numxpixels, numypixels, destFormat);
-            srcaddr += srccomps * numxpixels;
             blkaddr += 16;
+            break;
          }
-         blkaddr += dstRowDiff;
+         srcaddr += srccomps * numxpixels;
       }
+   }
+}
+
+/* Images with at least this many blocks are compressed by several threads;
+   below that, the cost of waking up the worker threads isn't worth it. */
+#define PARALLEL_MIN_BLOCKS 4096
+
+struct compress_dxtn_job
+{
+   GLint srccomps, width, height;
+   const GLubyte *srcPixData;
+   GLenum destFormat;
+   GLubyte *dest;
+   GLint blockRowPitch;
+   GLint row_count;
+   LONG next_row;
+};
+
+/* Each call keeps taking the next row of blocks until there are none left,
+   so that threads which start late or run slowly take fewer rows. */
+static void compress_dxtn_job_run(struct compress_dxtn_job *job)
+{
+   GLint row;
+
+   while ((row = InterlockedIncrement(&job->next_row) - 1) < job->row_count)
+      compress_dxtn_rows(job->srccomps, job->width, job->height, job->srcPixData,
+                         job->destFormat, job->dest, job->blockRowPitch, row, row + 1);
+}
+
+static void CALLBACK compress_dxtn_work_callback(TP_CALLBACK_INSTANCE *instance, void *context, TP_WORK *work)
+{
+   compress_dxtn_job_run(context);
+}
+
+void tx_compress_dxtn(GLint srccomps, GLint width, GLint height, const GLubyte *srcPixData,
+                     GLenum destFormat, GLubyte *dest, GLint dstRowStride)
+{
+   struct compress_dxtn_job job;
+   GLint blockSize, dstRowDiff;
+   SYSTEM_INFO info;
+   TP_WORK *work;
+   GLint i, thread_count;
+
+   switch (destFormat) {
+   case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+   case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+      /* hmm we used to get called without dstRowStride... */
+      dstRowDiff = dstRowStride >= (width * 2) ? dstRowStride - (((width + 3) & ~3) * 2) : 0;
+      blockSize = 8;
+      break;
+   case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+   case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+      dstRowDiff = dstRowStride >= (width * 4) ? dstRowStride - (((width + 3) & ~3) * 4) : 0;
+      blockSize = 16;
       break;
    default:
       /* fprintf(stderr, "libdxtn: Bad dstFormat %d in tx_compress_dxtn\n", destFormat); */
       return;
    }
+
+   job.srccomps = srccomps;
+   job.width = width;
+   job.height = height;
+   job.srcPixData = srcPixData;
+   job.destFormat = destFormat;
+   job.dest = dest;
+   job.blockRowPitch = ((width + 3) / 4) * blockSize + dstRowDiff;
+   job.row_count = (height + 3) / 4;
+   job.next_row = 0;
+
+   GetSystemInfo(&info);
+   thread_count = min((GLint)info.dwNumberOfProcessors, job.row_count);
+   if (thread_count < 2 || ((width + 3) / 4) * job.row_count < PARALLEL_MIN_BLOCKS
+         || !(work = CreateThreadpoolWork(compress_dxtn_work_callback, &job, NULL))) {
+      compress_dxtn_rows(srccomps, width, height, srcPixData, destFormat, dest, job.blockRowPitch,
+                         0, job.row_count);
+      return;
+   }
+
+   /* The calling thread takes part in the compression as well. */
+   for (i = 1; i < thread_count; i++)
+      SubmitThreadpoolWork(work);
+   compress_dxtn_job_run(&job);
+   /* Every row has been claimed at this point, but callbacks may still be
+    * compressing theirs; the output is only complete once this wait returns.
+    * Callbacks that haven't started yet would find nothing left to claim, so
+    * they can be cancelled. */
+   WaitForThreadpoolWorkCallbacks(work, TRUE);
+   CloseThreadpoolWork(work);
 }
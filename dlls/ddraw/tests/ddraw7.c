@@ -2041,6 +2041,142 @@ static void test_ck_default(void)
     DestroyWindow(window);
 }
 
+static void test_ck_texels(void)
+{
+    static struct
+    {
+        struct vec4 position;
+        struct vec2 texcoord;
+    }
+    tquad[] =
+    {
+        {{  0.0f, 480.0f, 0.0f, 1.0f}, {0.0f, 0.0f}},
+        {{  0.0f,   0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+        {{640.0f, 480.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},
+        {{640.0f,   0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+    };
+    static const struct
+    {
+        const char *name;
+        DWORD flags, bit_count, r_mask, g_mask, b_mask, a_mask;
+        DWORD key, other;
+    }
+    tests[] =
+    {
+        {"R5G6B5",   DDPF_RGB, 16, 0xf800, 0x07e0, 0x001f, 0x0000, 0x07e0, 0x001f},
+        {"X1R5G5B5", DDPF_RGB, 16, 0x7c00, 0x03e0, 0x001f, 0x0000, 0x03e0, 0x001f},
+        {"X8R8G8B8", DDPF_RGB, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000, 0x0000ff00, 0x000000ff},
+        {"A8R8G8B8", DDPF_RGB | DDPF_ALPHAPIXELS, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000,
+                0xff00ff00, 0xff0000ff},
+    };
+    /* Not a multiple of the number of texels converted at once, so that both
+     * the vectorised and the remaining texels of each row are tested. */
+    static const unsigned int width = 20, height = 4;
+    IDirectDrawSurface7 *surface, *rt;
+    DDSURFACEDESC2 surface_desc;
+    IDirect3DDevice7 *device;
+    unsigned int i, x, y;
+    IDirectDraw7 *ddraw;
+    D3DCOLOR color;
+    IDirect3D7 *d3d;
+    HWND window;
+    HRESULT hr;
+
+    window = create_window();
+    if (!(device = create_device(window, DDSCL_NORMAL)))
+    {
+        skip("Failed to create a 3D device, skipping test.\n");
+        DestroyWindow(window);
+        return;
+    }
+
+    hr = IDirect3DDevice7_GetDirect3D(device, &d3d);
+    ok(SUCCEEDED(hr), "Failed to get d3d interface, hr %#x.\n", hr);
+    hr = IDirect3D7_QueryInterface(d3d, &IID_IDirectDraw7, (void **)&ddraw);
+    ok(SUCCEEDED(hr), "Failed to get ddraw interface, hr %#x.\n", hr);
+    IDirect3D7_Release(d3d);
+
+    hr = IDirect3DDevice7_GetRenderTarget(device, &rt);
+    ok(SUCCEEDED(hr), "Failed to get render target, hr %#x.\n", hr);
+    hr = IDirect3DDevice7_SetRenderState(device, D3DRENDERSTATE_COLORKEYENABLE, TRUE);
+    ok(SUCCEEDED(hr), "Failed to enable color keying, hr %#x.\n", hr);
+
+    for (i = 0; i < ARRAY_SIZE(tests); ++i)
+    {
+        memset(&surface_desc, 0, sizeof(surface_desc));
+        surface_desc.dwSize = sizeof(surface_desc);
+        surface_desc.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PIXELFORMAT | DDSD_CKSRCBLT;
+        surface_desc.ddsCaps.dwCaps = DDSCAPS_TEXTURE;
+        surface_desc.dwWidth = width;
+        surface_desc.dwHeight = height;
+        U4(surface_desc).ddpfPixelFormat.dwSize = sizeof(U4(surface_desc).ddpfPixelFormat);
+        U4(surface_desc).ddpfPixelFormat.dwFlags = tests[i].flags;
+        U1(U4(surface_desc).ddpfPixelFormat).dwRGBBitCount = tests[i].bit_count;
+        U2(U4(surface_desc).ddpfPixelFormat).dwRBitMask = tests[i].r_mask;
+        U3(U4(surface_desc).ddpfPixelFormat).dwGBitMask = tests[i].g_mask;
+        U4(U4(surface_desc).ddpfPixelFormat).dwBBitMask = tests[i].b_mask;
+        U5(U4(surface_desc).ddpfPixelFormat).dwRGBAlphaBitMask = tests[i].a_mask;
+        surface_desc.ddckCKSrcBlt.dwColorSpaceLowValue = tests[i].key;
+        surface_desc.ddckCKSrcBlt.dwColorSpaceHighValue = tests[i].key;
+        hr = IDirectDraw7_CreateSurface(ddraw, &surface_desc, &surface, NULL);
+        if (FAILED(hr))
+        {
+            skip("Failed to create %s texture, hr %#x.\n", tests[i].name, hr);
+            continue;
+        }
+
+        memset(&surface_desc, 0, sizeof(surface_desc));
+        surface_desc.dwSize = sizeof(surface_desc);
+        hr = IDirectDrawSurface7_Lock(surface, NULL, &surface_desc, DDLOCK_WAIT, NULL);
+        ok(SUCCEEDED(hr), "Failed to lock surface, hr %#x.\n", hr);
+        for (y = 0; y < height; ++y)
+        {
+            BYTE *row = (BYTE *)surface_desc.lpSurface + y * U1(surface_desc).lPitch;
+
+            for (x = 0; x < width; ++x)
+            {
+                DWORD value = x % 3 == 1 ? tests[i].key : tests[i].other;
+
+                if (tests[i].bit_count == 16)
+                    ((WORD *)row)[x] = value;
+                else
+                    ((DWORD *)row)[x] = value;
+            }
+        }
+        hr = IDirectDrawSurface7_Unlock(surface, NULL);
+        ok(SUCCEEDED(hr), "Failed to unlock surface, hr %#x.\n", hr);
+
+        hr = IDirect3DDevice7_SetTexture(device, 0, surface);
+        ok(SUCCEEDED(hr), "Failed to set texture, hr %#x.\n", hr);
+        hr = IDirect3DDevice7_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xffff0000, 1.0f, 0);
+        ok(SUCCEEDED(hr), "Failed to clear render target, hr %#x.\n", hr);
+        hr = IDirect3DDevice7_BeginScene(device);
+        ok(SUCCEEDED(hr), "Failed to begin scene, hr %#x.\n", hr);
+        hr = IDirect3DDevice7_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, D3DFVF_XYZRHW | D3DFVF_TEX1, &tquad[0], 4, 0);
+        ok(SUCCEEDED(hr), "Failed to draw, hr %#x.\n", hr);
+        hr = IDirect3DDevice7_EndScene(device);
+        ok(SUCCEEDED(hr), "Failed to end scene, hr %#x.\n", hr);
+
+        for (x = 0; x < width; ++x)
+        {
+            D3DCOLOR expected = x % 3 == 1 ? 0x00ff0000 : 0x000000ff;
+
+            color = get_surface_color(rt, x * 640 / width + 640 / width / 2, 240);
+            ok(compare_color(color, expected, 1), "Test %s: Got unexpected color 0x%08x at texel %u.\n",
+                    tests[i].name, color, x);
+        }
+
+        hr = IDirect3DDevice7_SetTexture(device, 0, NULL);
+        ok(SUCCEEDED(hr), "Failed to set texture, hr %#x.\n", hr);
+        IDirectDrawSurface7_Release(surface);
+    }
+
+    IDirectDrawSurface7_Release(rt);
+    IDirect3DDevice7_Release(device);
+    IDirectDraw7_Release(ddraw);
+    DestroyWindow(window);
+}
+
 static void test_ck_complex(void)
 {
     IDirectDrawSurface7 *surface, *mipmap, *tmp;
@@ -15630,6 +15766,153 @@ static void test_depth_readback(void)
     DestroyWindow(window);
 }
 
+static void test_depth_upload_readback(void)
+{
+    /* Depth values written through Lock() go through the X8D24 upload
+     * conversion before the draw, and back through the download conversion
+     * on the next Lock(). The draw only covers the left half, so the right
+     * half has to read back exactly what was written. */
+    unsigned int i, x, y, mismatches;
+    IDirectDrawSurface7 *rt, *ds;
+    DDSURFACEDESC2 surface_desc;
+    IDirect3DDevice7 *device;
+    DWORD depth, expected;
+    IDirectDraw7 *ddraw;
+    IDirect3D7 *d3d;
+    ULONG refcount;
+    HWND window;
+    HRESULT hr;
+
+    static struct
+    {
+        struct vec3 position;
+        DWORD diffuse;
+    }
+    quad[] =
+    {
+        {{-1.0f, -1.0f, 0.5f}, 0xff00ff00},
+        {{-1.0f,  1.0f, 0.5f}, 0xff00ff00},
+        {{ 0.0f, -1.0f, 0.5f}, 0xff00ff00},
+        {{ 0.0f,  1.0f, 0.5f}, 0xff00ff00},
+    };
+    static const struct
+    {
+        unsigned int z_depth;
+    }
+    tests[] =
+    {
+        {24},
+        {32},
+    };
+
+    window = create_window();
+    ok(!!window, "Failed to create a window.\n");
+
+    if (!(device = create_device(window, DDSCL_NORMAL)))
+    {
+        skip("Failed to create a D3D device, skipping tests.\n");
+        DestroyWindow(window);
+        return;
+    }
+
+    hr = IDirect3DDevice7_GetDirect3D(device, &d3d);
+    ok(SUCCEEDED(hr), "Failed to get Direct3D7 interface, hr %#x.\n", hr);
+    hr = IDirect3D7_QueryInterface(d3d, &IID_IDirectDraw7, (void **)&ddraw);
+    ok(SUCCEEDED(hr), "Failed to get ddraw interface, hr %#x.\n", hr);
+
+    hr = IDirect3DDevice7_GetRenderTarget(device, &rt);
+    ok(SUCCEEDED(hr), "Failed to get render target, hr %#x.\n", hr);
+
+    hr = IDirect3DDevice7_SetRenderState(device, D3DRENDERSTATE_LIGHTING, FALSE);
+    ok(SUCCEEDED(hr), "Failed to set render state, hr %#x.\n", hr);
+    hr = IDirect3DDevice7_SetRenderState(device, D3DRENDERSTATE_ZENABLE, D3DZB_TRUE);
+    ok(SUCCEEDED(hr), "Failed to set render state, hr %#x.\n", hr);
+    hr = IDirect3DDevice7_SetRenderState(device, D3DRENDERSTATE_ZWRITEENABLE, TRUE);
+    ok(SUCCEEDED(hr), "Failed to set render state, hr %#x.\n", hr);
+    hr = IDirect3DDevice7_SetRenderState(device, D3DRENDERSTATE_ZFUNC, D3DCMP_ALWAYS);
+    ok(SUCCEEDED(hr), "Failed to set render state, hr %#x.\n", hr);
+
+    ds = get_depth_stencil(device);
+    hr = IDirectDrawSurface7_DeleteAttachedSurface(rt, 0, ds);
+    ok(SUCCEEDED(hr), "Failed to detach depth buffer, hr %#x.\n", hr);
+    IDirectDrawSurface7_Release(ds);
+
+    for (i = 0; i < ARRAY_SIZE(tests); ++i)
+    {
+        memset(&surface_desc, 0, sizeof(surface_desc));
+        surface_desc.dwSize = sizeof(surface_desc);
+        surface_desc.dwFlags = DDSD_CAPS | DDSD_PIXELFORMAT | DDSD_WIDTH | DDSD_HEIGHT;
+        surface_desc.ddsCaps.dwCaps = DDSCAPS_ZBUFFER | DDSCAPS_VIDEOMEMORY;
+        U4(surface_desc).ddpfPixelFormat.dwSize = sizeof(U4(surface_desc).ddpfPixelFormat);
+        U4(surface_desc).ddpfPixelFormat.dwFlags = DDPF_ZBUFFER;
+        U1(U4(surface_desc).ddpfPixelFormat).dwZBufferBitDepth = tests[i].z_depth;
+        U3(U4(surface_desc).ddpfPixelFormat).dwZBitMask = 0x00ffffff;
+        surface_desc.dwWidth = 640;
+        surface_desc.dwHeight = 480;
+        hr = IDirectDraw7_CreateSurface(ddraw, &surface_desc, &ds, NULL);
+        if (FAILED(hr))
+        {
+            skip("Format %u not supported, skipping test.\n", i);
+            continue;
+        }
+
+        hr = IDirectDrawSurface_AddAttachedSurface(rt, ds);
+        ok(SUCCEEDED(hr), "Failed to attach depth buffer, hr %#x.\n", hr);
+        hr = IDirect3DDevice7_SetRenderTarget(device, rt, 0);
+        ok(SUCCEEDED(hr), "Failed to set render target, hr %#x.\n", hr);
+
+        memset(&surface_desc, 0, sizeof(surface_desc));
+        surface_desc.dwSize = sizeof(surface_desc);
+        hr = IDirectDrawSurface7_Lock(ds, NULL, &surface_desc, DDLOCK_WAIT, NULL);
+        ok(SUCCEEDED(hr), "Failed to lock surface, hr %#x.\n", hr);
+        for (y = 0; y < 480; ++y)
+        {
+            for (x = 0; x < 640; ++x)
+                ((DWORD *)((BYTE *)surface_desc.lpSurface + y * U1(surface_desc).lPitch))[x]
+                        = (x * 0x010307 + y * 0x0b0d11) & 0x00ffffff;
+        }
+        hr = IDirectDrawSurface7_Unlock(ds, NULL);
+        ok(SUCCEEDED(hr), "Failed to unlock surface, hr %#x.\n", hr);
+
+        hr = IDirect3DDevice7_BeginScene(device);
+        ok(SUCCEEDED(hr), "Failed to begin scene, hr %#x.\n", hr);
+        hr = IDirect3DDevice7_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, D3DFVF_XYZ | D3DFVF_DIFFUSE, quad, 4, 0);
+        ok(SUCCEEDED(hr), "Failed to draw, hr %#x.\n", hr);
+        hr = IDirect3DDevice7_EndScene(device);
+        ok(SUCCEEDED(hr), "Failed to end scene, hr %#x.\n", hr);
+
+        memset(&surface_desc, 0, sizeof(surface_desc));
+        surface_desc.dwSize = sizeof(surface_desc);
+        hr = IDirectDrawSurface7_Lock(ds, NULL, &surface_desc, DDLOCK_READONLY | DDLOCK_WAIT, NULL);
+        ok(SUCCEEDED(hr), "Failed to lock surface, hr %#x.\n", hr);
+        mismatches = 0;
+        for (y = 0; y < 480; ++y)
+        {
+            for (x = 330; x < 640; ++x)
+            {
+                depth = ((DWORD *)((BYTE *)surface_desc.lpSurface + y * U1(surface_desc).lPitch))[x] & 0x00ffffff;
+                expected = (x * 0x010307 + y * 0x0b0d11) & 0x00ffffff;
+                if (depth != expected && !mismatches++)
+                    trace("Test %u: Got depth 0x%06x, expected 0x%06x, at %u, %u.\n", i, depth, expected, x, y);
+            }
+        }
+        ok(!mismatches || broken(ddraw_is_nvidia(ddraw)), "Test %u: Got %u mismatches.\n", i, mismatches);
+        hr = IDirectDrawSurface7_Unlock(ds, NULL);
+        ok(SUCCEEDED(hr), "Failed to unlock surface, hr %#x.\n", hr);
+
+        hr = IDirectDrawSurface7_DeleteAttachedSurface(rt, 0, ds);
+        ok(SUCCEEDED(hr), "Failed to detach depth buffer, hr %#x.\n", hr);
+        IDirectDrawSurface7_Release(ds);
+    }
+
+    IDirectDrawSurface7_Release(rt);
+    IDirectDraw7_Release(ddraw);
+    IDirect3D7_Release(d3d);
+    refcount = IDirect3DDevice7_Release(device);
+    ok(!refcount, "Device has %u references left.\n", refcount);
+    DestroyWindow(window);
+}
+
 static void test_clear(void)
 {
     IDirect3DDevice7 *device;
@@ -19246,6 +19529,7 @@ START_TEST(ddraw7)
     run_for_each_device_type(test_zenable);
     run_for_each_device_type(test_ck_rgba);
     test_ck_default();
+    test_ck_texels();
     test_ck_complex();
     test_surface_qi();
     test_device_qi();
@@ -19324,6 +19608,7 @@ START_TEST(ddraw7)
     test_set_render_state();
     test_map_synchronisation();
     test_depth_readback();
+    test_depth_upload_readback();
     test_clear();
     test_enum_surfaces();
     test_viewport();
@@ -306,6 +306,22 @@ static RTL_CRITICAL_SECTION_DEBUG dynamic_unwind_debug =
 };
 static RTL_CRITICAL_SECTION dynamic_unwind_section = { &dynamic_unwind_debug, -1, 0, 0, 0, 0 };
 
+/* direct-mapped cache of recent function table lookups, indexed by pc */
+struct function_info_cache_entry
+{
+    volatile LONG         seq;         /* odd while the entry is being written */
+    LONG                  generation;  /* value of function_info_generation when the entry was filled */
+    ULONG_PTR             begin;       /* range covered by the function table entry */
+    ULONG_PTR             end;
+    ULONG_PTR             base;
+    RUNTIME_FUNCTION     *func;
+    LDR_DATA_TABLE_ENTRY *module;
+};
+
+#define FUNCTION_INFO_CACHE_SIZE 1024
+static struct function_info_cache_entry function_info_cache[FUNCTION_INFO_CACHE_SIZE];
+static volatile LONG function_info_generation = 1;  /* incremented when cached entries may have become stale */
+
 static ULONG_PTR get_runtime_function_end( RUNTIME_FUNCTION *func, ULONG_PTR addr )
 {
 #ifdef __x86_64__
@@ -487,6 +503,7 @@ void WINAPI RtlDeleteGrowableFunctionTable( void *table )
     }
     RtlLeaveCriticalSection( &dynamic_unwind_section );
 
+    if (to_free) invalidate_function_info_cache();
     RtlFreeHeap( GetProcessHeap(), 0, to_free );
 }
 
@@ -514,6 +531,7 @@ BOOLEAN CDECL RtlDeleteFunctionTable( RUNTIME_FUNCTION *table )
 
     if (!to_free) return FALSE;
 
+    invalidate_function_info_cache();
     RtlFreeHeap( GetProcessHeap(), 0, to_free );
     return TRUE;
 }
@@ -521,7 +539,8 @@ BOOLEAN CDECL RtlDeleteFunctionTable( RUNTIME_FUNCTION *table )
 
 /* helper for lookup_function_info() */
 static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
-                                             RUNTIME_FUNCTION *func, ULONG size )
+                                             RUNTIME_FUNCTION *func, ULONG size,
+                                             ULONG_PTR *begin, ULONG_PTR *end )
 {
     int min = 0;
     int max = size - 1;
@@ -535,6 +554,8 @@ static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
         else
         {
             func += pos;
+            *begin = base + func->BeginAddress;
+            *end = base + func->EndAddress;
             while (func->UnwindData & 1)  /* follow chained entry */
                 func = (RUNTIME_FUNCTION *)(base + (func->UnwindData & ~1));
             return func;
@@ -543,17 +564,78 @@ static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
         int pos = (min + max) / 2;
         if (pc < base + (func[pos].BeginAddress & ~1)) max = pos - 1;
         else if (pc >= base + get_runtime_function_end( &func[pos], base )) min = pos + 1;
-        else return func + pos;
+        else
+        {
+            *begin = base + (func[pos].BeginAddress & ~1);
+            *end = base + get_runtime_function_end( &func[pos], base );
+            return func + pos;
+        }
 #else  /* __aarch64__ */
         int pos = (min + max) / 2;
         if (pc < base + func[pos].BeginAddress) max = pos - 1;
         else if (pc >= base + get_runtime_function_end( &func[pos], base )) min = pos + 1;
-        else return func + pos;
+        else
+        {
+            *begin = base + func[pos].BeginAddress;
+            *end = base + get_runtime_function_end( &func[pos], base );
+            return func + pos;
+        }
 #endif
     }
     return NULL;
 }
 
+/* look up a pc in the function info cache */
+static RUNTIME_FUNCTION *find_cached_function_info( ULONG_PTR pc, ULONG_PTR *base,
+                                                    LDR_DATA_TABLE_ENTRY **module )
+{
+    struct function_info_cache_entry *entry = &function_info_cache[(pc >> 4) % FUNCTION_INFO_CACHE_SIZE];
+    RUNTIME_FUNCTION *func;
+    LONG seq;
+
+    seq = entry->seq;
+    if (seq & 1) return NULL;  /* being updated */
+    MemoryBarrier();
+    if (entry->generation != function_info_generation) return NULL;
+    if (pc < entry->begin || pc >= entry->end) return NULL;
+    func    = entry->func;
+    *base   = entry->base;
+    *module = entry->module;
+    MemoryBarrier();
+    if (entry->seq != seq) return NULL;
+    return func;
+}
+
+/* store the result of a successful lookup in the function info cache */
+static void cache_function_info( ULONG_PTR pc, ULONG_PTR begin, ULONG_PTR end, ULONG_PTR base,
+                                 RUNTIME_FUNCTION *func, LDR_DATA_TABLE_ENTRY *module, LONG generation )
+{
+    struct function_info_cache_entry *entry = &function_info_cache[(pc >> 4) % FUNCTION_INFO_CACHE_SIZE];
+    LONG seq = entry->seq;
+
+    /* if another thread is updating the entry, simply leave it alone */
+    if (seq & 1) return;
+    if (InterlockedCompareExchange( &entry->seq, seq + 1, seq ) != seq) return;
+    entry->generation = generation;
+    entry->begin      = begin;
+    entry->end        = end;
+    entry->base       = base;
+    entry->func       = func;
+    entry->module     = module;
+    MemoryBarrier();
+    entry->seq = seq + 2;
+}
+
+/**********************************************************************
+ *           invalidate_function_info_cache
+ *
+ * Called when a function table or a module goes away.
+ */
+void invalidate_function_info_cache(void)
+{
+    InterlockedIncrement( &function_info_generation );
+}
+
 /**********************************************************************
  *           lookup_function_info
  */
@@ -561,8 +643,15 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
 {
     RUNTIME_FUNCTION *func = NULL;
     struct dynamic_unwind_entry *entry;
+    ULONG_PTR begin, end;
+    LONG generation;
     ULONG size;
 
+    if ((func = find_cached_function_info( pc, base, module ))) return func;
+
+    generation = function_info_generation;
+    MemoryBarrier();
+
     /* PE module or wine module */
     if (!LdrFindEntryForAddress( (void *)pc, module ))
     {
@@ -571,7 +660,9 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
                                                   IMAGE_DIRECTORY_ENTRY_EXCEPTION, &size )))
         {
             /* lookup in function table */
-            func = find_function_info( pc, (ULONG_PTR)(*module)->DllBase, func, size/sizeof(*func) );
+            func = find_function_info( pc, (ULONG_PTR)(*module)->DllBase, func, size/sizeof(*func),
+                                       &begin, &end );
+            if (func) cache_function_info( pc, begin, end, *base, func, *module, generation );
         }
     }
     else
@@ -587,8 +678,9 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
                 /* use callback or lookup in function table */
                 if (entry->callback)
                     func = entry->callback( pc, entry->context );
-                else
-                    func = find_function_info( pc, entry->base, entry->table, entry->count );
+                else if ((func = find_function_info( pc, entry->base, entry->table, entry->count,
+                                                     &begin, &end )))
+                    cache_function_info( pc, begin, end, *base, func, NULL, generation );
                 break;
             }
         }
@@ -607,8 +699,6 @@ PRUNTIME_FUNCTION WINAPI RtlLookupFunctionEntry( ULONG_PTR pc, ULONG_PTR *base,
     LDR_DATA_TABLE_ENTRY *module;
     RUNTIME_FUNCTION *func;
 
-    /* FIXME: should use the history table to make things faster */
-
     if (!(func = lookup_function_info( pc, base, &module )))
     {
         *base = 0;
@@ -104,6 +104,49 @@ struct dll_dir_entry
 };
 
 static struct list dll_dir_list = LIST_INIT( dll_dir_list );  /* extra dirs from LdrAddDllDirectory */
+static LONG dll_dir_serial;  /* incremented whenever the dll directories change */
+
+/* load path the cached results belong to; they remain valid as long as the
+ * contents of its directories don't change, which is checked through their
+ * last write time */
+struct dll_search_path
+{
+    struct list    entry;
+    ULONG          serial;    /* load_serial when the directories were last checked */
+    ULONG          count;     /* number of directories in the load path */
+    LARGE_INTEGER *times;     /* last write time of each directory, 0 if it doesn't exist */
+    WCHAR          paths[1];  /* search key, see get_dll_search_key() */
+};
+
+/* cached result of searching a dll name along a load path */
+struct dll_search_entry
+{
+    struct list    entry;
+    const struct dll_search_path *path;  /* load path the dll was searched in */
+    ULONG          hash;      /* hash of the dll name */
+    UNICODE_STRING nt_name;   /* nt name of the dll, or empty if not found */
+    WCHAR          name[1];   /* dll name as passed to search_dll_file() */
+};
+
+#define DLL_SEARCH_HASH_SIZE 256
+#define DLL_SEARCH_MAX_ENTRIES 1024  /* the cached results are dropped when they grow beyond this */
+#define DLL_SEARCH_MAX_PATHS 4       /* the whole cache is flushed when a load path is added beyond this */
+static struct list dll_search_cache[DLL_SEARCH_HASH_SIZE];
+static struct list dll_search_paths = LIST_INIT( dll_search_paths );
+static ULONG dll_search_entries;  /* number of entries in dll_search_cache */
+static ULONG dll_search_path_count;  /* number of entries in dll_search_paths */
+static LONG dll_search_serial;  /* value of dll_dir_serial when the cache was filled */
+static ULONG load_serial;       /* incremented on every LdrLoadDll call, the directories are checked once per call */
+
+/* search statistics for the +loaddll startup report */
+static struct
+{
+    ULONG    lookups;
+    ULONG    hits;
+    ULONG    opens;
+    ULONG    checks;
+    LONGLONG time;
+} dll_search_stats;
 
 struct ldr_notification
 {
@@ -134,8 +177,18 @@ typedef struct _wine_modref
     struct file_id        id;
     ULONG                 CheckSum;
     BOOL                  system;
+    LIST_ENTRY            fullname_links;  /* entry in fullname_hash_table */
+    LIST_ENTRY            fileid_links;    /* entry in fileid_hash_table */
+    LIST_ENTRY            base_links;      /* entry in base_hash_table */
 } WINE_MODREF;
 
+/* hash tables indexing the modules in InLoadOrderModuleList, the base name table uses ldr.HashLinks */
+#define MODULE_HASH_SIZE 256
+static LIST_ENTRY basename_hash_table[MODULE_HASH_SIZE];
+static LIST_ENTRY fullname_hash_table[MODULE_HASH_SIZE];
+static LIST_ENTRY fileid_hash_table[MODULE_HASH_SIZE];
+static LIST_ENTRY base_hash_table[MODULE_HASH_SIZE];
+
 static UINT tls_module_count;      /* number of modules with TLS directory */
 static IMAGE_TLS_DIRECTORY *tls_dirs;  /* array of TLS directories */
 LIST_ENTRY tls_links = { &tls_links, &tls_links };
@@ -502,6 +555,75 @@ static void call_ldr_notifications( ULONG reason, LDR_DATA_TABLE_ENTRY *module )
     }
 }
 
+/*************************************************************************
+ *		get_hash_bucket
+ *
+ * Return the list head for a hash value, initializing it on first use.
+ */
+static LIST_ENTRY *get_hash_bucket( LIST_ENTRY *table, ULONG hash )
+{
+    LIST_ENTRY *bucket = &table[hash % MODULE_HASH_SIZE];
+
+    if (!bucket->Flink) InitializeListHead( bucket );
+    return bucket;
+}
+
+static ULONG hash_module_name( const UNICODE_STRING *name )
+{
+    ULONG hash;
+
+    RtlHashUnicodeString( name, TRUE, HASH_STRING_ALGORITHM_X65599, &hash );
+    return hash;
+}
+
+static ULONG hash_file_id( const struct file_id *id )
+{
+    const ULONG *ptr = (const ULONG *)id->ObjectId;
+    ULONG hash = 0;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(id->ObjectId) / sizeof(*ptr); i++) hash = hash * 65599 + ptr[i];
+    return hash;
+}
+
+static ULONG hash_module_base( const void *base )
+{
+    return (ULONG_PTR)base >> 16;
+}
+
+
+/*************************************************************************
+ *		insert_module_hash
+ *
+ * Add a module to the lookup hash tables.
+ * The loader_section must be locked while calling this function.
+ */
+static void insert_module_hash( WINE_MODREF *wm )
+{
+    InsertTailList( get_hash_bucket( basename_hash_table, hash_module_name( &wm->ldr.BaseDllName )),
+                    &wm->ldr.HashLinks );
+    InsertTailList( get_hash_bucket( fullname_hash_table, hash_module_name( &wm->ldr.FullDllName )),
+                    &wm->fullname_links );
+    InsertTailList( get_hash_bucket( fileid_hash_table, hash_file_id( &wm->id )), &wm->fileid_links );
+    InsertTailList( get_hash_bucket( base_hash_table, hash_module_base( wm->ldr.DllBase )), &wm->base_links );
+}
+
+
+/*************************************************************************
+ *		remove_module_hash
+ *
+ * Remove a module from the lookup hash tables.
+ * The loader_section must be locked while calling this function.
+ */
+static void remove_module_hash( WINE_MODREF *wm )
+{
+    RemoveEntryList( &wm->ldr.HashLinks );
+    RemoveEntryList( &wm->fullname_links );
+    RemoveEntryList( &wm->fileid_links );
+    RemoveEntryList( &wm->base_links );
+}
+
+
 /*************************************************************************
  *		get_modref
  *
@@ -511,16 +633,14 @@ static void call_ldr_notifications( ULONG reason, LDR_DATA_TABLE_ENTRY *module )
 static WINE_MODREF *get_modref( HMODULE hmod )
 {
     PLIST_ENTRY mark, entry;
-    PLDR_DATA_TABLE_ENTRY mod;
 
     if (cached_modref && cached_modref->ldr.DllBase == hmod) return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList;
+    mark = get_hash_bucket( base_hash_table, hash_module_base( hmod ));
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        mod = CONTAINING_RECORD(entry, LDR_DATA_TABLE_ENTRY, InMemoryOrderLinks);
-        if (mod->DllBase == hmod)
-            return cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
+        WINE_MODREF *wm = CONTAINING_RECORD( entry, WINE_MODREF, base_links );
+        if (wm->ldr.DllBase == hmod) return cached_modref = wm;
     }
     return NULL;
 }
@@ -542,13 +662,13 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
     if (cached_modref && RtlEqualUnicodeString( &name_str, &cached_modref->ldr.BaseDllName, TRUE ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    mark = get_hash_bucket( basename_hash_table, hash_module_name( &name_str ));
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, ldr.InLoadOrderLinks);
+        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, ldr.HashLinks);
         if (RtlEqualUnicodeString( &name_str, &mod->ldr.BaseDllName, TRUE ) && !mod->system)
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
+            cached_modref = mod;
             return cached_modref;
         }
     }
@@ -574,13 +694,13 @@ static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
     if (cached_modref && RtlEqualUnicodeString( &name, &cached_modref->ldr.FullDllName, TRUE ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    mark = get_hash_bucket( fullname_hash_table, hash_module_name( &name ));
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD(entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
-        if (RtlEqualUnicodeString( &name, &mod->FullDllName, TRUE ))
+        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, fullname_links);
+        if (RtlEqualUnicodeString( &name, &mod->ldr.FullDllName, TRUE ))
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
+            cached_modref = mod;
             return cached_modref;
         }
     }
@@ -600,11 +720,10 @@ static WINE_MODREF *find_fileid_module( const struct file_id *id )
 
     if (cached_modref && !memcmp( &cached_modref->id, id, sizeof(*id) )) return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    mark = get_hash_bucket( fileid_hash_table, hash_file_id( id ));
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD( entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks );
-        WINE_MODREF *wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
+        WINE_MODREF *wm = CONTAINING_RECORD( entry, WINE_MODREF, fileid_links );
 
         if (!memcmp( &wm->id, id, sizeof(*id) ))
         {
@@ -1346,7 +1465,8 @@ static NTSTATUS fixup_imports( WINE_MODREF *wm, LPCWSTR load_path )
  * Allocate a WINE_MODREF structure and add it to the process list
  * The loader_section must be locked while calling this function.
  */
-static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name, BOOL builtin )
+static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name,
+                                  const struct file_id *id, BOOL builtin )
 {
     WCHAR *buffer;
     WINE_MODREF *wm;
@@ -1362,6 +1482,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name
     wm->ldr.LoadCount     = 1;
     wm->CheckSum          = nt->OptionalHeader.CheckSum;
     wm->ldr.TimeDateStamp = nt->FileHeader.TimeDateStamp;
+    if (id) wm->id = *id;
 
     if (!(buffer = RtlAllocateHeap( GetProcessHeap(), 0, nt_name->Length - 3 * sizeof(WCHAR) )))
     {
@@ -1397,6 +1518,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name
                    &wm->ldr.InLoadOrderLinks);
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList,
                    &wm->ldr.InMemoryOrderLinks);
+    insert_module_hash( wm );
     /* wait until init is called for inserting into InInitializationOrderModuleList */
 
     if (!(nt->OptionalHeader.DllCharacteristics & IMAGE_DLLCHARACTERISTICS_NX_COMPAT))
@@ -2058,9 +2180,8 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
 
     /* create the MODREF */
 
-    if (!(wm = alloc_module( *module, nt_name, is_builtin ))) return STATUS_NO_MEMORY;
+    if (!(wm = alloc_module( *module, nt_name, id, is_builtin ))) return STATUS_NO_MEMORY;
 
-    if (id) wm->id = *id;
     if (image_info->LoaderFlags) wm->ldr.Flags |= LDR_COR_IMAGE;
     if (image_info->u.s.ComPlusILOnly) wm->ldr.Flags |= LDR_COR_ILONLY;
     wm->system = system;
@@ -2097,9 +2218,10 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
             status = fixup_imports( wm, load_path );
         if (status != STATUS_SUCCESS)
         {
-            /* the module has only be inserted in the load & memory order lists */
+            /* the module has only be inserted in the load & memory order lists and the hash tables */
             RemoveEntryList(&wm->ldr.InLoadOrderLinks);
             RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
+            remove_module_hash( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -2148,7 +2270,7 @@ static void build_ntdll_module(void)
     RtlInitUnicodeString( &nt_name, L"\\??\\C:\\windows\\system32\\ntdll.dll" );
     NtQueryVirtualMemory( GetCurrentProcess(), build_ntdll_module, MemoryBasicInformation,
                           &meminfo, sizeof(meminfo), NULL );
-    wm = alloc_module( meminfo.AllocationBase, &nt_name, TRUE );
+    wm = alloc_module( meminfo.AllocationBase, &nt_name, NULL, TRUE );
     assert( wm );
     wm->ldr.Flags &= ~LDR_DONT_RESOLVE_REFS;
     node_ntdll = wm->ldr.DdagNode;
@@ -2913,6 +3035,329 @@ done:
 }
 
 
+/***********************************************************************
+ *	free_dll_search_entry
+ *
+ * The loader_section must be locked while calling this function.
+ */
+static void free_dll_search_entry( struct dll_search_entry *entry )
+{
+    list_remove( &entry->entry );
+    RtlFreeUnicodeString( &entry->nt_name );
+    RtlFreeHeap( GetProcessHeap(), 0, entry );
+    dll_search_entries--;
+}
+
+
+/***********************************************************************
+ *	flush_dll_search_entries
+ *
+ * Drop the cached search results for a load path, or all of them if path is NULL.
+ * The loader_section must be locked while calling this function.
+ */
+static void flush_dll_search_entries( const struct dll_search_path *path )
+{
+    struct dll_search_entry *entry, *next;
+    unsigned int i;
+
+    for (i = 0; i < DLL_SEARCH_HASH_SIZE; i++)
+    {
+        if (!dll_search_cache[i].next) continue;
+        LIST_FOR_EACH_ENTRY_SAFE( entry, next, &dll_search_cache[i], struct dll_search_entry, entry )
+            if (!path || entry->path == path) free_dll_search_entry( entry );
+    }
+}
+
+
+/***********************************************************************
+ *	flush_dll_search_cache
+ *
+ * Drop all cached search results and load paths.
+ * The loader_section must be locked while calling this function.
+ */
+static void flush_dll_search_cache(void)
+{
+    struct dll_search_path *path, *next;
+
+    flush_dll_search_entries( NULL );
+    LIST_FOR_EACH_ENTRY_SAFE( path, next, &dll_search_paths, struct dll_search_path, entry )
+    {
+        list_remove( &path->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, path->times );
+        RtlFreeHeap( GetProcessHeap(), 0, path );
+    }
+    dll_search_path_count = 0;
+}
+
+
+/***********************************************************************
+ *	get_dll_search_bucket
+ */
+static struct list *get_dll_search_bucket( const WCHAR *name, ULONG *hash )
+{
+    UNICODE_STRING str;
+    struct list *bucket;
+
+    RtlInitUnicodeString( &str, name );
+    RtlHashUnicodeString( &str, TRUE, HASH_STRING_ALGORITHM_X65599, hash );
+    bucket = &dll_search_cache[*hash % DLL_SEARCH_HASH_SIZE];
+    if (!bucket->next) list_init( bucket );
+    return bucket;
+}
+
+
+/***********************************************************************
+ *	get_dll_search_dir_times
+ *
+ * Get the last write time of the directories of a load path search key.
+ * Returns the number of directories.
+ */
+static ULONG get_dll_search_dir_times( const WCHAR *paths, LARGE_INTEGER *times )
+{
+    FILE_NETWORK_OPEN_INFORMATION info;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING nt_name;
+    WCHAR *name;
+    ULONG len, count = 0;
+
+    if (!(name = RtlAllocateHeap( GetProcessHeap(), 0, (wcslen( paths ) + 2) * sizeof(WCHAR) ))) return 0;
+
+    InitializeObjectAttributes( &attr, &nt_name, OBJ_CASE_INSENSITIVE, 0, NULL );
+    while (*paths && *paths != '|')  /* the current directory follows the '|' */
+    {
+        LPCWSTR ptr = paths;
+
+        while (*ptr && *ptr != ';' && *ptr != '|') ptr++;
+        len = ptr - paths;
+        if (*ptr == ';') ptr++;
+        memcpy( name, paths, len * sizeof(WCHAR) );
+        if (!len) name[len++] = '.';
+        name[len] = 0;
+
+        if (times)
+        {
+            dll_search_stats.checks++;
+            times[count].QuadPart = 0;
+            if (!RtlDosPathNameToNtPathName_U_WithStatus( name, &nt_name, NULL, NULL ))
+            {
+                if (!NtQueryFullAttributesFile( &attr, &info )) times[count] = info.LastWriteTime;
+                RtlFreeUnicodeString( &nt_name );
+            }
+        }
+        count++;
+        paths = ptr;
+    }
+
+    RtlFreeHeap( GetProcessHeap(), 0, name );
+    return count;
+}
+
+
+/***********************************************************************
+ *	get_dll_search_path
+ *
+ * Get the load path record for a search key, creating it if needed. The cached
+ * results for the load path are dropped if any of its directories was modified
+ * since they were checked, which is done once per top-level load.
+ * The loader_section must be locked while calling this function.
+ */
+static struct dll_search_path *get_dll_search_path( const WCHAR *key )
+{
+    struct dll_search_path *path;
+    LARGE_INTEGER *times;
+    ULONG len, count;
+
+    if (dll_search_serial != dll_dir_serial)
+    {
+        flush_dll_search_cache();
+        dll_search_serial = dll_dir_serial;
+    }
+
+    LIST_FOR_EACH_ENTRY( path, &dll_search_paths, struct dll_search_path, entry )
+    {
+        if (wcscmp( path->paths, key )) continue;
+        if (path->serial == load_serial) return path;
+        if (!(times = RtlAllocateHeap( GetProcessHeap(), 0, path->count * sizeof(*times) ))) return NULL;
+        path->serial = load_serial;
+        get_dll_search_dir_times( path->paths, times );
+        if (memcmp( times, path->times, path->count * sizeof(*times) ))
+        {
+            TRACE( "directories of %s changed\n", debugstr_w(key) );
+            flush_dll_search_entries( path );
+        }
+        RtlFreeHeap( GetProcessHeap(), 0, path->times );
+        path->times = times;
+        return path;
+    }
+
+    /* the load path changed, along with the current directory or PATH for instance;
+     * results for the older ones are unlikely to be used again */
+    if (dll_search_path_count >= DLL_SEARCH_MAX_PATHS) flush_dll_search_cache();
+
+    count = get_dll_search_dir_times( key, NULL );
+    len = wcslen( key ) + 1;
+    if (!(path = RtlAllocateHeap( GetProcessHeap(), 0, offsetof( struct dll_search_path, paths[len] ))))
+        return NULL;
+    if (!(path->times = RtlAllocateHeap( GetProcessHeap(), 0, count * sizeof(*path->times) )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, path );
+        return NULL;
+    }
+    memcpy( path->paths, key, len * sizeof(WCHAR) );
+    path->serial = load_serial;
+    path->count = count;
+    get_dll_search_dir_times( path->paths, path->times );
+    list_add_tail( &dll_search_paths, &path->entry );
+    dll_search_path_count++;
+    return path;
+}
+
+
+/***********************************************************************
+ *	find_dll_search_entry
+ *
+ * Find the cached search result for a dll name in a load path.
+ * The loader_section must be locked while calling this function.
+ */
+static struct dll_search_entry *find_dll_search_entry( const struct dll_search_path *path, const WCHAR *name )
+{
+    struct dll_search_entry *entry;
+    struct list *bucket;
+    ULONG hash;
+
+    bucket = get_dll_search_bucket( name, &hash );
+    LIST_FOR_EACH_ENTRY( entry, bucket, struct dll_search_entry, entry )
+    {
+        if (entry->path == path && entry->hash == hash && !wcsicmp( entry->name, name )) return entry;
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *	add_dll_search_entry
+ *
+ * Cache the result of searching a dll name in a load path.
+ * The loader_section must be locked while calling this function.
+ */
+static void add_dll_search_entry( const struct dll_search_path *path, const WCHAR *name,
+                                  const UNICODE_STRING *nt_name )
+{
+    struct dll_search_entry *entry;
+    struct list *bucket;
+    ULONG hash, len;
+
+    if ((entry = find_dll_search_entry( path, name ))) free_dll_search_entry( entry );
+    if (dll_search_entries >= DLL_SEARCH_MAX_ENTRIES) flush_dll_search_entries( NULL );
+
+    bucket = get_dll_search_bucket( name, &hash );
+    len = wcslen( name ) + 1;
+    if (!(entry = RtlAllocateHeap( GetProcessHeap(), 0, offsetof( struct dll_search_entry, name[len] ))))
+        return;
+    entry->path = path;
+    entry->hash = hash;
+    memcpy( entry->name, name, len * sizeof(WCHAR) );
+    if (!nt_name) RtlInitUnicodeString( &entry->nt_name, NULL );
+    else if (RtlDuplicateUnicodeString( 1, nt_name, &entry->nt_name ))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, entry );
+        return;
+    }
+    list_add_head( bucket, &entry->entry );
+    dll_search_entries++;
+}
+
+
+/***********************************************************************
+ *	get_dll_search_key
+ *
+ * Build the key under which search results for a load path are cached.
+ * Relative directories, like the "." added by get_dll_load_path() or relative
+ * PATH entries, depend on the current directory, which is then made part of
+ * the key. Returns NULL if the results shouldn't be cached.
+ */
+static WCHAR *get_dll_search_key( const WCHAR *paths )
+{
+    const WCHAR *ptr = paths;
+    WCHAR cwd[MAX_PATH], *key;
+    BOOL relative = FALSE;
+    ULONG len, cwd_len = 0;
+
+    while (*ptr && !relative)
+    {
+        const WCHAR *dir = ptr;
+
+        while (*ptr && *ptr != ';') ptr++;
+        len = ptr - dir;
+        if (*ptr == ';') ptr++;
+        if (len >= 2 && dir[0] == '\\' && dir[1] == '\\') continue;
+        if (len >= 3 && dir[1] == ':' && (dir[2] == '\\' || dir[2] == '/')) continue;
+        relative = TRUE;
+    }
+
+    if (relative)
+    {
+        cwd_len = RtlGetCurrentDirectory_U( sizeof(cwd), cwd );
+        if (!cwd_len || cwd_len >= sizeof(cwd)) return NULL;
+        cwd_len = cwd_len / sizeof(WCHAR) + 1;
+    }
+
+    len = wcslen( paths );
+    if (!(key = RtlAllocateHeap( GetProcessHeap(), 0, (len + cwd_len + 1) * sizeof(WCHAR) ))) return NULL;
+    memcpy( key, paths, len * sizeof(WCHAR) );
+    if (relative)
+    {
+        key[len++] = '|';  /* can't appear in a path */
+        wcscpy( key + len, cwd );
+    }
+    else key[len] = 0;
+    return key;
+}
+
+
+/***********************************************************************
+ *	search_dll_file_cached
+ *
+ * Look up a previous search result for the dll. Found files are opened again, in
+ * case they were replaced or removed since.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL search_dll_file_cached( const struct dll_search_path *path, LPCWSTR search, UNICODE_STRING *nt_name,
+                                    WINE_MODREF **pwm, HANDLE *mapping, SECTION_IMAGE_INFORMATION *image_info,
+                                    struct file_id *id, NTSTATUS *status )
+{
+    struct dll_search_entry *entry;
+
+    if (!(entry = find_dll_search_entry( path, search ))) return FALSE;
+
+    if (!entry->nt_name.Buffer)
+    {
+        dll_search_stats.hits++;
+        *status = STATUS_DLL_NOT_FOUND;
+        return TRUE;
+    }
+
+    if ((*status = RtlDuplicateUnicodeString( 1, &entry->nt_name, nt_name ))) return TRUE;
+    dll_search_stats.opens++;
+    if (!(*status = open_dll_file( nt_name, pwm, mapping, image_info, id )))
+    {
+        dll_search_stats.hits++;
+        return TRUE;
+    }
+    TRACE( "cached %s for %s is no longer valid, status %x\n",
+           debugstr_us(&entry->nt_name), debugstr_w(search), *status );
+    RtlFreeUnicodeString( nt_name );
+    nt_name->Buffer = NULL;
+    if (*mapping)
+    {
+        NtClose( *mapping );
+        *mapping = NULL;
+    }
+    free_dll_search_entry( entry );
+    return FALSE;
+}
+
+
 /***********************************************************************
  *	search_dll_file
  *
@@ -2922,12 +3367,29 @@ static NTSTATUS search_dll_file( LPCWSTR paths, LPCWSTR search, UNICODE_STRING *
                                  WINE_MODREF **pwm, HANDLE *mapping, SECTION_IMAGE_INFORMATION *image_info,
                                  struct file_id *id )
 {
-    WCHAR *name;
+    struct dll_search_path *path = NULL;
+    WCHAR *name, *key;
     BOOL found_image = FALSE;
     NTSTATUS status = STATUS_DLL_NOT_FOUND;
+    LARGE_INTEGER start, end;
     ULONG len;
 
     if (!paths) paths = default_load_path;
+
+    NtQueryPerformanceCounter( &start, NULL );
+    dll_search_stats.lookups++;
+    if ((key = get_dll_search_key( paths )))
+    {
+        path = get_dll_search_path( key );
+        RtlFreeHeap( GetProcessHeap(), 0, key );
+    }
+    if (path && search_dll_file_cached( path, search, nt_name, pwm, mapping, image_info, id, &status ))
+    {
+        NtQueryPerformanceCounter( &end, NULL );
+        dll_search_stats.time += end.QuadPart - start.QuadPart;
+        return status;
+    }
+
     len = wcslen( paths );
 
     if (len < wcslen( system_dir )) len = wcslen( system_dir );
@@ -2950,6 +3412,7 @@ static NTSTATUS search_dll_file( LPCWSTR paths, LPCWSTR search, UNICODE_STRING *
         nt_name->Buffer = NULL;
         if ((status = RtlDosPathNameToNtPathName_U_WithStatus( name, nt_name, NULL, NULL ))) goto done;
 
+        dll_search_stats.opens++;
         status = open_dll_file( nt_name, pwm, mapping, image_info, id );
         if (status == STATUS_IMAGE_MACHINE_TYPE_MISMATCH) found_image = TRUE;
         else if (status != STATUS_DLL_NOT_FOUND) goto done;
@@ -2960,7 +3423,14 @@ static NTSTATUS search_dll_file( LPCWSTR paths, LPCWSTR search, UNICODE_STRING *
     if (found_image) status = STATUS_IMAGE_MACHINE_TYPE_MISMATCH;
 
 done:
+    if (path)
+    {
+        if (status == STATUS_SUCCESS) add_dll_search_entry( path, search, nt_name );
+        else if (status == STATUS_DLL_NOT_FOUND) add_dll_search_entry( path, search, NULL );
+    }
     RtlFreeHeap( GetProcessHeap(), 0, name );
+    NtQueryPerformanceCounter( &end, NULL );
+    dll_search_stats.time += end.QuadPart - start.QuadPart;
     return status;
 }
 
@@ -3192,6 +3662,7 @@ NTSTATUS WINAPI DECLSPEC_HOTPATCH LdrLoadDll(LPCWSTR path_name, DWORD flags,
 
     RtlEnterCriticalSection( &loader_section );
 
+    load_serial++;
     nts = load_dll( path_name, dllname ? dllname : libname->Buffer, flags, &wm, FALSE );
 
     if (nts == STATUS_SUCCESS && !(wm->ldr.Flags & LDR_DONT_RESOLVE_REFS))
@@ -3737,6 +4208,10 @@ static void free_modref( WINE_MODREF *wm )
 
     RemoveEntryList(&wm->ldr.InLoadOrderLinks);
     RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
+    remove_module_hash( wm );
+#if defined(__x86_64__) || defined(__arm__) || defined(__aarch64__)
+    invalidate_function_info_cache();
+#endif
     if (wm->ldr.InInitializationOrderLinks.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderLinks);
 
@@ -4102,8 +4577,11 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
         ANSI_STRING func_name;
         WINE_MODREF *kernel32;
         PEB *peb = NtCurrentTeb()->Peb;
+        LARGE_INTEGER start, end;
         DWORD hci = 2;
 
+        NtQueryPerformanceCounter( &start, NULL );
+
         peb->LdrData            = &ldr;
         peb->FastPebLock        = &peb_lock;
         peb->TlsBitmap          = &tls_bitmap;
@@ -4163,6 +4641,20 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
             NtTerminateProcess( GetCurrentProcess(), status );
         }
         imports_fixup_done = TRUE;
+
+        if (TRACE_ON(loaddll))
+        {
+            LARGE_INTEGER freq;
+
+            NtQueryPerformanceCounter( &end, &freq );
+            TRACE_(loaddll)( "Imports for %s resolved in %s us, %u searches in %s us, %u cached, %u files opened, "
+                             "%u directories checked\n",
+                             debugstr_w(wm->ldr.BaseDllName.Buffer),
+                             wine_dbgstr_longlong( (end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart ),
+                             dll_search_stats.lookups,
+                             wine_dbgstr_longlong( dll_search_stats.time * 1000000 / freq.QuadPart ),
+                             dll_search_stats.hits, dll_search_stats.opens, dll_search_stats.checks );
+        }
     }
     else wm = get_modref( NtCurrentTeb()->Peb->ImageBaseAddress );
 
@@ -4352,6 +4844,7 @@ NTSTATUS WINAPI LdrSetDllDirectory( const UNICODE_STRING *dir )
     RtlEnterCriticalSection( &dlldir_section );
     RtlFreeUnicodeString( &dll_directory );
     dll_directory = new;
+    InterlockedIncrement( &dll_dir_serial );
     RtlLeaveCriticalSection( &dlldir_section );
     return status;
 }
@@ -4394,6 +4887,7 @@ NTSTATUS WINAPI LdrAddDllDirectory( const UNICODE_STRING *dir, void **cookie )
         TRACE( "%s\n", debugstr_w( ptr->dir ));
         RtlEnterCriticalSection( &dlldir_section );
         list_add_head( &dll_dir_list, &ptr->entry );
+        InterlockedIncrement( &dll_dir_serial );
         RtlLeaveCriticalSection( &dlldir_section );
         *cookie = ptr;
     }
@@ -4414,6 +4908,7 @@ NTSTATUS WINAPI LdrRemoveDllDirectory( void *cookie )
     RtlEnterCriticalSection( &dlldir_section );
     list_remove( &ptr->entry );
     RtlFreeHeap( GetProcessHeap(), 0, ptr );
+    InterlockedIncrement( &dll_dir_serial );
     RtlLeaveCriticalSection( &dlldir_section );
     return STATUS_SUCCESS;
 }
@@ -4432,6 +4927,7 @@ NTSTATUS WINAPI LdrSetDefaultDllDirectories( ULONG flags )
 
     if (!flags || (flags & ~load_library_search_flags)) return STATUS_INVALID_PARAMETER;
     default_search_flags = flags;
+    InterlockedIncrement( &dll_dir_serial );
     return STATUS_SUCCESS;
 }
 
@@ -30,6 +30,7 @@
 #include "winbase.h"
 #include "winnls.h"
 #include "ntdll_misc.h"
+#include "wine/casemap.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(nls);
@@ -726,10 +727,15 @@ LONG WINAPI RtlCompareUnicodeStrings( const WCHAR *s1, SIZE_T len1, const WCHAR
                                       BOOLEAN case_insensitive )
 {
     LONG ret = 0;
-    SIZE_T len = min( len1, len2 );
+    SIZE_T prefix, len = min( len1, len2 );
 
     if (case_insensitive)
     {
+        /* skip the ASCII part that doesn't need the case mapping tables */
+        prefix = casemap_ascii_prefix( s1, s2, min( len, ~0u ));
+        s1 += prefix;
+        s2 += prefix;
+        len -= prefix;
         if (nls_info.UpperCaseTable)
         {
             while (!ret && len--) ret = casemap( nls_info.UpperCaseTable, *s1++ ) -
@@ -760,7 +766,8 @@ BOOLEAN WINAPI RtlPrefixUnicodeString( const UNICODE_STRING *s1, const UNICODE_S
     if (s1->Length > s2->Length) return FALSE;
     if (ignore_case)
     {
-        for (i = 0; i < s1->Length / sizeof(WCHAR); i++)
+        i = casemap_ascii_prefix( s1->Buffer, s2->Buffer, s1->Length / sizeof(WCHAR) );
+        for ( ; i < s1->Length / sizeof(WCHAR); i++)
             if (casemap( nls_info.UpperCaseTable, s1->Buffer[i] ) !=
                 casemap( nls_info.UpperCaseTable, s2->Buffer[i] )) return FALSE;
     }
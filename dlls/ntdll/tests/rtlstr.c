@@ -1899,6 +1899,44 @@ static void test_RtlCompareUnicodeString(void)
     }
 }
 
+static void test_RtlCompareUnicodeString_long(void)
+{
+    static const WCHAR chars[] = { 'a', 'A', 'z', '[', '`', '{', 0xe9, 0xc9, 0x212a, 0xff41 };
+    WCHAR buf1[40], buf2[40];
+    UNICODE_STRING str1, str2;
+    unsigned int i, j, pos;
+    LONG res, expect;
+    WCHAR ch1;
+
+    str1.Buffer = buf1;
+    str1.Length = str1.MaximumLength = sizeof(buf1);
+    str2.Buffer = buf2;
+    str2.Length = str2.MaximumLength = sizeof(buf2);
+
+    /* the difference can be at any position, in either an ASCII or a non-ASCII character */
+    for (pos = 0; pos < ARRAY_SIZE(buf1); pos++)
+    {
+        for (ch1 = 0; ch1 < 256; ch1++)
+        {
+            for (i = 0; i < ARRAY_SIZE(chars); i++)
+            {
+                for (j = 0; j < ARRAY_SIZE(buf1); j++)
+                {
+                    buf1[j] = 'a' + j % 26;
+                    buf2[j] = (j & 1) ? 'A' + j % 26 : 'a' + j % 26;
+                }
+                buf1[pos] = ch1;
+                buf2[pos] = chars[i];
+                expect = pRtlUpcaseUnicodeChar( ch1 ) - pRtlUpcaseUnicodeChar( chars[i] );
+                res = pRtlCompareUnicodeString( &str1, &str2, TRUE );
+                ok( res == expect, "%u: wrong result %d %04x %04x\n", pos, res, ch1, chars[i] );
+                ok( pRtlEqualUnicodeString( &str1, &str2, TRUE ) == !expect,
+                    "%u: wrong result for %04x %04x\n", pos, ch1, chars[i] );
+            }
+        }
+    }
+}
+
 static const WCHAR szGuid[] = { '{','0','1','0','2','0','3','0','4','-',
   '0','5','0','6','-'  ,'0','7','0','8','-','0','9','0','A','-',
   '0','B','0','C','0','D','0','E','0','F','0','A','}','\0' };
@@ -2917,6 +2955,7 @@ START_TEST(rtlstr)
     test_RtlStringFromGUID();
     test_RtlIsTextUnicode();
     test_RtlCompareUnicodeString();
+    test_RtlCompareUnicodeString_long();
     test_RtlUpcaseUnicodeChar();
     test_RtlUpcaseUnicodeString();
     test_RtlDowncaseUnicodeString();
@@ -1012,6 +1012,48 @@ static void test_user_shared_data(void)
     }
 }
 
+static void test_large_pages(void)
+{
+    const KSHARED_USER_DATA *user_shared_data = (void *)0x7ffe0000;
+    SIZE_T size, large_page_size = user_shared_data->LargePageMinimum;
+    NTSTATUS status;
+    char *addr;
+
+    if (!large_page_size)
+    {
+        skip("Large pages are not supported.\n");
+        return;
+    }
+    ok(!(large_page_size & (large_page_size - 1)), "Got unexpected LargePageMinimum %#lx.\n", large_page_size);
+
+    /* large pages have to be reserved and committed at once */
+    size = large_page_size;
+    addr = NULL;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), (void **)&addr, 0, &size,
+                                     MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(status == STATUS_INVALID_PARAMETER || status == STATUS_PRIVILEGE_NOT_HELD,
+       "NtAllocateVirtualMemory returned %08x\n", status);
+
+    size = 2 * large_page_size;
+    addr = NULL;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), (void **)&addr, 0, &size,
+                                     MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (status == STATUS_PRIVILEGE_NOT_HELD)
+    {
+        skip("SeLockMemoryPrivilege is not held.\n");
+        return;
+    }
+    ok(status == STATUS_SUCCESS, "NtAllocateVirtualMemory returned %08x\n", status);
+    ok(!((ULONG_PTR)addr & (large_page_size - 1)), "Got unaligned address %p.\n", addr);
+    ok(size == 2 * large_page_size, "Got unexpected size %#lx.\n", size);
+    addr[0] = 1;
+    addr[size - 1] = 1;
+
+    size = 0;
+    status = NtFreeVirtualMemory(NtCurrentProcess(), (void **)&addr, &size, MEM_RELEASE);
+    ok(status == STATUS_SUCCESS, "NtFreeVirtualMemory returned %08x\n", status);
+}
+
 static void perform_relocations( void *module, INT_PTR delta )
 {
     IMAGE_NT_HEADERS *nt;
@@ -1170,5 +1212,6 @@ START_TEST(virtual)
     test_RtlCreateUserStack();
     test_NtMapViewOfSection();
     test_user_shared_data();
+    test_large_pages();
     test_syscalls();
 }
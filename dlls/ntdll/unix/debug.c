@@ -25,13 +25,20 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -51,7 +58,8 @@ struct debug_info
 {
     unsigned int str_pos;       /* current position in strings buffer */
     unsigned int out_pos;       /* current position in output buffer */
-    char         strings[1020]; /* buffer for temporary strings */
+    unsigned int ring_state;    /* RING_WRITING / RING_QUIT flags, see ring_write() */
+    char         strings[1016]; /* buffer for temporary strings */
     char         output[1020];  /* current output line */
 };
 
@@ -66,6 +74,271 @@ static struct __wine_debug_channel *debug_options;
 
 static const char * const debug_classes[] = { "fixme", "err", "warn", "trace" };
 
+static int debug_fd = 2;  /* where the debug output goes, can be changed with WINE_DEBUG_LOG */
+
+/* Asynchronous output, enabled with WINE_DEBUG_ASYNC. Completed lines are copied to a
+ * lock-free ring buffer shared by all threads, and written out by a separate thread.
+ * Lines are dropped rather than waiting when the ring is full. */
+
+#define DEBUG_RING_SIZE   (4 * 1024 * 1024)  /* must be a power of 2 */
+#define DEBUG_WRITE_SIZE  (64 * 1024)        /* max size of a single write */
+
+struct debug_record
+{
+    unsigned int len;    /* length of the data following the record */
+    unsigned int ready;  /* set once the data has been copied */
+};
+
+static char *debug_ring;
+static size_t ring_head;  /* position of the next record to reserve */
+static size_t ring_tail;  /* position of the first record not yet written out */
+static int ring_waiting;  /* set while the writer thread waits for data */
+static unsigned int ring_dropped;  /* number of lines dropped since the last write */
+
+#ifdef __linux__
+static inline void ring_futex_wait( int *addr, int val, const struct timespec *timeout )
+{
+    syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline void ring_futex_wake( int *addr )
+{
+    syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+}
+#else
+static inline void ring_futex_wait( int *addr, int val, const struct timespec *timeout )
+{
+    nanosleep( timeout, NULL );
+}
+
+static inline void ring_futex_wake( int *addr ) { }
+#endif
+
+#define RING_WRITING 1  /* the thread is between reserving and publishing a record */
+#define RING_QUIT    2  /* the thread was asked to quit while writing a record */
+
+static inline struct debug_info *get_info(void);
+
+static inline size_t record_size( unsigned int len )
+{
+    return (sizeof(struct debug_record) + len + 7) & ~(size_t)7;
+}
+
+/* copy data to or from the ring, wrapping around at the end */
+static void ring_copy( char *dst, const char *src, size_t len, BOOL to_ring )
+{
+    size_t pos = (to_ring ? dst : src) - debug_ring;
+    size_t first = min( len, DEBUG_RING_SIZE - pos );
+
+    if (to_ring)
+    {
+        memcpy( dst, src, first );
+        memcpy( debug_ring, src + first, len - first );
+    }
+    else
+    {
+        memcpy( dst, src, first );
+        memcpy( dst + first, debug_ring, len - first );
+    }
+}
+
+/* queue a line for the writer thread */
+static int ring_write( const char *str, unsigned int len )
+{
+    struct debug_info *info = get_info();
+    size_t head, pos, size = record_size( len );
+    struct debug_record *rec;
+    unsigned int state;
+
+    /* The writer thread can't get past a record that is reserved but never published, so
+     * the thread must not be terminated in between. A SIGQUIT arriving meanwhile is only
+     * recorded by dbg_defer_quit(), and acted upon once the record is published. */
+    info->ring_state = RING_WRITING;
+    __atomic_signal_fence( __ATOMIC_SEQ_CST );
+
+    head = __atomic_load_n( &ring_head, __ATOMIC_RELAXED );
+    do
+    {
+        if (head + size - __atomic_load_n( &ring_tail, __ATOMIC_ACQUIRE ) > DEBUG_RING_SIZE)
+        {
+            __atomic_fetch_add( &ring_dropped, 1, __ATOMIC_RELAXED );
+            goto done;
+        }
+    } while (!__atomic_compare_exchange_n( &ring_head, &head, head + size, TRUE,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ));
+
+    pos = head & (DEBUG_RING_SIZE - 1);
+    rec = (struct debug_record *)(debug_ring + pos);
+    rec->len = len;
+    pos = (pos + sizeof(*rec)) & (DEBUG_RING_SIZE - 1);
+    ring_copy( debug_ring + pos, str, len, TRUE );
+    __atomic_store_n( &rec->ready, 1, __ATOMIC_SEQ_CST );
+
+    if (__atomic_load_n( &ring_waiting, __ATOMIC_SEQ_CST ))
+    {
+        __atomic_store_n( &ring_waiting, 0, __ATOMIC_RELAXED );
+        ring_futex_wake( &ring_waiting );
+    }
+
+done:
+    __atomic_signal_fence( __ATOMIC_SEQ_CST );
+    state = info->ring_state;
+    info->ring_state = 0;
+    if (state & RING_QUIT) abort_thread( 0 );
+    return len;
+}
+
+static void write_all( const char *buffer, size_t len )
+{
+    ssize_t ret;
+
+    while (len)
+    {
+        if ((ret = write( debug_fd, buffer, len )) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        buffer += ret;
+        len -= ret;
+    }
+}
+
+/* write out as many complete records as fit in the buffer, return FALSE if there was nothing to write */
+static BOOL ring_flush( char *buffer )
+{
+    size_t tail = __atomic_load_n( &ring_tail, __ATOMIC_RELAXED );
+    size_t pos, size, len = 0;
+    struct debug_record *rec;
+    unsigned int dropped;
+
+    for (;;)
+    {
+        pos = tail & (DEBUG_RING_SIZE - 1);
+        rec = (struct debug_record *)(debug_ring + pos);
+        if (!__atomic_load_n( &rec->ready, __ATOMIC_ACQUIRE )) break;
+        if (len + rec->len > DEBUG_WRITE_SIZE) break;
+
+        size = record_size( rec->len );
+        ring_copy( buffer + len, debug_ring + ((pos + sizeof(*rec)) & (DEBUG_RING_SIZE - 1)), rec->len, FALSE );
+        len += rec->len;
+
+        /* clear the whole record, a later record header may end up anywhere in it */
+        memset( debug_ring + pos, 0, min( size, DEBUG_RING_SIZE - pos ));
+        if (size > DEBUG_RING_SIZE - pos) memset( debug_ring, 0, size - (DEBUG_RING_SIZE - pos) );
+        tail += size;
+    }
+    __atomic_store_n( &ring_tail, tail, __ATOMIC_RELEASE );
+
+    if ((dropped = __atomic_exchange_n( &ring_dropped, 0, __ATOMIC_RELAXED )))
+        len += snprintf( buffer + len, DEBUG_WRITE_SIZE + 64 - len, "%04x:dropped %u debug lines\n",
+                         (int)getpid(), dropped );
+    if (!len) return FALSE;
+    write_all( buffer, len );
+    return TRUE;
+}
+
+static void *debug_writer_thread( void *arg )
+{
+    static const struct timespec timeout = { 0, 100000000 };  /* 100 ms */
+    static char buffer[DEBUG_WRITE_SIZE + 64];
+    struct debug_record *rec;
+
+    for (;;)
+    {
+        if (ring_flush( buffer )) continue;
+
+        rec = (struct debug_record *)(debug_ring + (ring_tail & (DEBUG_RING_SIZE - 1)));
+        __atomic_store_n( &ring_waiting, 1, __ATOMIC_SEQ_CST );
+        if (!__atomic_load_n( &rec->ready, __ATOMIC_SEQ_CST ))
+            ring_futex_wait( &ring_waiting, 1, &timeout );
+        __atomic_store_n( &ring_waiting, 0, __ATOMIC_RELAXED );
+    }
+    return NULL;
+}
+
+/* wait for the writer thread to write out everything queued so far */
+static void ring_wait_empty(void)
+{
+    static const struct timespec delay = { 0, 1000000 };  /* 1 ms */
+    size_t head = __atomic_load_n( &ring_head, __ATOMIC_ACQUIRE );
+    unsigned int i;
+
+    for (i = 0; i < 1000; i++)
+    {
+        if ((ptrdiff_t)(__atomic_load_n( &ring_tail, __ATOMIC_ACQUIRE ) - head) >= 0) break;
+        __atomic_store_n( &ring_waiting, 0, __ATOMIC_RELAXED );
+        ring_futex_wake( &ring_waiting );
+        nanosleep( &delay, NULL );
+    }
+}
+
+/***********************************************************************
+ *		dbg_defer_quit
+ *
+ * Called from the SIGQUIT handler. Returns TRUE if the thread is in the middle of
+ * queuing a record, in which case it terminates itself once the record is published.
+ */
+BOOL dbg_defer_quit(void)
+{
+    struct debug_info *info;
+
+    if (!debug_ring) return FALSE;
+    info = get_info();
+    if (!(info->ring_state & RING_WRITING)) return FALSE;
+    info->ring_state |= RING_QUIT;
+    return TRUE;
+}
+
+/***********************************************************************
+ *		dbg_flush_output
+ *
+ * Write out the queued output before the process exits without running the atexit handlers.
+ */
+void dbg_flush_output(void)
+{
+    if (debug_ring) ring_wait_empty();
+}
+
+/* set up the debug output as requested by WINE_DEBUG_LOG and WINE_DEBUG_ASYNC */
+static void init_debug_output(void)
+{
+    const char *env;
+    sigset_t sigset, old_sigset;
+    pthread_t thread;
+    int fd;
+
+    if ((env = getenv( "WINE_DEBUG_LOG" )) && *env)
+    {
+        if ((fd = open( env, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666 )) != -1) debug_fd = fd;
+        else fprintf( stderr, "wine: cannot open debug log %s: %s\n", env, strerror( errno ));
+    }
+
+    if (!(env = getenv( "WINE_DEBUG_ASYNC" )) || !atoi( env )) return;
+
+    debug_ring = mmap( NULL, DEBUG_RING_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if (debug_ring == MAP_FAILED)
+    {
+        debug_ring = NULL;
+        return;
+    }
+
+    /* the writer thread doesn't have a TEB, make sure it never gets our signals */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_BLOCK, &sigset, &old_sigset );
+    if (pthread_create( &thread, NULL, debug_writer_thread, NULL ))
+    {
+        munmap( debug_ring, DEBUG_RING_SIZE );
+        debug_ring = NULL;
+    }
+    else
+    {
+        pthread_detach( thread );
+        atexit( ring_wait_empty );
+    }
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+}
+
 /* get the debug info pointer for the current thread */
 static inline struct debug_info *get_info(void)
 {
@@ -84,6 +357,7 @@ static int append_output( struct debug_info *info, const char *str, size_t len )
     {
        fprintf( stderr, "wine_dbg_output: debugstr buffer overflow (contents: '%s')\n", info->output );
        info->out_pos = 0;
+       dbg_flush_output();
        abort();
     }
     memcpy( info->output + info->out_pos, str, len );
@@ -258,7 +532,13 @@ const char * __cdecl __wine_dbg_strdup( const char *str )
  */
 int WINAPI __wine_dbg_write( const char *str, unsigned int len )
 {
-    return write( 2, str, len );
+    if (debug_ring)
+    {
+        if (len <= DEBUG_WRITE_SIZE) return ring_write( str, len );
+        /* too large for the ring, write it once the lines queued before it are out */
+        ring_wait_empty();
+    }
+    return write( debug_fd, str, len );
 }
 
 /***********************************************************************
@@ -331,6 +611,7 @@ void dbg_init(void)
     setbuf( stderr, NULL );
 
     if (nb_debug_options == -1) init_options();
+    init_debug_output();
 
     options = (struct __wine_debug_channel *)((char *)peb + (is_win64 ? 2 : 1) * page_size);
     memcpy( options, debug_options, nb_debug_options * sizeof(*options) );
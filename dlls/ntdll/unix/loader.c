@@ -691,21 +691,29 @@ static void init_paths( char *argv[] )
 }
 
 
-static void preloader_exec( char **argv )
+/* return the path of the preloader to use for a given loader, or NULL if we don't use one */
+static char *get_preloader_path( const char *loader )
 {
-    if (use_preloader)
-    {
-        static const char *preloader = "wine-preloader";
-        char *p;
+    const char *preloader = "wine-preloader";
+    const char *p;
+    char *ret;
+
+    if (!use_preloader) return NULL;
 
-        if (!(p = strrchr( argv[1], '/' ))) p = argv[1];
-        else p++;
+    if (!(p = strrchr( loader, '/' ))) p = loader;
+    else p++;
 
-        if (strlen(p) > 2 && !strcmp( p + strlen(p) - 2, "64" )) preloader = "wine64-preloader";
-        argv[0] = malloc( p - argv[1] + strlen(preloader) + 1 );
-        memcpy( argv[0], argv[1], p - argv[1] );
-        strcpy( argv[0] + (p - argv[1]), preloader );
+    if (strlen(p) > 2 && !strcmp( p + strlen(p) - 2, "64" )) preloader = "wine64-preloader";
+    if (!(ret = malloc( p - loader + strlen(preloader) + 1 ))) return NULL;
+    memcpy( ret, loader, p - loader );
+    strcpy( ret + (p - loader), preloader );
+    return ret;
+}
 
+static void preloader_exec( char **argv )
+{
+    if ((argv[0] = get_preloader_path( argv[1] )))
+    {
 #ifdef __APPLE__
         {
             posix_spawnattr_t attr;
@@ -721,46 +729,79 @@ static void preloader_exec( char **argv )
     execv( argv[1], argv + 1 );
 }
 
-static NTSTATUS loader_exec( const char *loader, char **argv, WORD machine )
+static void free_path_list( char **paths )
 {
-    char *p, *path;
+    unsigned int i;
+
+    if (!paths) return;
+    for (i = 0; paths[i]; i++) free( paths[i] );
+    free( paths );
+}
+
+/* build the list of paths where we look for the loader, in order of preference */
+static char **get_loader_paths( const char *loader, WORD machine, const char *loader_env )
+{
+    unsigned int count = 0, size = 8;
+    char *p, *path, **paths, **new_paths;
+
+    if (!(paths = malloc( size * sizeof(*paths) ))) return NULL;
 
     if (build_dir)
     {
-        argv[1] = build_path( build_dir, (machine == IMAGE_FILE_MACHINE_AMD64) ? "loader/wine64" : "loader/wine" );
-        preloader_exec( argv );
-        return STATUS_INVALID_IMAGE_FORMAT;
+        paths[count++] = build_path( build_dir, (machine == IMAGE_FILE_MACHINE_AMD64) ? "loader/wine64" : "loader/wine" );
+        paths[count] = NULL;
+        return paths;
     }
 
     if ((p = strrchr( loader, '/' ))) loader = p + 1;
 
-    argv[1] = build_path( bin_dir, loader );
-    preloader_exec( argv );
-
-    argv[1] = getenv( "WINELOADER" );
-    if (argv[1]) preloader_exec( argv );
+    paths[count++] = build_path( bin_dir, loader );
+    if (loader_env) paths[count++] = strdup( loader_env );
 
-    if ((path = getenv( "PATH" )))
+    if ((path = getenv( "PATH" )) && (path = strdup( path )))
     {
-        for (p = strtok( strdup( path ), ":" ); p; p = strtok( NULL, ":" ))
+        for (p = strtok( path, ":" ); p; p = strtok( NULL, ":" ))
         {
-            argv[1] = build_path( p, loader );
-            preloader_exec( argv );
+            if (count + 3 > size)
+            {
+                if (!(new_paths = realloc( paths, 2 * size * sizeof(*paths) ))) break;
+                paths = new_paths;
+                size *= 2;
+            }
+            paths[count++] = build_path( p, loader );
         }
+        free( path );
     }
 
-    argv[1] = build_path( BINDIR, loader );
-    preloader_exec( argv );
+    paths[count++] = build_path( BINDIR, loader );
+    paths[count] = NULL;
+    return paths;
+}
+
+static NTSTATUS loader_exec( const char *loader, char **argv, WORD machine )
+{
+    char **paths = get_loader_paths( loader, machine, getenv( "WINELOADER" ) );
+    unsigned int i;
+
+    if (!paths) return STATUS_NO_MEMORY;
+    for (i = 0; paths[i]; i++)
+    {
+        argv[1] = paths[i];
+        preloader_exec( argv );
+    }
+    free_path_list( paths );
     return STATUS_INVALID_IMAGE_FORMAT;
 }
 
 
 /***********************************************************************
- *           exec_wineloader
+ *           get_wineloader_env
  *
- * argv[0] and argv[1] must be reserved for the preloader and loader respectively.
+ * Build the environment variables that need to be changed when starting a new loader.
+ * env must have room for LOADER_ENV_COUNT entries, which are NULL if unchanged.
  */
-NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_info )
+static NTSTATUS get_wineloader_env( char **argv, int socketfd, const pe_image_info_t *pe_info,
+                                    const char **loader_ret, WORD *machine_ret, char **env )
 {
     WORD machine = pe_info->machine;
     ULONGLONG res_start = pe_info->base;
@@ -768,8 +809,10 @@ NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_i
     const char *loader = argv0;
     const char *loader_env = getenv( "WINELOADER" );
     const char *ld_preload = getenv( "LD_PRELOAD" );
-    char preloader_reserve[64], socket_env[64];
     BOOL is_child_64bit;
+    unsigned int i;
+
+    memset( env, 0, LOADER_ENV_COUNT * sizeof(*env) );
 
     if (pe_info->image_flags & IMAGE_FLAGS_WineFakeDll) res_start = res_end = 0;
     if (pe_info->image_flags & IMAGE_FLAGS_ComPlusNativeReady) machine = native_machine;
@@ -782,22 +825,22 @@ NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_i
         if (loader_env)
         {
             int len = strlen( loader_env );
-            char *env = malloc( sizeof("WINELOADER=") + len + 2 );
+            char *var = malloc( sizeof("WINELOADER=") + len + 2 );
 
-            if (!env) return STATUS_NO_MEMORY;
-            strcpy( env, "WINELOADER=" );
-            strcat( env, loader_env );
+            if (!var) goto nomem;
+            strcpy( var, "WINELOADER=" );
+            strcat( var, loader_env );
             if (is_child_64bit)
             {
-                strcat( env, "64" );
+                strcat( var, "64" );
             }
             else
             {
                 len += sizeof("WINELOADER=") - 1;
-                if (!strcmp( env + len - 2, "64" )) env[len - 2] = 0;
+                if (!strcmp( var + len - 2, "64" )) var[len - 2] = 0;
             }
-            loader = env;
-            putenv( env );
+            loader = var;
+            env[0] = var;
         }
         else loader = is_child_64bit ? "wine64" : "wine";
     }
@@ -809,13 +852,13 @@ NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_i
         static char const gorso[] = "gameoverlayrenderer.so";
         static int gorso_len = sizeof(gorso) - 1;
         int len = strlen( ld_preload );
-        char *next, *tmp, *env = malloc( sizeof("LD_PRELOAD=") + len );
+        char *next, *tmp, *var = malloc( sizeof("LD_PRELOAD=") + len );
 
-        if (!env) return STATUS_NO_MEMORY;
-        strcpy( env, "LD_PRELOAD=" );
-        strcat( env, ld_preload );
+        if (!var) goto nomem;
+        strcpy( var, "LD_PRELOAD=" );
+        strcat( var, ld_preload );
 
-        tmp = env + 11;
+        tmp = var + 11;
         do
         {
             if (!(next = strchr( tmp, ':' ))) next = tmp + strlen( tmp );
@@ -829,22 +872,120 @@ NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_i
         }
         while (*next);
 
-        putenv( env );
+        env[1] = var;
     }
 
-    signal( SIGPIPE, SIG_DFL );
-
-    sprintf( socket_env, "WINESERVERSOCKET=%u", socketfd );
-    sprintf( preloader_reserve, "WINEPRELOADRESERVE=%x%08x-%x%08x",
+    if (!(env[2] = malloc( 64 )) || !(env[3] = malloc( 64 ))) goto nomem;
+    sprintf( env[2], "WINESERVERSOCKET=%u", socketfd );
+    sprintf( env[3], "WINEPRELOADRESERVE=%x%08x-%x%08x",
              (ULONG)(res_start >> 32), (ULONG)res_start, (ULONG)(res_end >> 32), (ULONG)res_end );
 
-    putenv( preloader_reserve );
-    putenv( socket_env );
+    *loader_ret = loader;
+    *machine_ret = machine;
+    return STATUS_SUCCESS;
+
+nomem:
+    for (i = 0; i < LOADER_ENV_COUNT; i++) free( env[i] );
+    return STATUS_NO_MEMORY;
+}
+
+
+/***********************************************************************
+ *           exec_wineloader
+ *
+ * argv[0] and argv[1] must be reserved for the preloader and loader respectively.
+ */
+NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_info )
+{
+    char *env[LOADER_ENV_COUNT];
+    const char *loader;
+    unsigned int i;
+    NTSTATUS status;
+    WORD machine;
+
+    if ((status = get_wineloader_env( argv, socketfd, pe_info, &loader, &machine, env ))) return status;
+    for (i = 0; i < LOADER_ENV_COUNT; i++) if (env[i]) putenv( env[i] );
+
+    signal( SIGPIPE, SIG_DFL );
 
     return loader_exec( loader, argv, machine );
 }
 
 
+#ifdef __linux__
+
+extern char **environ;
+
+/***********************************************************************
+ *           init_wineloader_spawn
+ *
+ * Prepare everything exec_wineloader would do, without changing our own state,
+ * so that the loader can be started with posix_spawn() from a vfork() child.
+ */
+NTSTATUS init_wineloader_spawn( struct wineloader_spawn *spawn, char **argv, int socketfd,
+                                const pe_image_info_t *pe_info, char *winedebug )
+{
+    unsigned int i, j, count, env_count;
+    const char *loader, *loader_env;
+    NTSTATUS status;
+    WORD machine;
+
+    memset( spawn, 0, sizeof(*spawn) );
+    if ((status = get_wineloader_env( argv, socketfd, pe_info, &loader, &machine, spawn->env ))) return status;
+    spawn->env[LOADER_ENV_COUNT] = winedebug;
+
+    /* build the new environment, replacing the variables we override */
+    for (env_count = 0; environ[env_count]; env_count++) ;
+    if (!(spawn->envp = malloc( (env_count + LOADER_ENV_COUNT + 2) * sizeof(*spawn->envp) ))) goto nomem;
+    for (i = count = 0; i < env_count; i++)
+    {
+        for (j = 0; j <= LOADER_ENV_COUNT; j++)
+        {
+            const char *eq;
+
+            if (!spawn->env[j]) continue;
+            eq = strchr( spawn->env[j], '=' );
+            if (!strncmp( environ[i], spawn->env[j], eq - spawn->env[j] + 1 )) break;
+        }
+        if (j > LOADER_ENV_COUNT) spawn->envp[count++] = environ[i];
+    }
+    for (j = 0; j <= LOADER_ENV_COUNT; j++) if (spawn->env[j]) spawn->envp[count++] = spawn->env[j];
+    spawn->envp[count] = NULL;
+
+    /* exec_wineloader puts the remapped WINELOADER in the environment before searching */
+    loader_env = spawn->env[0] ? spawn->env[0] + sizeof("WINELOADER=") - 1 : getenv( "WINELOADER" );
+    if (!(spawn->loaders = get_loader_paths( loader, machine, loader_env ))) goto nomem;
+    for (count = 0; spawn->loaders[count]; count++) ;
+    if (!(spawn->preloaders = calloc( count + 1, sizeof(*spawn->preloaders) ))) goto nomem;
+    for (i = 0; i < count; i++) spawn->preloaders[i] = get_preloader_path( spawn->loaders[i] );
+    return STATUS_SUCCESS;
+
+nomem:
+    free_wineloader_spawn( spawn );
+    return STATUS_NO_MEMORY;
+}
+
+
+/***********************************************************************
+ *           free_wineloader_spawn
+ */
+void free_wineloader_spawn( struct wineloader_spawn *spawn )
+{
+    unsigned int i;
+
+    if (spawn->preloaders)
+    {
+        for (i = 0; spawn->loaders[i]; i++) free( spawn->preloaders[i] );
+        free( spawn->preloaders );
+    }
+    free_path_list( spawn->loaders );
+    free( spawn->envp );
+    for (i = 0; i < LOADER_ENV_COUNT; i++) free( spawn->env[i] );
+}
+
+#endif  /* __linux__ */
+
+
 /***********************************************************************
  *           exec_wineserver
  *
@@ -28,6 +28,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
+#ifdef __linux__
+# include <spawn.h>
+#endif
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -420,6 +423,134 @@ static BOOL is_unix_console_handle( HANDLE handle )
 }
 
 
+/***********************************************************************
+ *           is_detached_console
+ *
+ * Check whether the new process needs its own session without stdin and stdout.
+ */
+static BOOL is_detached_console( const RTL_USER_PROCESS_PARAMETERS *params )
+{
+    return params->ConsoleFlags ||
+           params->ConsoleHandle == CONSOLE_HANDLE_ALLOC ||
+           (params->hStdInput == INVALID_HANDLE_VALUE && params->hStdOutput == INVALID_HANDLE_VALUE);
+}
+
+
+#ifdef __linux__
+
+extern char **environ;
+
+/***********************************************************************
+ *           spawn_detached
+ *
+ * Start a new process without copying our address space, and without
+ * making it our child. A vfork() child sets up the standard handles, the
+ * session and the current directory, calls func to start the process with
+ * posix_spawn(), and exits right away so that the new process gets
+ * reparented. Returns an errno value.
+ */
+static int spawn_detached( int (*func)( void *arg, const posix_spawnattr_t *attr ), void *arg,
+                           int stdin_fd, int stdout_fd, BOOL new_session, int unixdir )
+{
+    posix_spawnattr_t attr;
+    sigset_t all_set, old_set, default_set;
+    volatile int err;
+    pid_t pid, wret;
+
+    if ((err = posix_spawnattr_init( &attr ))) return err;
+
+    /* the vfork() child runs on our stack, make sure none of our signal handlers run there */
+    sigfillset( &all_set );
+    pthread_sigmask( SIG_BLOCK, &all_set, &old_set );
+
+    /* reset signals that we previously set to SIG_IGN */
+    sigemptyset( &default_set );
+    sigaddset( &default_set, SIGPIPE );
+    posix_spawnattr_setsigmask( &attr, &old_set );
+    posix_spawnattr_setsigdefault( &attr, &default_set );
+    posix_spawnattr_setflags( &attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF );
+
+    if (!(pid = vfork()))  /* child */
+    {
+        if (new_session)
+        {
+            setsid();
+            set_stdio_fd( -1, -1 );  /* close stdin and stdout */
+        }
+        else set_stdio_fd( stdin_fd, stdout_fd );
+
+        if (stdin_fd != -1 && stdin_fd != 0) close( stdin_fd );
+        if (stdout_fd != -1 && stdout_fd != 1) close( stdout_fd );
+
+        if (unixdir != -1)
+        {
+            fchdir( unixdir );
+            close( unixdir );
+        }
+        err = func( arg, &attr );
+        _exit(0);
+    }
+
+    if (pid != -1)
+    {
+        /* reap child */
+        do {
+            wret = waitpid(pid, NULL, 0);
+        } while (wret < 0 && errno == EINTR);
+    }
+    else err = errno;
+
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    posix_spawnattr_destroy( &attr );
+    return err;
+}
+
+struct spawn_exec_params
+{
+    const char *path;
+    char      **argv;
+    char      **envp;
+    BOOL        search_path;
+};
+
+static int spawn_exec( void *arg, const posix_spawnattr_t *attr )
+{
+    struct spawn_exec_params *params = arg;
+    pid_t pid;
+
+    if (params->search_path) return posix_spawnp( &pid, params->path, NULL, attr, params->argv, params->envp );
+    return posix_spawn( &pid, params->path, NULL, attr, params->argv, params->envp );
+}
+
+struct spawn_loader_params
+{
+    struct wineloader_spawn *spawn;
+    char **argv;
+};
+
+/* same as exec_wineloader, but with posix_spawn() */
+static int spawn_loader( void *arg, const posix_spawnattr_t *attr )
+{
+    struct spawn_loader_params *params = arg;
+    struct wineloader_spawn *spawn = params->spawn;
+    char **argv = params->argv;
+    unsigned int i;
+    pid_t pid;
+
+    for (i = 0; spawn->loaders[i]; i++)
+    {
+        argv[1] = spawn->loaders[i];
+        if ((argv[0] = spawn->preloaders[i]) &&
+            !posix_spawn( &pid, argv[0], NULL, attr, argv, spawn->envp ))
+            return 0;
+        if (!posix_spawn( &pid, argv[1], NULL, attr, argv + 1, spawn->envp )) return 0;
+    }
+    return ENOEXEC;
+}
+
+#endif  /* __linux__ */
+
+
 /***********************************************************************
  *           spawn_process
  */
@@ -428,8 +559,10 @@ static NTSTATUS spawn_process( const RTL_USER_PROCESS_PARAMETERS *params, int so
 {
     NTSTATUS status = STATUS_SUCCESS;
     int stdin_fd = -1, stdout_fd = -1;
-    pid_t pid;
     char **argv;
+#ifndef __linux__
+    pid_t pid;
+#endif
 
     if (wine_server_handle_to_fd( params->hStdInput, FILE_READ_DATA, &stdin_fd, NULL ) &&
         isatty(0) && is_unix_console_handle( params->hStdInput ))
@@ -439,13 +572,31 @@ static NTSTATUS spawn_process( const RTL_USER_PROCESS_PARAMETERS *params, int so
         isatty(1) && is_unix_console_handle( params->hStdOutput ))
         stdout_fd = 1;
 
+#ifdef __linux__
+    {
+        struct spawn_loader_params spawn_params;
+        struct wineloader_spawn spawn;
+        int err;
+
+        if (!(argv = build_argv( &params->CommandLine, 2 ))) status = STATUS_NO_MEMORY;
+        else if (!(status = init_wineloader_spawn( &spawn, argv, socketfd, pe_info, winedebug )))
+        {
+            spawn_params.spawn = &spawn;
+            spawn_params.argv = argv;
+            err = spawn_detached( spawn_loader, &spawn_params, stdin_fd, stdout_fd,
+                                  is_detached_console( params ), unixdir );
+            if (err == ENOEXEC) status = STATUS_INVALID_IMAGE_FORMAT;
+            else if (err) status = STATUS_NO_MEMORY;
+            free_wineloader_spawn( &spawn );
+        }
+        free( argv );
+    }
+#else
     if (!(pid = fork()))  /* child */
     {
         if (!(pid = fork()))  /* grandchild */
         {
-            if (params->ConsoleFlags ||
-                params->ConsoleHandle == CONSOLE_HANDLE_ALLOC ||
-                (params->hStdInput == INVALID_HANDLE_VALUE && params->hStdOutput == INVALID_HANDLE_VALUE))
+            if (is_detached_console( params ))
             {
                 setsid();
                 set_stdio_fd( -1, -1 );  /* close stdin and stdout */
@@ -479,6 +630,7 @@ static NTSTATUS spawn_process( const RTL_USER_PROCESS_PARAMETERS *params, int so
         } while (wret < 0 && errno == EINTR);
     }
     else status = STATUS_NO_MEMORY;
+#endif
 
     if (stdin_fd != -1 && stdin_fd != 0) close( stdin_fd );
     if (stdout_fd != -1 && stdout_fd != 1) close( stdout_fd );
@@ -494,6 +646,20 @@ NTSTATUS WINAPI __wine_unix_spawnvp( char * const argv[], int wait )
     pid_t pid, wret;
     int fd[2], status, err;
 
+#ifdef __linux__
+    if (!wait)
+    {
+        struct spawn_exec_params exec_params;
+
+        exec_params.path = argv[0];
+        exec_params.argv = (char **)argv;
+        exec_params.envp = environ;
+        exec_params.search_path = TRUE;
+        err = spawn_detached( spawn_exec, &exec_params, 0, 1, FALSE, -1 );
+        return err ? errno_to_status( err ) : STATUS_SUCCESS;
+    }
+#endif
+
 #ifdef HAVE_PIPE2
     if (pipe2( fd, O_CLOEXEC ) == -1)
 #endif
@@ -539,6 +705,23 @@ NTSTATUS WINAPI __wine_unix_spawnvp( char * const argv[], int wait )
 }
 
 
+/* map the errno of a failed exec to a status */
+static NTSTATUS exec_errno_to_status( int err )
+{
+    switch (err)
+    {
+    case EPERM:
+    case EACCES: return STATUS_ACCESS_DENIED;
+    case ENOENT: return STATUS_OBJECT_NAME_NOT_FOUND;
+    case EMFILE:
+    case ENFILE: return STATUS_TOO_MANY_OPENED_FILES;
+    case ENOEXEC:
+    case EINVAL: return STATUS_INVALID_IMAGE_FORMAT;
+    default:     return STATUS_NO_MEMORY;
+    }
+}
+
+
 /***********************************************************************
  *           fork_and_exec
  *
@@ -547,8 +730,14 @@ NTSTATUS WINAPI __wine_unix_spawnvp( char * const argv[], int wait )
 static NTSTATUS fork_and_exec( OBJECT_ATTRIBUTES *attr, int unixdir,
                                const RTL_USER_PROCESS_PARAMETERS *params )
 {
+#ifdef __linux__
+    struct spawn_exec_params exec_params;
+    int err;
+#else
     pid_t pid;
-    int fd[2], stdin_fd = -1, stdout_fd = -1;
+    int fd[2];
+#endif
+    int stdin_fd = -1, stdout_fd = -1;
     char **argv, **envp;
     char *unix_name;
     NTSTATUS status;
@@ -556,6 +745,33 @@ static NTSTATUS fork_and_exec( OBJECT_ATTRIBUTES *attr, int unixdir,
     status = nt_to_unix_file_name( attr, &unix_name, FILE_OPEN );
     if (status) return status;
 
+#ifdef __linux__
+    if (wine_server_handle_to_fd( params->hStdInput, FILE_READ_DATA, &stdin_fd, NULL ) &&
+        isatty(0) && is_unix_console_handle( params->hStdInput ))
+        stdin_fd = 0;
+
+    if (wine_server_handle_to_fd( params->hStdOutput, FILE_WRITE_DATA, &stdout_fd, NULL ) &&
+        isatty(1) && is_unix_console_handle( params->hStdOutput ))
+        stdout_fd = 1;
+
+    exec_params.path = unix_name;
+    exec_params.argv = argv = build_argv( &params->CommandLine, 0 );
+    exec_params.envp = envp = build_envp( params->Environment );
+    exec_params.search_path = FALSE;
+    if (argv && envp)
+    {
+        err = spawn_detached( spawn_exec, &exec_params, stdin_fd, stdout_fd,
+                              is_detached_console( params ), unixdir );
+        status = err ? exec_errno_to_status( err ) : STATUS_SUCCESS;
+    }
+    else status = STATUS_NO_MEMORY;
+    free( argv );
+    free( envp );
+
+    if (stdin_fd != -1 && stdin_fd != 0) close( stdin_fd );
+    if (stdout_fd != -1 && stdout_fd != 1) close( stdout_fd );
+#else
+
 #ifdef HAVE_PIPE2
     if (pipe2( fd, O_CLOEXEC ) == -1)
 #endif
@@ -583,9 +799,7 @@ static NTSTATUS fork_and_exec( OBJECT_ATTRIBUTES *attr, int unixdir,
         {
             close( fd[0] );
 
-            if (params->ConsoleFlags ||
-                params->ConsoleHandle == CONSOLE_HANDLE_ALLOC ||
-                (params->hStdInput == INVALID_HANDLE_VALUE && params->hStdOutput == INVALID_HANDLE_VALUE))
+            if (is_detached_console( params ))
             {
                 setsid();
                 set_stdio_fd( -1, -1 );  /* close stdin and stdout */
@@ -610,17 +824,7 @@ static NTSTATUS fork_and_exec( OBJECT_ATTRIBUTES *attr, int unixdir,
 
         if (pid <= 0)  /* grandchild if exec failed or child if fork failed */
         {
-            switch (errno)
-            {
-            case EPERM:
-            case EACCES: status = STATUS_ACCESS_DENIED; break;
-            case ENOENT: status = STATUS_OBJECT_NAME_NOT_FOUND; break;
-            case EMFILE:
-            case ENFILE: status = STATUS_TOO_MANY_OPENED_FILES; break;
-            case ENOEXEC:
-            case EINVAL: status = STATUS_INVALID_IMAGE_FORMAT; break;
-            default:     status = STATUS_NO_MEMORY; break;
-            }
+            status = exec_errno_to_status( errno );
             write( fd[1], &status, sizeof(status) );
             _exit(1);
         }
@@ -643,6 +847,7 @@ static NTSTATUS fork_and_exec( OBJECT_ATTRIBUTES *attr, int unixdir,
     if (stdin_fd != -1 && stdin_fd != 0) close( stdin_fd );
     if (stdout_fd != -1 && stdout_fd != 1) close( stdout_fd );
 done:
+#endif
     free( unix_name );
     return status;
 }
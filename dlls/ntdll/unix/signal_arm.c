@@ -1029,6 +1029,7 @@ static void abrt_handler( int signal, siginfo_t *siginfo, void *sigcontext )
  */
 static void quit_handler( int signal, siginfo_t *siginfo, void *sigcontext )
 {
+    if (dbg_defer_quit()) return;
     abort_thread(0);
 }
 
@@ -2049,6 +2049,7 @@ static void abrt_handler( int signal, siginfo_t *siginfo, void *sigcontext )
 static void quit_handler( int signal, siginfo_t *siginfo, void *sigcontext )
 {
     init_handler( sigcontext );
+    if (dbg_defer_quit()) return;
     abort_thread(0);
 }
 
@@ -3070,6 +3070,7 @@ static void abrt_handler( int signal, siginfo_t *siginfo, void *sigcontext )
 static void quit_handler( int signal, siginfo_t *siginfo, void *ucontext )
 {
     init_handler( ucontext );
+    if (dbg_defer_quit()) return;
     abort_thread(0);
 }
 
@@ -27,7 +27,11 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <unistd.h>
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_IFADDRS_H
 # include <ifaddrs.h>
 #endif
@@ -148,6 +152,7 @@ struct async_transmit_ioctl
     unsigned int head_len;
     unsigned int tail_len;
     LARGE_INTEGER offset;
+    BOOL use_sendfile;          /* send file data directly from the file descriptor */
 };
 
 static NTSTATUS sock_errno_to_status( int err )
@@ -944,6 +949,56 @@ static ssize_t do_send( int fd, const void *buffer, size_t len, int flags )
     return ret;
 }
 
+#ifdef __linux__
+/* send the next chunk of file data without going through the buffer */
+static NTSTATUS try_sendfile( int sock_fd, int file_fd, struct async_transmit_ioctl *async )
+{
+    size_t send_size = async->buffer_size;
+    off_t offset;
+    ssize_t ret;
+
+    if (async->file_len)
+        send_size = min( send_size, async->file_len - async->file_cursor );
+
+    TRACE( "sending %zu bytes of file data with sendfile\n", send_size );
+    do
+    {
+        if (async->offset.QuadPart == FILE_USE_FILE_POINTER_POSITION)
+            ret = sendfile( sock_fd, file_fd, NULL, send_size );
+        else
+        {
+            offset = async->offset.QuadPart;
+            ret = sendfile( sock_fd, file_fd, &offset, send_size );
+        }
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0)
+    {
+        if (errno == EINVAL || errno == ENOSYS)
+        {
+            /* not supported for this file or socket, fall back to read/send */
+            TRACE( "sendfile not supported, falling back to read/send\n" );
+            async->use_sendfile = FALSE;
+            return STATUS_SUCCESS;
+        }
+        if (errno != EWOULDBLOCK) WARN( "sendfile: %s\n", strerror( errno ) );
+        return sock_errno_to_status( errno );
+    }
+    TRACE( "sendfile returned %zd\n", ret );
+
+    async->file_cursor += ret;
+    if (async->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+        async->offset.QuadPart += ret;
+
+    if (!ret || (async->file_len && async->file_cursor == async->file_len))
+    {
+        async->file = NULL;
+        return STATUS_SUCCESS;
+    }
+    return STATUS_DEVICE_NOT_READY; /* still more data to send */
+}
+#endif
+
 static NTSTATUS try_transmit( int sock_fd, int file_fd, struct async_transmit_ioctl *async )
 {
     ssize_t ret;
@@ -969,6 +1024,14 @@ static NTSTATUS try_transmit( int sock_fd, int file_fd, struct async_transmit_io
         async->file_cursor += ret;
     }
 
+#ifdef __linux__
+    if (async->file && async->use_sendfile)
+    {
+        NTSTATUS status = try_sendfile( sock_fd, file_fd, async );
+        if (status) return status;
+    }
+#endif
+
     if (async->file && async->buffer_cursor == async->read_len)
     {
         unsigned int read_size = async->buffer_size;
@@ -1093,6 +1156,7 @@ static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc,
     async->tail = u64_to_user_ptr(params->tail_ptr);
     async->tail_len = params->tail_len;
     async->offset = params->offset;
+    async->use_sendfile = TRUE;
 
     SERVER_START_REQ( send_socket )
     {
@@ -1129,6 +1193,221 @@ static void complete_async( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
 }
 
 
+enum client_poll_state
+{
+    CLIENT_POLL_LISTENING,
+    CLIENT_POLL_CONNECTED,
+    CLIENT_POLL_CONNECTIONLESS,
+};
+
+struct client_poll_socket
+{
+    int fd;
+    int needs_close;
+    int stream;
+    enum client_poll_state state;
+};
+
+/* the server only notices that a nonblocking connect completed when it polls the
+ * socket, and keeps reporting it as connecting until then */
+static BOOL is_server_sock_connected( HANDLE handle )
+{
+    IO_STATUS_BLOCK io;
+    DWORD time;
+
+    return !NtDeviceIoControlFile( handle, NULL, NULL, NULL, &io, IOCTL_AFD_WINE_GET_SO_CONNECT_TIME,
+                                   NULL, 0, &time, sizeof(time) ) && time != ~0u;
+}
+
+/* determine the state of a socket from its unix fd; returns FALSE if only the server can tell */
+static BOOL get_client_poll_state( struct client_poll_socket *sock, HANDLE handle, int mask )
+{
+    union unix_sockaddr addr;
+    socklen_t len = sizeof(int);
+    int type, value;
+
+    if (getsockopt( sock->fd, SOL_SOCKET, SO_TYPE, &type, &len )) return FALSE;
+
+    if (type == SOCK_STREAM)
+    {
+        sock->stream = TRUE;
+        len = sizeof(value);
+        if (!getsockopt( sock->fd, SOL_SOCKET, SO_ACCEPTCONN, &value, &len ) && value)
+        {
+            sock->state = CLIENT_POLL_LISTENING;
+            return TRUE;
+        }
+        /* unconnected and connecting sockets need the server state */
+        len = sizeof(addr);
+        if (getpeername( sock->fd, &addr.addr, &len )) return FALSE;
+        /* AFD_POLL_CONNECT follows the server state, which may still be connecting */
+        if ((mask & AFD_POLL_CONNECT) && !is_server_sock_connected( handle )) return FALSE;
+        sock->state = CLIENT_POLL_CONNECTED;
+        return TRUE;
+    }
+    if (type == SOCK_DGRAM)
+    {
+        sock->stream = FALSE;
+        len = sizeof(addr);
+        sock->state = getpeername( sock->fd, &addr.addr, &len ) ? CLIENT_POLL_CONNECTIONLESS : CLIENT_POLL_CONNECTED;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static int is_oobinline( int fd )
+{
+    int oobinline;
+    socklen_t len = sizeof(oobinline);
+    return !getsockopt( fd, SOL_SOCKET, SO_OOBINLINE, (char *)&oobinline, &len ) && oobinline;
+}
+
+/* convert AFD_POLL_* flags to poll() events, see poll_flags_from_afd() in the server */
+static short client_poll_events( const struct client_poll_socket *sock, int flags )
+{
+    short ev = 0;
+
+    if (flags & (AFD_POLL_READ | AFD_POLL_ACCEPT))
+        ev |= POLLIN;
+    if ((flags & AFD_POLL_HUP) && sock->stream)
+        ev |= POLLIN;
+    if (flags & AFD_POLL_OOB)
+        ev |= is_oobinline( sock->fd ) ? POLLIN : POLLPRI;
+    if (flags & AFD_POLL_WRITE)
+        ev |= POLLOUT;
+    return ev;
+}
+
+/* convert poll() events to AFD_POLL_* flags, see get_poll_flags() in the server */
+static int client_poll_flags( const struct client_poll_socket *sock, int mask, short revents )
+{
+    int flags = 0;
+
+    if ((mask & AFD_POLL_HUP) && (revents & POLLIN) && sock->stream)
+    {
+        char dummy;
+
+        if (!recv( sock->fd, &dummy, 1, MSG_PEEK ))
+        {
+            revents &= ~POLLIN;
+            revents |= POLLHUP;
+        }
+    }
+
+    if (revents & POLLIN)
+        flags |= (sock->state == CLIENT_POLL_LISTENING) ? AFD_POLL_ACCEPT : AFD_POLL_READ;
+    if (revents & POLLPRI)
+        flags |= is_oobinline( sock->fd ) ? AFD_POLL_READ : AFD_POLL_OOB;
+    if (revents & POLLOUT)
+        flags |= AFD_POLL_WRITE;
+    if (sock->state == CLIENT_POLL_CONNECTED)
+        flags |= AFD_POLL_CONNECT;
+    if (revents & POLLHUP)
+        flags |= AFD_POLL_HUP;
+
+    return flags & mask;
+}
+
+/* Try to satisfy a poll request without going through the server. This is only
+ * possible if the request completes immediately, i.e. if it has a zero timeout or
+ * one of the sockets is already signaled, and if we know the state of all the
+ * sockets. Blocking, exclusive and asynchronous polls are left to the server. */
+static NTSTATUS try_client_poll( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
+                                 IO_STATUS_BLOCK *io, const void *in_buffer, ULONG in_size,
+                                 void *out_buffer, ULONG out_size )
+{
+    const struct afd_poll_params *params = in_buffer;
+    struct afd_poll_params *output = out_buffer;
+    struct client_poll_socket *sockets;
+    struct pollfd *pollfds;
+    NTSTATUS status = STATUS_BAD_DEVICE_TYPE;
+    unsigned int i, count, signaled = 0;
+    enum server_fd_type type;
+    LONGLONG timeout;
+    BOOLEAN exclusive;
+    int fd, needs_close, ret;
+
+    if (in_wow64_call() || apc || apc_user) return STATUS_BAD_DEVICE_TYPE;
+    if (in_size < sizeof(*params) || out_size < in_size) return STATUS_BAD_DEVICE_TYPE;
+    if (!params->count || params->exclusive) return STATUS_BAD_DEVICE_TYPE;
+    if (in_size < offsetof( struct afd_poll_params, sockets[params->count] )) return STATUS_BAD_DEVICE_TYPE;
+
+    if (server_get_unix_fd( handle, 0, &fd, &needs_close, &type, NULL )) return STATUS_BAD_DEVICE_TYPE;
+    if (needs_close) close( fd );
+    if (type != FD_TYPE_SOCKET) return STATUS_BAD_DEVICE_TYPE;
+
+    count = params->count;
+    if (!(sockets = malloc( count * (sizeof(*sockets) + sizeof(*pollfds)) ))) return STATUS_BAD_DEVICE_TYPE;
+    pollfds = (struct pollfd *)(sockets + count);
+
+    for (i = 0; i < count; ++i)
+    {
+        if (server_get_unix_fd( (HANDLE)params->sockets[i].socket, 0, &sockets[i].fd,
+                                &sockets[i].needs_close, &type, NULL ))
+            break;
+        if (type != FD_TYPE_SOCKET || !get_client_poll_state( &sockets[i], (HANDLE)params->sockets[i].socket,
+                                                              params->sockets[i].flags ))
+        {
+            if (sockets[i].needs_close) close( sockets[i].fd );
+            break;
+        }
+        pollfds[i].fd = sockets[i].fd;
+        pollfds[i].events = client_poll_events( &sockets[i], params->sockets[i].flags );
+        pollfds[i].revents = 0;
+    }
+    if (i < count)
+    {
+        count = i;
+        goto done;
+    }
+
+    while ((ret = poll( pollfds, count, 0 )) < 0 && errno == EINTR);
+    if (ret < 0 || (!ret && params->timeout)) goto done;
+
+    /* the output buffer may be the same as the input, so only fill it in once we're done with the input */
+    for (i = 0; i < count; ++i)
+    {
+        int flags;
+
+        /* the server keeps track of socket errors, and reading SO_ERROR here would clear
+         * the pending error before the server sees it; let the server report it */
+        if (pollfds[i].revents & POLLERR) goto done;
+        flags = pollfds[i].revents ? client_poll_flags( &sockets[i], params->sockets[i].flags, pollfds[i].revents ) : 0;
+
+        if (flags) signaled++;
+        pollfds[i].revents = flags;
+    }
+    if (!signaled && params->timeout) goto done;
+
+    TRACE( "completing poll on the client side, %u sockets signaled\n", signaled );
+
+    timeout = params->timeout;
+    exclusive = params->exclusive;
+    for (i = 0, signaled = 0; i < count; ++i)
+    {
+        SOCKET socket = params->sockets[i].socket;
+
+        if (!pollfds[i].revents) continue;
+        output->sockets[signaled].socket = socket;
+        output->sockets[signaled].flags = pollfds[i].revents;
+        output->sockets[signaled].status = STATUS_SUCCESS;
+        signaled++;
+    }
+    output->timeout = timeout;
+    output->exclusive = exclusive;
+    memset( output->padding, 0, sizeof(output->padding) );
+    output->count = signaled;
+
+    status = STATUS_SUCCESS;
+    complete_async( handle, event, apc, apc_user, io, status, offsetof( struct afd_poll_params, sockets[signaled] ) );
+
+done:
+    for (i = 0; i < count; ++i)
+        if (sockets[i].needs_close) close( sockets[i].fd );
+    free( sockets );
+    return status;
+}
+
 static NTSTATUS do_getsockopt( HANDLE handle, IO_STATUS_BLOCK *io, int level,
                                int option, void *out_buffer, ULONG out_size )
 {
@@ -1237,7 +1516,7 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
             break;
 
         case IOCTL_AFD_POLL:
-            status = STATUS_BAD_DEVICE_TYPE;
+            status = try_client_poll( handle, event, apc, apc_user, io, in_buffer, in_size, out_buffer, out_size );
             break;
 
         case IOCTL_AFD_RECV:
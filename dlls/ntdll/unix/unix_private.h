@@ -155,6 +155,19 @@ extern void *create_startup_info( const UNICODE_STRING *nt_image, const RTL_USER
                                   DWORD *info_size ) DECLSPEC_HIDDEN;
 extern char **build_envp( const WCHAR *envW ) DECLSPEC_HIDDEN;
 extern NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_info ) DECLSPEC_HIDDEN;
+#define LOADER_ENV_COUNT 4  /* environment variables changed by exec_wineloader */
+#ifdef __linux__
+struct wineloader_spawn
+{
+    char **loaders;                    /* loader paths to try, NULL-terminated */
+    char **preloaders;                 /* matching preloader paths, or NULL */
+    char **envp;                       /* environment of the new process */
+    char  *env[LOADER_ENV_COUNT + 1];  /* variables overridden in envp */
+};
+extern NTSTATUS init_wineloader_spawn( struct wineloader_spawn *spawn, char **argv, int socketfd,
+                                       const pe_image_info_t *pe_info, char *winedebug ) DECLSPEC_HIDDEN;
+extern void free_wineloader_spawn( struct wineloader_spawn *spawn ) DECLSPEC_HIDDEN;
+#endif
 extern NTSTATUS load_builtin( const pe_image_info_t *image_info, WCHAR *filename,
                               void **addr_ptr, SIZE_T *size_ptr ) DECLSPEC_HIDDEN;
 extern BOOL is_builtin_path( const UNICODE_STRING *path, WORD *machine ) DECLSPEC_HIDDEN;
@@ -286,6 +299,8 @@ extern void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULO
 extern struct cpu_topology_override *get_cpu_topology_override(void) DECLSPEC_HIDDEN;
 
 extern void dbg_init(void) DECLSPEC_HIDDEN;
+extern void dbg_flush_output(void) DECLSPEC_HIDDEN;
+extern BOOL dbg_defer_quit(void) DECLSPEC_HIDDEN;
 
 extern NTSTATUS call_user_apc_dispatcher( CONTEXT *context_ptr, ULONG_PTR arg1, ULONG_PTR arg2, ULONG_PTR arg3,
                                           PNTAPCFUNC func, NTSTATUS status ) DECLSPEC_HIDDEN;
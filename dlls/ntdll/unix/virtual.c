@@ -151,6 +151,13 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 static struct wine_rb_tree views_tree;
 static pthread_mutex_t virtual_mutex;
 
+/* Sequence counter for lockless readers of the views tree and the page protection bytes.
+ * It is odd while virtual_mutex is held; readers retry or fall back to the mutex when
+ * it changes under them. The view structures and the page protection tables are never
+ * unmapped, so a reader racing with a writer can see stale data but never fault. */
+static unsigned int virtual_seq;
+static unsigned int virtual_lock_depth;  /* recursion count of virtual_mutex, owned by the holder */
+
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
 static const UINT_PTR granularity_mask = 0xffff;
@@ -220,6 +227,8 @@ static const size_t view_block_size = 0x100000;
 static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
+static size_t huge_page_size;  /* transparent huge page size, 0 if unsupported */
+static BOOL use_huge_pages;  /* whether to use huge pages for all large reservations */
 
 struct range_entry
 {
@@ -231,6 +240,58 @@ static struct range_entry *free_ranges;
 static struct range_entry *free_ranges_end;
 
 
+/***********************************************************************
+ *           virtual_lock
+ *
+ * Acquire virtual_mutex for modifying the views. sigset is NULL when called from a signal handler.
+ */
+static void virtual_lock( sigset_t *sigset )
+{
+    if (sigset) server_enter_uninterrupted_section( &virtual_mutex, sigset );
+    else mutex_lock( &virtual_mutex );
+    if (!virtual_lock_depth++)
+    {
+        __atomic_add_fetch( &virtual_seq, 1, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_RELEASE );
+    }
+}
+
+
+/***********************************************************************
+ *           virtual_unlock
+ */
+static void virtual_unlock( sigset_t *sigset )
+{
+    if (!--virtual_lock_depth) __atomic_add_fetch( &virtual_seq, 1, __ATOMIC_RELEASE );
+    if (sigset) server_leave_uninterrupted_section( &virtual_mutex, sigset );
+    else mutex_unlock( &virtual_mutex );
+}
+
+
+/***********************************************************************
+ *           virtual_read_begin
+ *
+ * Start a lockless read section. Returns FALSE if a writer is active.
+ */
+static inline BOOL virtual_read_begin( unsigned int *seq )
+{
+    *seq = __atomic_load_n( &virtual_seq, __ATOMIC_ACQUIRE );
+    return !(*seq & 1);
+}
+
+
+/***********************************************************************
+ *           virtual_read_retry
+ *
+ * Check whether the data read since virtual_read_begin() may be inconsistent.
+ */
+static inline BOOL virtual_read_retry( unsigned int seq )
+{
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return __atomic_load_n( &virtual_seq, __ATOMIC_RELAXED ) != seq;
+}
+
+
 static inline BOOL is_beyond_limit( const void *addr, size_t size, const void *limit )
 {
     return (addr >= limit || (const char *)addr + size > (const char *)limit);
@@ -635,7 +696,7 @@ void *get_builtin_so_handle( void *module )
     void *ret = NULL;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -643,7 +704,7 @@ void *get_builtin_so_handle( void *module )
         if (ret) builtin->refcount++;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -658,7 +719,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
     NTSTATUS status = STATUS_DLL_NOT_FOUND;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -669,7 +730,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
         }
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -685,7 +746,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
     struct builtin_module *builtin;
 
     if (!(handle = dlopen( name, RTLD_NOW ))) return status;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -697,7 +758,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
         else status = STATUS_IMAGE_ALREADY_LOADED;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     if (status) dlclose( handle );
     return status;
 }
@@ -1118,12 +1179,12 @@ static void VIRTUAL_Dump(void)
     struct file_view *view;
 
     TRACE( "Dump of all virtual memory views:\n" );
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         dump_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 }
 #endif
 
@@ -1159,6 +1220,35 @@ static struct file_view *find_view( const void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           find_view_lockless
+ *
+ * Same as find_view() but without holding virtual_mutex. The result must be validated
+ * with virtual_read_retry(); a concurrent rebalance can make the walk arbitrarily
+ * wrong, so it is bounded by the maximum height of a red-black tree.
+ */
+static struct file_view *find_view_lockless( const void *addr, size_t size )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    unsigned int depth = 2 * 8 * sizeof(void *);
+
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+
+    while (ptr && depth--)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+        const char *base = view->base;
+        size_t view_size = view->size;
+
+        if (base > (const char *)addr) ptr = ptr->left;
+        else if (base + view_size <= (const char *)addr) ptr = ptr->right;
+        else if (base + view_size < (const char *)addr + size) break;  /* size too large */
+        else return view;
+    }
+    return NULL;
+}
+
+
 /***********************************************************************
  *           get_zero_bits_mask
  */
@@ -1961,6 +2051,50 @@ static void *alloc_free_area( void *limit, size_t size, BOOL top_down, int unix_
     return area.result;
 }
 
+/***********************************************************************
+ *           is_huge_page_area
+ *
+ * Check whether a new view should be backed by transparent huge pages.
+ */
+static inline BOOL is_huge_page_area( size_t size, unsigned int vprot )
+{
+    if (!huge_page_size || size < huge_page_size) return FALSE;
+    if (vprot & (VPROT_SYSTEM | SEC_FILE | SEC_IMAGE)) return FALSE;
+    return use_huge_pages || (vprot & SEC_LARGE_PAGES);
+}
+
+
+/***********************************************************************
+ *           align_huge_page_area
+ *
+ * Release the extra space around a free area to align it to the huge page size.
+ * virtual_mutex must be held by caller.
+ */
+static void *align_huge_page_area( char *ptr, size_t size, size_t extra )
+{
+    char *start = ROUND_ADDR( ptr + huge_page_size - 1, huge_page_size - 1 );
+
+    if (start > ptr) unmap_area( ptr, start - ptr );
+    if (start + size < ptr + size + extra) unmap_area( start + size, ptr + extra - start );
+    return start;
+}
+
+
+/***********************************************************************
+ *           set_huge_page_area
+ *
+ * Ask the kernel to back the area with transparent huge pages.
+ */
+static void set_huge_page_area( void *base, size_t size )
+{
+#ifdef MADV_HUGEPAGE
+    TRACE( "using huge pages for %p-%p\n", base, (char *)base + size );
+    if (madvise( base, size, MADV_HUGEPAGE ))
+        WARN( "madvise MADV_HUGEPAGE failed for %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+#endif
+}
+
+
 /***********************************************************************
  *           map_fixed_area
  *
@@ -2032,6 +2166,8 @@ static void clear_native_views(void)
 static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
                           int top_down, unsigned int vprot, ULONG_PTR zero_bits )
 {
+    BOOL huge = is_huge_page_area( size, vprot );
+    size_t extra = huge ? huge_page_size - (granularity_mask + 1) : 0;
     void *ptr;
     NTSTATUS status;
 
@@ -2043,18 +2179,23 @@ static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
         if (status != STATUS_SUCCESS) return status;
         ptr = base;
     }
-    else if (!(ptr = alloc_free_area( (void*)(get_zero_bits_mask( zero_bits )
-            & (UINT_PTR)user_space_limit), size, top_down, get_unix_prot( vprot ) )))
+    else
     {
-        WARN("Allocation failed, clearing native views.\n");
-
-        clear_native_views();
         if (!(ptr = alloc_free_area( (void*)(get_zero_bits_mask( zero_bits )
-                & (UINT_PTR)user_space_limit), size, top_down, get_unix_prot( vprot ) )))
-            return STATUS_NO_MEMORY;
+                & (UINT_PTR)user_space_limit), size + extra, top_down, get_unix_prot( vprot ) )))
+        {
+            WARN("Allocation failed, clearing native views.\n");
+
+            clear_native_views();
+            if (!(ptr = alloc_free_area( (void*)(get_zero_bits_mask( zero_bits )
+                    & (UINT_PTR)user_space_limit), size + extra, top_down, get_unix_prot( vprot ) )))
+                return STATUS_NO_MEMORY;
+        }
+        if (extra) ptr = align_huge_page_area( ptr, size, extra );
     }
     status = create_view( view_ret, ptr, size, vprot );
     if (status != STATUS_SUCCESS) unmap_area( ptr, size );
+    else if (huge) set_huge_page_area( ptr, size );
     return status;
 }
 
@@ -2548,7 +2689,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     }
 
     status = STATUS_INVALID_PARAMETER;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     base = wine_server_get_ptr( image_info->base );
     if ((ULONG_PTR)base != image_info->base) base = NULL;
@@ -2583,7 +2724,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     if (needs_close) close( unix_fd );
     if (shared_needs_close) close( shared_fd );
     return status;
@@ -2677,7 +2818,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
 
     if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL ))) return res;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits );
     if (res) goto done;
@@ -2708,7 +2849,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     if (needs_close) close( unix_handle );
     return res;
 }
@@ -2744,6 +2885,35 @@ static int alloc_virtual_heap( void *base, SIZE_T size, void *arg )
     return (alloc->base != MAP_FAILED);
 }
 
+/***********************************************************************
+ *           get_huge_page_size
+ *
+ * Return the size of transparent huge pages, or 0 if they aren't available.
+ */
+static size_t get_huge_page_size(void)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    unsigned long size = 0;
+    char buffer[32];
+    int fd, len;
+
+    if ((fd = open( "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", O_RDONLY )) == -1) return 0;
+    if ((len = read( fd, buffer, sizeof(buffer) - 1 )) > 0)
+    {
+        buffer[len] = 0;
+        size = strtoul( buffer, NULL, 10 );
+    }
+    close( fd );
+    /* must be a power of two multiple of the allocation granularity */
+    if (size <= granularity_mask || (size & (size - 1))) return 0;
+    TRACE( "huge page size %#lx\n", size );
+    return size;
+#else
+    return 0;
+#endif
+}
+
+
 /***********************************************************************
  *           virtual_init
  */
@@ -2780,6 +2950,14 @@ void virtual_init(void)
             MESSAGE("wine: using kernel write watches (experimental).\n");
     }
 
+    huge_page_size = get_huge_page_size();
+    if (huge_page_size && (env_var = getenv("WINE_HUGEPAGES")) && atoi(env_var))
+    {
+        use_huge_pages = TRUE;
+        if (ERR_ON(virtual))
+            MESSAGE("wine: using transparent huge pages for large allocations.\n");
+    }
+
     if (preload_info && *preload_info)
         for (i = 0; (*preload_info)[i].size; i++)
             mmap_add_reserved_area( (*preload_info)[i].addr, (*preload_info)[i].size );
@@ -2943,7 +3121,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
     void *base = wine_server_get_ptr( info->base );
     int i;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     status = create_view( &view, base, size, SEC_IMAGE | SEC_FILE | VPROT_SYSTEM |
                           VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY | VPROT_EXEC );
     if (!status)
@@ -2982,7 +3160,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
         }
         else delete_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     return status;
 }
@@ -3091,7 +3269,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     SIZE_T block_size = signal_stack_mask + 1;
     BOOL is_wow = !!NtCurrentTeb()->WowTebOffset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (next_free_teb)
     {
         ptr = next_free_teb;
@@ -3107,7 +3285,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
             if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, is_win64 && is_wow ? 0x7fffffff : 0,
                                                    &total, MEM_RESERVE, PAGE_READWRITE )))
             {
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                virtual_unlock( &sigset );
                 return status;
             }
             teb_block = ptr;
@@ -3118,14 +3296,14 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
                                  MEM_COMMIT, PAGE_READWRITE );
     }
     *ret_teb = teb = init_teb( ptr, is_wow );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     if ((status = signal_alloc_thread( teb )))
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         *(void **)ptr = next_free_teb;
         next_free_teb = ptr;
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
     }
     return status;
 }
@@ -3159,13 +3337,13 @@ void virtual_free_teb( TEB *teb )
         NtFreeVirtualMemory( GetCurrentProcess(), &ptr, &size, MEM_RELEASE );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     list_remove( &thread_data->entry );
     ptr = teb;
     if (!is_win64) ptr = (char *)ptr - teb_offset;
     *(void **)ptr = next_free_teb;
     next_free_teb = ptr;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 }
 
 
@@ -3179,7 +3357,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 
     if (index < TLS_MINIMUM_AVAILABLE)
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3190,14 +3368,14 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             teb->TlsSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
     }
     else
     {
         index -= TLS_MINIMUM_AVAILABLE;
         if (index >= 8 * sizeof(peb->TlsExpansionBitmapBits)) return STATUS_INVALID_PARAMETER;
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3212,7 +3390,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             if (teb->TlsExpansionSlots) teb->TlsExpansionSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
     }
     return STATUS_SUCCESS;
 }
@@ -3236,7 +3414,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     if (size < 1024 * 1024) size = 1024 * 1024;  /* Xlib needs a large stack */
     size = (size + 0xffff) & ~0xffff;  /* round to 64K boundary */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if ((status = map_view( &view, NULL, size + extra_size, FALSE,
                             VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, zero_bits )) != STATUS_SUCCESS)
@@ -3277,7 +3455,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     stack->StackBase = (char *)view->base + view->size;
     stack->StackLimit = (char *)view->base + 2 * page_size;
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -3386,6 +3564,46 @@ static inline BOOL is_system_range( const void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           handle_fault_lockless
+ *
+ * Resolve a fault that doesn't require changing any page state without taking virtual_mutex.
+ * Returns FALSE if the fault has to be handled with the mutex held.
+ */
+static BOOL handle_fault_lockless( char *page, DWORD err, void *stack, NTSTATUS *ret )
+{
+    struct file_view *view;
+    unsigned int seq;
+    BYTE vprot;
+    BOOL done;
+
+    do
+    {
+        if (!virtual_read_begin( &seq )) return FALSE;
+        vprot = get_page_vprot( page );
+        *ret = STATUS_ACCESS_VIOLATION;
+        done = TRUE;
+        if (!is_inside_signal_stack( stack ) && (vprot & VPROT_GUARD)) done = FALSE;
+        else if (!use_kernel_writewatch && err & EXCEPTION_WRITE_FAULT)
+        {
+            if (vprot & VPROT_WRITEWATCH) done = FALSE;
+            else if (get_unix_prot( vprot ) & PROT_WRITE)
+            {
+                /* page is writable now, another thread already handled the fault */
+                view = find_view_lockless( page, page_size );
+                if (view && (view->protect & VPROT_WRITEWATCH)) *ret = STATUS_SUCCESS;
+            }
+        }
+        else if (!err && (get_unix_prot( vprot ) & PROT_READ))
+        {
+            view = find_view_lockless( page, page_size );
+            if (view && (view->protect & VPROT_SYSTEM)) done = FALSE;
+        }
+    } while (virtual_read_retry( seq ));
+    return done;
+}
+
+
 /***********************************************************************
  *           virtual_handle_fault
  */
@@ -3395,7 +3613,9 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
     char *page = ROUND_ADDR( addr, page_mask );
     BYTE vprot;
 
-    mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+    if (handle_fault_lockless( page, err, stack, &ret )) return ret;
+
+    virtual_lock( NULL );  /* no need for signal masking inside signal handler */
     vprot = get_page_vprot( page );
     if (!is_inside_signal_stack( stack ) && (vprot & VPROT_GUARD))
     {
@@ -3437,7 +3657,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
         else
             set_page_vprot_bits( page, page_size, 0, VPROT_READ | VPROT_EXEC );
     }
-    mutex_unlock( &virtual_mutex );
+    virtual_unlock( NULL );
     return ret;
 }
 
@@ -3477,14 +3697,14 @@ void *virtual_setup_exception( void *stack_ptr, size_t size, EXCEPTION_RECORD *r
     }
     else if (stack < stack_info.limit)
     {
-        mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+        virtual_lock( NULL );  /* no need for signal masking inside signal handler */
         if ((get_page_vprot( stack ) & VPROT_GUARD) &&
             grow_thread_stack( ROUND_ADDR( stack, page_mask ), &stack_info ))
         {
             rec->ExceptionCode = STATUS_STACK_OVERFLOW;
             rec->NumberParameters = 0;
         }
-        mutex_unlock( &virtual_mutex );
+        virtual_unlock( NULL );
     }
 #if defined(VALGRIND_MAKE_MEM_UNDEFINED)
     VALGRIND_MAKE_MEM_UNDEFINED( stack, size );
@@ -3533,14 +3753,14 @@ unsigned int virtual_locked_server_call( void *req_ptr )
 
     if (!size) return wine_server_call( req_ptr );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         ret = server_call_unlocked( req );
         if (has_write_watch) update_write_watches( addr, size, wine_server_reply_size( req ));
     }
     else memset( &req->u.reply, 0, sizeof(req->u.reply) );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -3557,14 +3777,14 @@ ssize_t virtual_locked_read( int fd, void *addr, size_t size )
     ssize_t ret = read( fd, addr, size );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = read( fd, addr, size );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     errno = err;
     return ret;
 }
@@ -3582,14 +3802,14 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
     ssize_t ret = pread( fd, addr, size, offset );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = pread( fd, addr, size, offset );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     errno = err;
     return ret;
 }
@@ -3608,7 +3828,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     ssize_t ret = recvmsg( fd, hdr, flags );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     for (i = 0; i < hdr->msg_iovlen; i++)
         if (check_write_access( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, &has_write_watch ))
             break;
@@ -3620,7 +3840,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     if (has_write_watch)
         while (i--) update_write_watches( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, 0 );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     errno = err;
     return ret;
 }
@@ -3632,13 +3852,22 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
 BOOL virtual_is_valid_code_address( const void *addr, SIZE_T size )
 {
     struct file_view *view;
+    unsigned int seq;
     BOOL ret = FALSE;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    if (virtual_read_begin( &seq ))
+    {
+        view = find_view_lockless( addr, size );
+        ret = view && !(view->protect & VPROT_SYSTEM);
+        if (!virtual_read_retry( seq )) return ret;
+    }
+
+    virtual_lock( &sigset );
     if ((view = find_view( addr, size )))
         ret = !(view->protect & VPROT_SYSTEM);  /* system views are not visible to the app */
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    else ret = FALSE;
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -3725,7 +3954,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
 
     if (!size) return 0;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if ((view = find_view( addr, size )))
     {
         if (!(view->protect & VPROT_SYSTEM))
@@ -3741,7 +3970,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
             }
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return bytes_read;
 }
 
@@ -3761,13 +3990,13 @@ NTSTATUS virtual_uninterrupted_write_memory( void *addr, const void *buffer, SIZ
 
     if (!size) return STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         memcpy( addr, buffer, size );
         if (has_write_watch) update_write_watches( addr, size, size );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -3782,7 +4011,7 @@ void virtual_set_force_exec( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!force_exec_prot != !enable)  /* change all existing views */
     {
         force_exec_prot = enable;
@@ -3800,7 +4029,7 @@ void virtual_set_force_exec( BOOL enable )
             mprotect_range( view->base, view->size, commit, 0 );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 }
 
 struct free_range
@@ -3966,15 +4195,25 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
     /* Compute the alloc type flags */
 
     if (!(type & (MEM_COMMIT | MEM_RESERVE | MEM_RESET)) ||
-        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET)))
+        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET | MEM_LARGE_PAGES)))
     {
         WARN("called with wrong alloc type flags (%08x) !\n", type);
         return STATUS_INVALID_PARAMETER;
     }
 
+    if (type & MEM_LARGE_PAGES)
+    {
+        /* large pages have to be reserved and committed at once, in large page units */
+        if ((type & (MEM_COMMIT | MEM_RESERVE)) != (MEM_COMMIT | MEM_RESERVE) || (type & MEM_WRITE_WATCH))
+            return STATUS_INVALID_PARAMETER;
+        if (!huge_page_size) WARN( "large pages not supported, using normal pages\n" );
+        else if ((size & (huge_page_size - 1)) || ((UINT_PTR)base & (huge_page_size - 1)))
+            return STATUS_INVALID_PARAMETER;
+    }
+
     /* Reserve the memory */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if ((type & MEM_RESERVE) || !base)
     {
@@ -3983,6 +4222,7 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
             if (type & MEM_COMMIT) vprot |= VPROT_COMMITTED;
             if (type & MEM_WRITE_WATCH) vprot |= VPROT_WRITEWATCH;
             if (protect & PAGE_NOCACHE) vprot |= SEC_NOCACHE;
+            if (type & MEM_LARGE_PAGES) vprot |= SEC_LARGE_PAGES;
 
             if (vprot & VPROT_WRITECOPY) status = STATUS_INVALID_PAGE_PROTECTION;
             else if (is_dos_memory) status = allocate_dos_memory( &view, vprot );
@@ -4015,7 +4255,7 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4083,7 +4323,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     if (size) size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     /* avoid freeing the DOS area when a broken app passes a NULL pointer */
     if (!base)
@@ -4125,7 +4365,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
         status = STATUS_INVALID_PARAMETER;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -4179,7 +4419,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if ((view = find_view( base, size )))
     {
@@ -4213,7 +4453,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4269,14 +4509,87 @@ static int get_free_mem_state_callback( void *start, SIZE_T size, void *arg )
     return 1;
 }
 
+/* find the view containing base and the bounds of the enclosing allocation */
+static struct file_view *find_alloc_range( char *base, char **alloc_base, char **alloc_end, BOOL lockless )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    unsigned int depth = 2 * 8 * sizeof(void *);
+    struct file_view *view;
+
+    *alloc_base = 0;
+    *alloc_end = working_set_limit;
+    while (ptr)
+    {
+        if (lockless && !depth--) return NULL;
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+        if ((char *)view->base > base)
+        {
+            *alloc_end = view->base;
+            ptr = ptr->left;
+        }
+        else if ((char *)view->base + view->size <= base)
+        {
+            *alloc_base = (char *)view->base + view->size;
+            ptr = ptr->right;
+        }
+        else
+        {
+            *alloc_base = view->base;
+            *alloc_end = (char *)view->base + view->size;
+            return view;
+        }
+    }
+    return NULL;
+}
+
+/* fill the memory information for a committed or reserved range inside a view */
+static void fill_view_memory_info( struct file_view *view, char *base, MEMORY_BASIC_INFORMATION *info )
+{
+    BYTE vprot;
+
+    info->RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
+    info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
+    info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
+    info->AllocationProtect = get_win32_prot( view->protect, view->protect );
+    if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
+    else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
+    else info->Type = MEM_PRIVATE;
+}
+
+/* try to get basic information about an allocated memory block without holding virtual_mutex */
+static BOOL get_basic_memory_info_lockless( char *base, MEMORY_BASIC_INFORMATION *info )
+{
+    struct file_view *view, snapshot;
+    char *alloc_base, *alloc_end;
+    unsigned int seq;
+    int retries = 4;
+
+    while (retries--)
+    {
+        if (!virtual_read_begin( &seq )) return FALSE;
+        if (!(view = find_alloc_range( base, &alloc_base, &alloc_end, TRUE ))) break;
+        snapshot = *view;
+        /* the snapshot has to be consistent before walking its page protection bytes */
+        if (virtual_read_retry( seq )) continue;
+        /* free areas are described by the reserved areas list, and SEC_RESERVE
+         * mappings need a server call, both require the mutex */
+        if (snapshot.protect & SEC_RESERVE) return FALSE;
+
+        info->AllocationBase = alloc_base;
+        info->BaseAddress    = base;
+        fill_view_memory_info( &snapshot, base, info );
+        if (!virtual_read_retry( seq )) return TRUE;
+    }
+    return FALSE;
+}
+
 /* get basic information about a memory block */
 static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
                                        MEMORY_BASIC_INFORMATION *info,
                                        SIZE_T len, SIZE_T *res_len )
 {
     struct file_view *view;
-    char *base, *alloc_base = 0, *alloc_end = working_set_limit;
-    struct wine_rb_entry *ptr;
+    char *base, *alloc_base, *alloc_end;
     sigset_t sigset;
 
     if (len < sizeof(MEMORY_BASIC_INFORMATION))
@@ -4315,38 +4628,24 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
 
     if (is_beyond_limit( base, 1, working_set_limit )) return STATUS_INVALID_PARAMETER;
 
-    /* Find the view containing the address */
-
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
-    ptr = views_tree.root;
-    while (ptr)
+    if (get_basic_memory_info_lockless( base, info ))
     {
-        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            alloc_end = view->base;
-            ptr = ptr->left;
-        }
-        else if ((char *)view->base + view->size <= base)
-        {
-            alloc_base = (char *)view->base + view->size;
-            ptr = ptr->right;
-        }
-        else
-        {
-            alloc_base = view->base;
-            alloc_end = (char *)view->base + view->size;
-            break;
-        }
+        if (res_len) *res_len = sizeof(*info);
+        return STATUS_SUCCESS;
     }
 
+    /* Find the view containing the address */
+
+    virtual_lock( &sigset );
+    view = find_alloc_range( base, &alloc_base, &alloc_end, FALSE );
+
     /* Fill the info structure */
 
     info->AllocationBase = alloc_base;
     info->BaseAddress    = base;
     info->RegionSize     = alloc_end - base;
 
-    if (!ptr)
+    if (!view)
     {
         if (!mmap_enum_reserved_areas( get_free_mem_state_callback, info, 0 ))
         {
@@ -4370,19 +4669,8 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
             }
         }
     }
-    else
-    {
-        BYTE vprot;
-
-        info->RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
-        info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
-        info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
-        info->AllocationProtect = get_win32_prot( view->protect, view->protect );
-        if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
-        else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
-        else info->Type = MEM_PRIVATE;
-    }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    else fill_view_memory_info( view, base, info );
+    virtual_unlock( &sigset );
 
     if (res_len) *res_len = sizeof(*info);
     return STATUS_SUCCESS;
@@ -4418,7 +4706,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (vmentries == NULL)
             WARN( "couldn't get process vmmap, errno %d\n", errno );
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
         {
              int i;
@@ -4444,7 +4732,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                      p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
              }
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
 
         if (vmentries)
             procstat_freevmmap( pstat, vmentries );
@@ -4461,7 +4749,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (!once++) WARN( "unable to open /proc/self/pagemap\n" );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
     {
         BYTE vprot;
@@ -4489,7 +4777,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 #endif
 
     if (f)
@@ -4829,7 +5117,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         return status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if ((view = find_view( addr, 0 )) && !is_view_valloc( view ))
     {
         if (view->protect & VPROT_SYSTEM)
@@ -4843,7 +5131,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
                 {
                     TRACE( "not freeing in-use builtin %p\n", view->base );
                     builtin->refcount--;
-                    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                    virtual_unlock( &sigset );
                     return STATUS_SUCCESS;
                 }
             }
@@ -4862,7 +5150,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         }
         else FIXME( "failed to unmap %p %x\n", view->base, status );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -4988,7 +5276,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         return result.virtual_flush.status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!(view = find_view( addr, *size_ptr ))) status = STATUS_INVALID_PARAMETER;
     else
     {
@@ -4998,7 +5286,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         if (msync( addr, *size_ptr, MS_ASYNC )) status = STATUS_NOT_MAPPED_DATA;
 #endif
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -5025,7 +5313,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     TRACE( "%p %x %p-%p %p %lu\n", process, flags, base, (char *)base + size,
            addresses, *count );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if (is_write_watch_range( base, size ))
     {
@@ -5117,7 +5405,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     else status = STATUS_INVALID_PARAMETER;
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -5138,14 +5426,14 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     if (!size) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if (is_write_watch_range( base, size ))
         reset_write_watches( base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -5266,7 +5554,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
 
     TRACE("%p %p\n", addr1, addr2);
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     view1 = find_view( addr1, 0 );
     view2 = find_view( addr2, 0 );
@@ -5290,7 +5578,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
         SERVER_END_REQ;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
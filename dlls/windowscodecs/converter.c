@@ -19,6 +19,9 @@
 
 #include <stdarg.h>
 #include <math.h>
+#ifdef __SSE2__
+#include <intrin.h>
+#endif
 
 #define COBJMACROS
 
@@ -131,6 +134,261 @@ static void to_sRGB(BYTE *bgr)
 }
 #endif
 
+/* to_sRGB_component() increases monotonically, so the 8-bit level of a float
+ * in [0, 1] can be found from a table holding the smallest input that maps to
+ * each level. The search starts from the level at the nearest 1/1024 below the
+ * input, which is at most a few levels off. Inputs outside of [0, 1] are
+ * clamped. */
+static float sRGB_thresholds[257];
+static BYTE sRGB_start_levels[1024];
+
+/* 255 / alpha in 16.16 fixed point, rounded up, which is precise enough for
+ * (x * factor) >> 16 to give exactly x * 255 / alpha for every 8-bit x. */
+static DWORD unpremultiply_factors[256];
+
+static INIT_ONCE init_tables_once = INIT_ONCE_STATIC_INIT;
+
+static float float_to_sRGB_level(float f)
+{
+    return floorf(to_sRGB_component(f) * 255.0f + 0.51f);
+}
+
+static BOOL WINAPI init_tables(INIT_ONCE *once, void *param, void **context)
+{
+    union { float f; DWORD i; } lo, hi, mid;
+    UINT i, level;
+
+    for (i = 1; i < 256; i++)
+    {
+        lo.f = 0.0f;
+        hi.f = 1.0f;
+        while (lo.i < hi.i)
+        {
+            mid.i = lo.i + (hi.i - lo.i) / 2;
+            if (float_to_sRGB_level(mid.f) >= i) hi.i = mid.i;
+            else lo.i = mid.i + 1;
+        }
+        sRGB_thresholds[i] = lo.f;
+    }
+    sRGB_thresholds[256] = 2.0f;
+
+    for (i = 0, level = 0; i < 1024; i++)
+    {
+        while (i / 1024.0f >= sRGB_thresholds[level + 1]) level++;
+        sRGB_start_levels[i] = level;
+    }
+
+    for (i = 1; i < 256; i++)
+        unpremultiply_factors[i] = (255 * 65536 + i - 1) / i;
+
+    return TRUE;
+}
+
+static void init_conversion_tables(void)
+{
+    InitOnceExecuteOnce(&init_tables_once, init_tables, NULL, NULL);
+}
+
+static inline BYTE float_to_sRGB_byte(float f)
+{
+    UINT level;
+
+    if (!(f >= 0.0f)) return 0;
+    if (f >= 1.0f) return 255;
+
+    level = sRGB_start_levels[(UINT)(f * 1024.0f)];
+    while (f >= sRGB_thresholds[level + 1]) level++;
+    return level;
+}
+
+static void convert_rgb24_to_bgra32_row(const BYTE *src, BYTE *dst, UINT width, BOOL rgb)
+{
+    DWORD *pixel = (DWORD *)dst;
+    UINT x;
+
+    if (rgb)
+    {
+        for (x = 0; x < width; x++, src += 3)
+            pixel[x] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+    }
+    else
+    {
+        for (x = 0; x < width; x++, src += 3)
+            pixel[x] = 0xff000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+    }
+}
+
+/* Drops the alpha byte, four pixels at a time. */
+static void convert_bgra32_to_bgr24_row(const BYTE *src, BYTE *dst, UINT width)
+{
+    const DWORD *pixel = (const DWORD *)src;
+    DWORD *out = (DWORD *)dst;
+    UINT x;
+
+    for (x = 0; x + 4 <= width; x += 4, pixel += 4)
+    {
+        *out++ = (pixel[0] & 0xffffff) | (pixel[1] << 24);
+        *out++ = ((pixel[1] >> 8) & 0xffff) | (pixel[2] << 16);
+        *out++ = ((pixel[2] >> 16) & 0xff) | (pixel[3] << 8);
+    }
+    for (dst = (BYTE *)out, src = (const BYTE *)pixel; x < width; x++, src += 4)
+    {
+        *dst++ = src[0];
+        *dst++ = src[1];
+        *dst++ = src[2];
+    }
+}
+
+static void convert_gray8_to_bgra32_row(const BYTE *src, BYTE *dst, UINT width)
+{
+    DWORD *pixel = (DWORD *)dst;
+    UINT x = 0;
+
+#ifdef __SSE2__
+    const __m128i alpha = _mm_set1_epi8(0xff);
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i gray = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i gg_lo = _mm_unpacklo_epi8(gray, gray), gg_hi = _mm_unpackhi_epi8(gray, gray);
+        __m128i ga_lo = _mm_unpacklo_epi8(gray, alpha), ga_hi = _mm_unpackhi_epi8(gray, alpha);
+
+        _mm_storeu_si128((__m128i *)(pixel + x), _mm_unpacklo_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128((__m128i *)(pixel + x + 4), _mm_unpackhi_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128((__m128i *)(pixel + x + 8), _mm_unpacklo_epi16(gg_hi, ga_hi));
+        _mm_storeu_si128((__m128i *)(pixel + x + 12), _mm_unpackhi_epi16(gg_hi, ga_hi));
+    }
+#endif
+
+    for (; x < width; x++)
+        pixel[x] = 0xff000000 | (src[x] << 16) | (src[x] << 8) | src[x];
+}
+
+static void set_opaque_rows(BYTE *bits, UINT stride, UINT width, UINT height)
+{
+    UINT x, y;
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        DWORD *pixel = (DWORD *)bits;
+
+        x = 0;
+#ifdef __SSE2__
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(pixel + x));
+            _mm_storeu_si128((__m128i *)(pixel + x), _mm_or_si128(v, _mm_set1_epi32(0xff000000)));
+        }
+#endif
+        for (; x < width; x++)
+            pixel[x] |= 0xff000000;
+    }
+}
+
+/* Multiplies the color channels by alpha / 255, rounding down. For v up to
+ * 255 * 255, (v + 1 + (v >> 8)) >> 8 is exactly v / 255. */
+static void premultiply_rows(BYTE *bits, UINT stride, UINT width, UINT height)
+{
+    UINT x, y, v;
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        BYTE *pixel = bits;
+
+        x = 0;
+#ifdef __SSE2__
+        {
+            const __m128i one = _mm_set1_epi16(1), zero = _mm_setzero_si128();
+            const __m128i alpha_mask = _mm_set1_epi32(0xff000000);
+
+            for (; x + 4 <= width; x += 4, pixel += 16)
+            {
+                __m128i src = _mm_loadu_si128((const __m128i *)pixel);
+                __m128i lo = _mm_unpacklo_epi8(src, zero), hi = _mm_unpackhi_epi8(src, zero);
+                __m128i alpha_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+                __m128i alpha_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+
+                lo = _mm_mullo_epi16(lo, alpha_lo);
+                hi = _mm_mullo_epi16(hi, alpha_hi);
+                lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+                hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+                _mm_storeu_si128((__m128i *)pixel, _mm_or_si128(_mm_and_si128(src, alpha_mask),
+                                 _mm_andnot_si128(alpha_mask, _mm_packus_epi16(lo, hi))));
+            }
+        }
+#endif
+        for (; x < width; x++, pixel += 4)
+        {
+            BYTE alpha = pixel[3];
+            if (alpha == 255) continue;
+            v = pixel[0] * alpha; pixel[0] = (v + 1 + (v >> 8)) >> 8;
+            v = pixel[1] * alpha; pixel[1] = (v + 1 + (v >> 8)) >> 8;
+            v = pixel[2] * alpha; pixel[2] = (v + 1 + (v >> 8)) >> 8;
+        }
+    }
+}
+
+/* Divides the color channels by alpha / 255, rounding down. Color values
+ * larger than alpha wrap around as they did with a plain division. */
+static void unpremultiply_rows(BYTE *bits, UINT stride, UINT width, UINT height)
+{
+    UINT x, y;
+    DWORD factor;
+
+    init_conversion_tables();
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        BYTE *pixel = bits;
+
+        for (x = 0; x < width; x++, pixel += 4)
+        {
+            BYTE alpha = pixel[3];
+            if (alpha == 0 || alpha == 255) continue;
+            factor = unpremultiply_factors[alpha];
+            pixel[0] = (pixel[0] * factor) >> 16;
+            pixel[1] = (pixel[1] * factor) >> 16;
+            pixel[2] = (pixel[2] * factor) >> 16;
+        }
+    }
+}
+
+/* Computes the linear luminance of BGRx pixels in place, with the same
+ * float operations as the scalar loop so that the results are identical. */
+static void convert_bgrx32_to_grayfloat_rows(BYTE *bits, UINT stride, UINT width, UINT height)
+{
+    UINT x, y;
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        BYTE *bgr = bits;
+
+        x = 0;
+#ifdef __SSE2__
+        {
+            const __m128i mask = _mm_set1_epi32(0xff);
+
+            for (; x + 4 <= width; x += 4, bgr += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)bgr);
+                __m128 b = _mm_cvtepi32_ps(_mm_and_si128(v, mask));
+                __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8), mask));
+                __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), mask));
+                __m128 gray = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(0.2126f)),
+                                                    _mm_mul_ps(g, _mm_set1_ps(0.7152f))),
+                                         _mm_mul_ps(b, _mm_set1_ps(0.0722f)));
+                _mm_storeu_ps((float *)bgr, _mm_div_ps(gray, _mm_set1_ps(255.0f)));
+            }
+        }
+#endif
+        for (; x < width; x++, bgr += 4)
+        {
+            float gray = (bgr[2] * 0.2126f + bgr[1] * 0.7152f + bgr[0] * 0.0722f) / 255.0f;
+            *(float *)bgr = gray;
+        }
+    }
+}
+
 static inline FormatConverter *impl_from_IWICFormatConverter(IWICFormatConverter *iface)
 {
     return CONTAINING_RECORD(iface, FormatConverter, IWICFormatConverter_iface);
@@ -336,13 +594,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
+            INT y;
             BYTE *srcdata;
             UINT srcstride, srcdatasize;
             const BYTE *srcrow;
-            const BYTE *srcbyte;
             BYTE *dstrow;
-            DWORD *dstpixel;
 
             srcstride = prc->Width;
             srcdatasize = srcstride * prc->Height;
@@ -357,13 +613,7 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
                 srcrow = srcdata;
                 dstrow = pbBuffer;
                 for (y=0; y<prc->Height; y++) {
-                    srcbyte = srcrow;
-                    dstpixel=(DWORD*)dstrow;
-                    for (x=0; x<prc->Width; x++)
-                    {
-                        *dstpixel++ = 0xff000000|(*srcbyte<<16)|(*srcbyte<<8)|*srcbyte;
-                        srcbyte++;
-                    }
+                    convert_gray8_to_bgra32_row(srcrow, dstrow, prc->Width);
                     srcrow += srcstride;
                     dstrow += cbStride;
                 }
@@ -618,13 +868,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
+            INT y;
             BYTE *srcdata;
             UINT srcstride, srcdatasize;
             const BYTE *srcrow;
-            const BYTE *srcpixel;
             BYTE *dstrow;
-            BYTE *dstpixel;
 
             srcstride = 3 * prc->Width;
             srcdatasize = srcstride * prc->Height;
@@ -639,14 +887,7 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
                 srcrow = srcdata;
                 dstrow = pbBuffer;
                 for (y=0; y<prc->Height; y++) {
-                    srcpixel=srcrow;
-                    dstpixel=dstrow;
-                    for (x=0; x<prc->Width; x++) {
-                        *dstpixel++=*srcpixel++; /* blue */
-                        *dstpixel++=*srcpixel++; /* green */
-                        *dstpixel++=*srcpixel++; /* red */
-                        *dstpixel++=255; /* alpha */
-                    }
+                    convert_rgb24_to_bgra32_row(srcrow, dstrow, prc->Width, FALSE);
                     srcrow += srcstride;
                     dstrow += cbStride;
                 }
@@ -661,14 +902,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
+            INT y;
             BYTE *srcdata;
             UINT srcstride, srcdatasize;
             const BYTE *srcrow;
-            const BYTE *srcpixel;
             BYTE *dstrow;
-            BYTE *dstpixel;
-            BYTE tmppixel[3];
 
             srcstride = 3 * prc->Width;
             srcdatasize = srcstride * prc->Height;
@@ -683,18 +921,7 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
                 srcrow = srcdata;
                 dstrow = pbBuffer;
                 for (y=0; y<prc->Height; y++) {
-                    srcpixel=srcrow;
-                    dstpixel=dstrow;
-                    for (x=0; x<prc->Width; x++) {
-                        tmppixel[0]=*srcpixel++; /* red */
-                        tmppixel[1]=*srcpixel++; /* green */
-                        tmppixel[2]=*srcpixel++; /* blue */
-
-                        *dstpixel++=tmppixel[2]; /* blue */
-                        *dstpixel++=tmppixel[1]; /* green */
-                        *dstpixel++=tmppixel[0]; /* red */
-                        *dstpixel++=255; /* alpha */
-                    }
+                    convert_rgb24_to_bgra32_row(srcrow, dstrow, prc->Width, TRUE);
                     srcrow += srcstride;
                     dstrow += cbStride;
                 }
@@ -709,15 +936,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
 
             res = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(res)) return res;
 
-            /* set all alpha values to 255 */
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                    pbBuffer[cbStride*y+4*x+3] = 0xff;
+            set_opaque_rows(pbBuffer, cbStride, prc->Width, prc->Height);
         }
         return S_OK;
     case format_32bppRGBA:
@@ -737,22 +960,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
 
             res = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(res)) return res;
 
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 0 && alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * 255 / alpha;
-                    }
-                }
+            unpremultiply_rows(pbBuffer, cbStride, prc->Width, prc->Height);
         }
         return S_OK;
     case format_48bppRGB:
@@ -881,15 +1093,10 @@ static HRESULT copypixels_to_32bppRGBA(struct FormatConverter *This, const WICRe
     case format_32bppRGB:
         if (prc)
         {
-            INT x, y;
-
             hr = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(hr)) return hr;
 
-            /* set all alpha values to 255 */
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                    pbBuffer[cbStride*y+4*x+3] = 0xff;
+            set_opaque_rows(pbBuffer, cbStride, prc->Width, prc->Height);
         }
         return S_OK;
 
@@ -901,22 +1108,10 @@ static HRESULT copypixels_to_32bppRGBA(struct FormatConverter *This, const WICRe
     case format_32bppPRGBA:
         if (prc)
         {
-            INT x, y;
-
             hr = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(hr)) return hr;
 
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 0 && alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * 255 / alpha;
-                    }
-                }
+            unpremultiply_rows(pbBuffer, cbStride, prc->Width, prc->Height);
         }
         return S_OK;
 
@@ -974,21 +1169,7 @@ static HRESULT copypixels_to_32bppPBGRA(struct FormatConverter *This, const WICR
     default:
         hr = copypixels_to_32bppBGRA(This, prc, cbStride, cbBufferSize, pbBuffer, source_format);
         if (SUCCEEDED(hr) && prc)
-        {
-            INT x, y;
-
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * alpha / 255;
-                    }
-                }
-        }
+            premultiply_rows(pbBuffer, cbStride, prc->Width, prc->Height);
         return hr;
     }
 }
@@ -1007,21 +1188,7 @@ static HRESULT copypixels_to_32bppPRGBA(struct FormatConverter *This, const WICR
     default:
         hr = copypixels_to_32bppRGBA(This, prc, cbStride, cbBufferSize, pbBuffer, source_format);
         if (SUCCEEDED(hr) && prc)
-        {
-            INT x, y;
-
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * alpha / 255;
-                    }
-                }
-        }
+            premultiply_rows(pbBuffer, cbStride, prc->Width, prc->Height);
         return hr;
     }
 }
@@ -1091,14 +1258,7 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
                 {
                     for (y = 0; y < prc->Height; y++)
                     {
-                        srcpixel = srcrow;
-                        dstpixel = dstrow;
-                        for (x = 0; x < prc->Width; x++) {
-                            *dstpixel++ = *srcpixel++; /* blue */
-                            *dstpixel++ = *srcpixel++; /* green */
-                            *dstpixel++ = *srcpixel++; /* red */
-                            srcpixel++; /* alpha */
-                        }
+                        convert_bgra32_to_bgr24_row(srcrow, dstrow, prc->Width);
                         srcrow += srcstride;
                         dstrow += cbStride;
                     }
@@ -1130,6 +1290,8 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
                 INT x, y;
                 BYTE *src = srcdata, *dst = pbBuffer;
 
+                init_conversion_tables();
+
                 for (y = 0; y < prc->Height; y++)
                 {
                     float *gray_float = (float *)src;
@@ -1137,7 +1299,7 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
 
                     for (x = 0; x < prc->Width; x++)
                     {
-                        BYTE gray = (BYTE)floorf(to_sRGB_component(gray_float[x]) * 255.0f + 0.51f);
+                        BYTE gray = float_to_sRGB_byte(gray_float[x]);
                         *bgr++ = gray;
                         *bgr++ = gray;
                         *bgr++ = gray;
@@ -1298,22 +1460,7 @@ static HRESULT copypixels_to_32bppGrayFloat(struct FormatConverter *This, const
     }
 
     if (SUCCEEDED(hr) && prc && source_format != format_32bppGrayFloat)
-    {
-        INT x, y;
-        BYTE *p = pbBuffer;
-
-        for (y = 0; y < prc->Height; y++)
-        {
-            BYTE *bgr = p;
-            for (x = 0; x < prc->Width; x++)
-            {
-                float gray = (bgr[2] * 0.2126f + bgr[1] * 0.7152f + bgr[0] * 0.0722f) / 255.0f;
-                *(float *)bgr = gray;
-                bgr += 4;
-            }
-            p += cbStride;
-        }
-    }
+        convert_bgrx32_to_grayfloat_rows(pbBuffer, cbStride, prc->Width, prc->Height);
     return hr;
 }
 
@@ -1350,13 +1497,15 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
                 INT x, y;
                 BYTE *src = srcdata, *dst = pbBuffer;
 
+                init_conversion_tables();
+
                 for (y=0; y < prc->Height; y++)
                 {
                     float *srcpixel = (float*)src;
                     BYTE *dstpixel = dst;
 
                     for (x=0; x < prc->Width; x++)
-                        *dstpixel++ = (BYTE)floorf(to_sRGB_component(*srcpixel++) * 255.0f + 0.51f);
+                        *dstpixel++ = float_to_sRGB_byte(*srcpixel++);
 
                     src += srcstride;
                     dst += cbStride;
@@ -1384,6 +1533,8 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
         INT x, y;
         BYTE *src = srcdata, *dst = pbBuffer;
 
+        init_conversion_tables();
+
         for (y = 0; y < prc->Height; y++)
         {
             BYTE *bgr = src;
@@ -1392,8 +1543,7 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
             {
                 float gray = (bgr[2] * 0.2126f + bgr[1] * 0.7152f + bgr[0] * 0.0722f) / 255.0f;
 
-                gray = to_sRGB_component(gray) * 255.0f;
-                dst[x] = (BYTE)floorf(gray + 0.51f);
+                dst[x] = float_to_sRGB_byte(gray);
                 bgr += 3;
             }
             src += srcstride;
@@ -601,115 +601,179 @@ static void get_dds_info(dds_info* info, DDS_HEADER *header, DDS_HEADER_DXT10 *h
     info->frame_count = get_frame_count(info->depth, info->mip_levels, info->array_size, info->dimension);
 }
 
-static void decode_block(const BYTE *block_data, UINT block_count, DXGI_FORMAT format,
-                         UINT width, UINT height, DWORD *buffer)
-{
-    const BYTE *block, *color_indices, *alpha_indices, *alpha_table;
-    int i, j, x, y, block_x, block_y, color_index, alpha_index;
-    int block_size, color_offset, color_indices_offset;
-    WORD color[4], color_value = 0;
-    BYTE alpha[8], alpha_value = 0;
-
-    if (format == DXGI_FORMAT_BC1_UNORM) {
-        block_size = 8;
-        color_offset = 0;
-        color_indices_offset = 4;
+/* Build the four colors of a BC1-BC3 block. The alpha of BC2 and BC3 texels
+ * is stored separately and ORed in later, so it is left at zero here. */
+static void get_block_palette(const BYTE *block, DXGI_FORMAT format, DWORD *palette)
+{
+    WORD color[4];
+    int i;
+
+    color[0] = *((WORD *)block);
+    color[1] = *((WORD *)(block + 2));
+    if (format == DXGI_FORMAT_BC1_UNORM && color[0] <= color[1]) {
+        color[2] = MAKE_RGB565(((GET_RGB565_R(color[0]) + GET_RGB565_R(color[1]) + 1) / 2),
+                               ((GET_RGB565_G(color[0]) + GET_RGB565_G(color[1]) + 1) / 2),
+                               ((GET_RGB565_B(color[0]) + GET_RGB565_B(color[1]) + 1) / 2));
+        color[3] = 0;
     } else {
-        block_size = 16;
-        color_offset = 8;
-        color_indices_offset = 12;
-    }
-    block_x = 0;
-    block_y = 0;
-
-    for (i = 0; i < block_count; i++)
-    {
-        block = block_data + i * block_size;
-
-        color[0] = *((WORD *)(block + color_offset));
-        color[1] = *((WORD *)(block + color_offset + 2));
         color[2] = MAKE_RGB565(((GET_RGB565_R(color[0]) * 2 + GET_RGB565_R(color[1]) + 1) / 3),
                                ((GET_RGB565_G(color[0]) * 2 + GET_RGB565_G(color[1]) + 1) / 3),
                                ((GET_RGB565_B(color[0]) * 2 + GET_RGB565_B(color[1]) + 1) / 3));
         color[3] = MAKE_RGB565(((GET_RGB565_R(color[0]) + GET_RGB565_R(color[1]) * 2 + 1) / 3),
                                ((GET_RGB565_G(color[0]) + GET_RGB565_G(color[1]) * 2 + 1) / 3),
                                ((GET_RGB565_B(color[0]) + GET_RGB565_B(color[1]) * 2 + 1) / 3));
+    }
 
-        switch (format)
-        {
-            case DXGI_FORMAT_BC1_UNORM:
-                if (color[0] <= color[1]) {
-                    color[2] = MAKE_RGB565(((GET_RGB565_R(color[0]) + GET_RGB565_R(color[1]) + 1) / 2),
-                                           ((GET_RGB565_G(color[0]) + GET_RGB565_G(color[1]) + 1) / 2),
-                                           ((GET_RGB565_B(color[0]) + GET_RGB565_B(color[1]) + 1) / 2));
-                    color[3] = 0;
-                }
-                break;
-            case DXGI_FORMAT_BC2_UNORM:
-                alpha_table = block;
-                break;
-            case DXGI_FORMAT_BC3_UNORM:
-                alpha[0] = *block;
-                alpha[1] = *(block + 1);
-                if (alpha[0] > alpha[1]) {
-                    for (j = 2; j < 8; j++)
-                    {
-                        alpha[j] = (BYTE)((alpha[0] * (8 - j) + alpha[1] * (j - 1) + 3) / 7);
-                    }
-                } else {
-                    for (j = 2; j < 6; j++)
-                    {
-                        alpha[j] = (BYTE)((alpha[0] * (6 - j) + alpha[1] * (j - 1) + 2) / 5);
-                    }
-                    alpha[6] = 0;
-                    alpha[7] = 0xFF;
-                }
-                alpha_indices = block + 2;
-                break;
-            default:
-                break;
-        }
+    for (i = 0; i < 4; i++)
+    {
+        if (format != DXGI_FORMAT_BC1_UNORM)
+            palette[i] = rgb565_to_argb(color[i], 0);
+        else if (color[0] <= color[1] && !color[i])
+            palette[i] = 0;
+        else
+            palette[i] = rgb565_to_argb(color[i], 0xFF);
+    }
+}
 
-        color_indices = block + color_indices_offset;
+/* Return the 16 alpha values of a BC2 or BC3 block, already shifted into the
+ * alpha byte of an ARGB color. */
+static void get_block_alpha(const BYTE *block, DXGI_FORMAT format, DWORD *alpha)
+{
+    ULONGLONG bits;
+    DWORD table[8];
+    int j;
+
+    if (format == DXGI_FORMAT_BC2_UNORM) {
         for (j = 0; j < 16; j++)
+            alpha[j] = (DWORD)(((block[j / 2] >> (j % 2) * 4) & 0xF) * 0x11) << 24;
+        return;
+    }
+
+    table[0] = block[0];
+    table[1] = block[1];
+    if (table[0] > table[1]) {
+        for (j = 2; j < 8; j++)
+            table[j] = (table[0] * (8 - j) + table[1] * (j - 1) + 3) / 7;
+    } else {
+        for (j = 2; j < 6; j++)
+            table[j] = (table[0] * (6 - j) + table[1] * (j - 1) + 2) / 5;
+        table[6] = 0;
+        table[7] = 0xFF;
+    }
+    for (j = 0; j < 8; j++) table[j] <<= 24;
+
+    bits = 0;
+    for (j = 0; j < 6; j++) bits |= (ULONGLONG)block[2 + j] << (j * 8);
+    for (j = 0; j < 16; j++)
+        alpha[j] = table[(bits >> (j * 3)) & 0x7];
+}
+
+/* Decode the rows of blocks [first_row, last_row) into an ARGB buffer. */
+static void decode_block_rows(const BYTE *block_data, DXGI_FORMAT format, UINT width, UINT height,
+                              DWORD *buffer, UINT first_row, UINT last_row)
+{
+    UINT width_in_blocks = (width + DDS_BLOCK_WIDTH - 1) / DDS_BLOCK_WIDTH;
+    UINT block_size = (format == DXGI_FORMAT_BC1_UNORM) ? 8 : 16;
+    UINT row, block_x, x, y, x_count, y_count;
+    DWORD palette[4], alpha[16], indices;
+    const BYTE *block, *color_block;
+    DWORD *dst;
+
+    for (row = first_row; row < last_row; row++)
+    {
+        y_count = min(DDS_BLOCK_HEIGHT, height - row * DDS_BLOCK_HEIGHT);
+        block = block_data + row * width_in_blocks * block_size;
+
+        for (block_x = 0; block_x < width_in_blocks; block_x++, block += block_size)
         {
-            x = block_x + j % 4;
-            y = block_y + j / 4;
-            if (x >= width || y >= height) continue;
+            x_count = min(DDS_BLOCK_WIDTH, width - block_x * DDS_BLOCK_WIDTH);
+            color_block = (format == DXGI_FORMAT_BC1_UNORM) ? block : block + 8;
 
-            color_index = (color_indices[j / 4] >> ((j % 4) * 2)) & 0x3;
-            color_value = color[color_index];
+            get_block_palette(color_block, format, palette);
+            indices = *((DWORD *)(color_block + 4));
+            if (format != DXGI_FORMAT_BC1_UNORM) get_block_alpha(block, format, alpha);
 
-            switch (format)
+            dst = buffer + row * DDS_BLOCK_HEIGHT * width + block_x * DDS_BLOCK_WIDTH;
+            for (y = 0; y < y_count; y++, dst += width)
             {
-                case DXGI_FORMAT_BC1_UNORM:
-                    if ((color[0] <= color[1]) && !color_value) {
-                        color_value = 0;
-                        alpha_value = 0;
-                    } else {
-                        alpha_value = 0xFF;
-                    }
-                    break;
-                case DXGI_FORMAT_BC2_UNORM:
-                    alpha_value = (alpha_table[j / 2] >> (j % 2) * 4) & 0xF;
-                    alpha_value = (BYTE)((alpha_value * 0xFF + 0x7)/ 0xF);
-                    break;
-                case DXGI_FORMAT_BC3_UNORM:
-                    alpha_index = (*((DWORD *)(alpha_indices + (j / 8) * 3)) >> ((j % 8) * 3)) & 0x7;
-                    alpha_value = alpha[alpha_index];
-                    break;
-                default:
-                    break;
+                for (x = 0; x < x_count; x++)
+                {
+                    dst[x] = palette[(indices >> ((y * 4 + x) * 2)) & 0x3];
+                    if (format != DXGI_FORMAT_BC1_UNORM) dst[x] |= alpha[y * 4 + x];
+                }
             }
-            buffer[x + y * width] = rgb565_to_argb(color_value, alpha_value);
         }
+    }
+}
 
-        block_x += DDS_BLOCK_WIDTH;
-        if (block_x >= width) {
-            block_x = 0;
-            block_y += DDS_BLOCK_HEIGHT;
-        }
+/* Decoding a block costs about the same whatever its contents, and is cheap
+ * enough that waking up worker threads only pays off on large frames. Below
+ * this size (512x512 texels, 1 MiB of output) the frame is decoded on the
+ * calling thread. */
+#define DDS_PARALLEL_MIN_BLOCKS 16384
+
+struct decode_block_bands
+{
+    const BYTE *block_data;
+    DXGI_FORMAT format;
+    UINT width, height;
+    DWORD *buffer;
+    UINT row_count;
+    UINT band_count;
+    LONG next_band;
+};
+
+static void decode_block_bands_run(struct decode_block_bands *bands)
+{
+    UINT band;
+
+    /* Each band is a contiguous range of block rows, so every thread writes
+     * to its own part of the output. */
+    while ((band = InterlockedIncrement(&bands->next_band) - 1) < bands->band_count)
+        decode_block_rows(bands->block_data, bands->format, bands->width, bands->height, bands->buffer,
+                          band * bands->row_count / bands->band_count,
+                          (band + 1) * bands->row_count / bands->band_count);
+}
+
+static void CALLBACK decode_block_work_callback(TP_CALLBACK_INSTANCE *instance, void *context, TP_WORK *work)
+{
+    decode_block_bands_run(context);
+}
+
+static void decode_block(const BYTE *block_data, UINT block_count, DXGI_FORMAT format,
+                         UINT width, UINT height, DWORD *buffer)
+{
+    struct decode_block_bands bands;
+    UINT i, thread_count;
+    SYSTEM_INFO info;
+    TP_WORK *work;
+
+    bands.block_data = block_data;
+    bands.format = format;
+    bands.width = width;
+    bands.height = height;
+    bands.buffer = buffer;
+    bands.row_count = (height + DDS_BLOCK_HEIGHT - 1) / DDS_BLOCK_HEIGHT;
+    bands.next_band = 0;
+
+    GetSystemInfo(&info);
+    thread_count = min(info.dwNumberOfProcessors, bands.row_count);
+    if (thread_count < 2 || block_count < DDS_PARALLEL_MIN_BLOCKS ||
+        !(work = CreateThreadpoolWork(decode_block_work_callback, &bands, NULL))) {
+        decode_block_rows(block_data, format, width, height, buffer, 0, bands.row_count);
+        return;
     }
+
+    /* Two bands per thread, so that a thread that is scheduled late doesn't
+     * leave the others waiting on a large share of the frame. */
+    bands.band_count = min(thread_count * 2, bands.row_count);
+    for (i = 1; i < thread_count; i++)
+        SubmitThreadpoolWork(work);
+    decode_block_bands_run(&bands);
+    /* Every band has been claimed once the calling thread runs out of work,
+     * so callbacks that haven't started yet can be dropped. */
+    WaitForThreadpoolWorkCallbacks(work, TRUE);
+    CloseThreadpoolWork(work);
 }
 
 static inline DdsDecoder *impl_from_IWICBitmapDecoder(IWICBitmapDecoder *iface)
@@ -18,6 +18,10 @@
  */
 
 #include <stdarg.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <intrin.h>
+#endif
 
 #define COBJMACROS
 
@@ -31,6 +35,12 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(wincodecs);
 
+struct scaler_filter {
+    UINT *start;
+    SHORT *weights;
+    UINT taps;
+};
+
 typedef struct BitmapScaler {
     IWICBitmapScaler IWICBitmapScaler_iface;
     LONG ref;
@@ -42,6 +52,11 @@ typedef struct BitmapScaler {
     UINT bpp;
     void (*fn_get_required_source_rect)(struct BitmapScaler*,UINT,UINT,WICRect*);
     void (*fn_copy_scanline)(struct BitmapScaler*,UINT,UINT,UINT,BYTE**,UINT,UINT,BYTE*);
+    struct scaler_filter filter_x, filter_y;
+    SHORT *rows;
+    BYTE *src_line;
+    INT cached_x, cached_width;
+    UINT first_row, next_row, next_dst_y;
     CRITICAL_SECTION lock; /* must be held when initialized */
 } BitmapScaler;
 
@@ -55,6 +70,15 @@ static inline BitmapScaler *impl_from_IMILBitmapScaler(IMILBitmapScaler *iface)
     return CONTAINING_RECORD(iface, BitmapScaler, IMILBitmapScaler_iface);
 }
 
+static void free_scaler_filter(struct scaler_filter *filter)
+{
+    HeapFree(GetProcessHeap(), 0, filter->start);
+    HeapFree(GetProcessHeap(), 0, filter->weights);
+    filter->start = NULL;
+    filter->weights = NULL;
+    filter->taps = 0;
+}
+
 static HRESULT WINAPI BitmapScaler_QueryInterface(IWICBitmapScaler *iface, REFIID iid,
     void **ppv)
 {
@@ -106,6 +130,10 @@ static ULONG WINAPI BitmapScaler_Release(IWICBitmapScaler *iface)
         This->lock.DebugInfo->Spare[0] = 0;
         DeleteCriticalSection(&This->lock);
         if (This->source) IWICBitmapSource_Release(This->source);
+        free_scaler_filter(&This->filter_x);
+        free_scaler_filter(&This->filter_y);
+        HeapFree(GetProcessHeap(), 0, This->rows);
+        HeapFree(GetProcessHeap(), 0, This->src_line);
         HeapFree(GetProcessHeap(), 0, This);
     }
 
@@ -203,6 +231,267 @@ static void NearestNeighbor_CopyScanline(BitmapScaler *This,
     }
 }
 
+/* Formats with one byte per channel, which the filters can treat alike. */
+static BOOL is_filterable_format(const WICPixelFormatGUID *format)
+{
+    static const WICPixelFormatGUID *formats[] =
+    {
+        &GUID_WICPixelFormat8bppGray,
+        &GUID_WICPixelFormat8bppAlpha,
+        &GUID_WICPixelFormat24bppBGR,
+        &GUID_WICPixelFormat24bppRGB,
+        &GUID_WICPixelFormat32bppBGR,
+        &GUID_WICPixelFormat32bppBGRA,
+        &GUID_WICPixelFormat32bppPBGRA,
+        &GUID_WICPixelFormat32bppRGB,
+        &GUID_WICPixelFormat32bppRGBA,
+        &GUID_WICPixelFormat32bppPRGBA,
+    };
+    UINT i;
+
+    for (i = 0; i < ARRAY_SIZE(formats); i++)
+        if (IsEqualGUID(format, formats[i])) return TRUE;
+    return FALSE;
+}
+
+/* Weights of the separable filters are 2.14 fixed point. Horizontally
+ * filtered rows keep 6 fractional bits in a SHORT, which leaves room for the
+ * overshoot of the cubic filter. */
+#define FILTER_SHIFT 14
+#define FILTER_ONE   (1 << FILTER_SHIFT)
+#define ROW_SHIFT    6
+
+static double cubic_weight(double x)
+{
+    x = fabs(x);
+    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+}
+
+/* Computes which source pixels contribute to each of the dst_size destination
+ * pixels along one axis, and with which weights. Pixels outside of the source
+ * are clamped to its edges. Every destination pixel uses the same number of
+ * taps, starting at start[i], so that rows can be filtered without bounds
+ * checks; unused taps have a weight of zero. */
+static HRESULT init_scaler_filter(struct scaler_filter *filter, WICBitmapInterpolationMode mode,
+    UINT src_size, UINT dst_size)
+{
+    double scale = (double)src_size / dst_size, weights[64], *w = weights, sum, total;
+    INT first, last, j, k, prev, src, start;
+    UINT i, taps;
+    SHORT *out;
+
+    if (mode == WICBitmapInterpolationModeFant)
+        taps = (UINT)ceil(max(scale, 1.0)) + 1;
+    else
+        taps = mode == WICBitmapInterpolationModeCubic ? 4 : 2;
+    taps = min(taps, src_size);
+
+    filter->taps = taps;
+    filter->start = HeapAlloc(GetProcessHeap(), 0, dst_size * sizeof(*filter->start));
+    filter->weights = HeapAlloc(GetProcessHeap(), 0, dst_size * taps * sizeof(*filter->weights));
+    if (taps > ARRAY_SIZE(weights))
+        w = HeapAlloc(GetProcessHeap(), 0, taps * sizeof(*w));
+    if (!filter->start || !filter->weights || !w)
+    {
+        if (w != weights) HeapFree(GetProcessHeap(), 0, w);
+        free_scaler_filter(filter);
+        return E_OUTOFMEMORY;
+    }
+
+    for (i = 0; i < dst_size; i++)
+    {
+        double left = i * scale, right = (i + 1) * scale, center = left + scale / 2 - 0.5;
+
+        if (mode == WICBitmapInterpolationModeFant)
+        {
+            first = floor(left);
+            last = ceil(right) - 1;
+        }
+        else
+        {
+            double radius = mode == WICBitmapInterpolationModeCubic ? 2.0 : 1.0;
+            first = floor(center - radius) + 1;
+            last = ceil(center + radius) - 1;
+        }
+
+        start = min(max(first, 0), (INT)(src_size - taps));
+        memset(w, 0, taps * sizeof(*w));
+        for (j = first; j <= last; j++)
+        {
+            double weight;
+
+            if (mode == WICBitmapInterpolationModeFant)
+                weight = min(right, j + 1.0) - max(left, (double)j);
+            else if (mode == WICBitmapInterpolationModeCubic)
+                weight = cubic_weight(j - center);
+            else
+                weight = max(1.0 - fabs(j - center), 0.0);
+
+            src = min(max(j, 0), (INT)src_size - 1);
+            w[min(max(src - start, 0), (INT)taps - 1)] += weight;
+        }
+
+        total = 0.0;
+        for (k = 0; k < taps; k++) total += w[k];
+
+        filter->start[i] = start;
+        out = filter->weights + i * taps;
+        /* Round the running sum rather than each weight, so that the weights add up
+         * to exactly one and flat areas stay flat, while the rounding error is spread
+         * over all the taps even when each of them is much smaller than one step. */
+        sum = 0.0;
+        prev = 0;
+        for (k = 0; k < taps; k++)
+        {
+            sum += w[k];
+            j = floor(sum / total * FILTER_ONE + 0.5);
+            out[k] = j - prev;
+            prev = j;
+        }
+    }
+
+    if (w != weights) HeapFree(GetProcessHeap(), 0, w);
+    return S_OK;
+}
+
+static void filter_row_horizontal(const struct scaler_filter *filter, UINT channels,
+    const BYTE *src, UINT src_x, UINT dst_x, UINT dst_width, SHORT *dst)
+{
+    UINT i, k, c, taps = filter->taps;
+
+    for (i = 0; i < dst_width; i++)
+    {
+        const SHORT *weights = filter->weights + (dst_x + i) * taps;
+        const BYTE *pixel = src + (filter->start[dst_x + i] - src_x) * channels;
+
+        for (c = 0; c < channels; c++)
+        {
+            INT sum = 0;
+
+            for (k = 0; k < taps; k++)
+                sum += weights[k] * pixel[k * channels + c];
+            *dst++ = (sum + (1 << (FILTER_SHIFT - ROW_SHIFT - 1))) >> (FILTER_SHIFT - ROW_SHIFT);
+        }
+    }
+}
+
+static void filter_row_vertical(const SHORT *weights, const SHORT **rows, UINT taps, UINT count, BYTE *dst)
+{
+    UINT i = 0, k;
+
+#ifdef __SSE2__
+    const __m128i round = _mm_set1_epi32(1 << (FILTER_SHIFT + ROW_SHIFT - 1));
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i lo = round, hi = round;
+
+        for (k = 0; k < taps; k += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+            __m128i b = k + 1 < taps ? _mm_loadu_si128((const __m128i *)(rows[k + 1] + i)) : a;
+            __m128i w = _mm_set1_epi32((k + 1 < taps ? (DWORD)(WORD)weights[k + 1] << 16 : 0) | (WORD)weights[k]);
+
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        lo = _mm_srai_epi32(lo, FILTER_SHIFT + ROW_SHIFT);
+        hi = _mm_srai_epi32(hi, FILTER_SHIFT + ROW_SHIFT);
+        lo = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(lo, lo));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        INT sum = 1 << (FILTER_SHIFT + ROW_SHIFT - 1);
+
+        for (k = 0; k < taps; k++)
+            sum += weights[k] * rows[k][i];
+        sum >>= FILTER_SHIFT + ROW_SHIFT;
+        dst[i] = min(max(sum, 0), 255);
+    }
+}
+
+/* Scales with a separable filter, one destination row at a time. Source rows
+ * are read and filtered horizontally only once, and kept in a ring buffer
+ * holding as many rows as the vertical filter has taps. When a call continues
+ * at the row after the one where the previous call stopped, the buffer is
+ * reused, so that callers which copy one row at a time from top to bottom
+ * read every source row only once. */
+static HRESULT Filtered_CopyPixels(BitmapScaler *This, const WICRect *dst_rect, UINT stride, BYTE *buffer)
+{
+    UINT channels = This->bpp / 8, taps = This->filter_y.taps;
+    UINT row_length = dst_rect->Width * channels;
+    const SHORT *rows[64], **row_ptrs = rows;
+    WICRect src_rect;
+    HRESULT hr = S_OK;
+    UINT y, k, first;
+
+    if (dst_rect->Width < 0 || dst_rect->Height < 0) return E_INVALIDARG;
+    if (!dst_rect->Width || !dst_rect->Height) return S_OK;
+
+    src_rect.X = This->filter_x.start[dst_rect->X];
+    src_rect.Width = This->filter_x.start[dst_rect->X + dst_rect->Width - 1] + This->filter_x.taps - src_rect.X;
+    src_rect.Height = 1;
+
+    if (This->cached_x != dst_rect->X || This->cached_width != dst_rect->Width)
+    {
+        HeapFree(GetProcessHeap(), 0, This->rows);
+        HeapFree(GetProcessHeap(), 0, This->src_line);
+        This->rows = HeapAlloc(GetProcessHeap(), 0, taps * row_length * sizeof(*This->rows));
+        This->src_line = HeapAlloc(GetProcessHeap(), 0, src_rect.Width * channels);
+        This->cached_x = This->cached_width = -1;
+        if (!This->rows || !This->src_line) return E_OUTOFMEMORY;
+        This->cached_x = dst_rect->X;
+        This->cached_width = dst_rect->Width;
+        This->next_dst_y = ~0u;
+    }
+
+    if (This->next_dst_y != dst_rect->Y)
+        This->first_row = This->next_row = 0;
+
+    if (taps > ARRAY_SIZE(rows) && !(row_ptrs = HeapAlloc(GetProcessHeap(), 0, taps * sizeof(*row_ptrs))))
+        return E_OUTOFMEMORY;
+
+    for (y = 0; y < dst_rect->Height; y++)
+    {
+        first = This->filter_y.start[dst_rect->Y + y];
+
+        /* Start over if rows before the cached ones are needed, or if none of the
+         * cached rows are needed any longer. */
+        if (first < max(This->first_row, This->next_row - min(This->next_row, taps)) ||
+            first > This->next_row)
+            This->first_row = This->next_row = first;
+
+        for (; This->next_row < first + taps; This->next_row++)
+        {
+            src_rect.Y = This->next_row;
+            hr = IWICBitmapSource_CopyPixels(This->source, &src_rect, src_rect.Width * channels,
+                src_rect.Width * channels, This->src_line);
+            if (FAILED(hr))
+            {
+                This->next_dst_y = ~0u;
+                goto end;
+            }
+            filter_row_horizontal(&This->filter_x, channels, This->src_line, src_rect.X, dst_rect->X,
+                dst_rect->Width, This->rows + (This->next_row % taps) * row_length);
+        }
+
+        for (k = 0; k < taps; k++)
+            row_ptrs[k] = This->rows + ((first + k) % taps) * row_length;
+        filter_row_vertical(This->filter_y.weights + (dst_rect->Y + y) * taps, row_ptrs, taps,
+            row_length, buffer + stride * y);
+    }
+    This->next_dst_y = dst_rect->Y + dst_rect->Height;
+
+end:
+    if (row_ptrs != rows) HeapFree(GetProcessHeap(), 0, row_ptrs);
+    return hr;
+}
+
 static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
@@ -257,6 +546,12 @@ static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
         goto end;
     }
 
+    if (This->filter_x.taps)
+    {
+        hr = Filtered_CopyPixels(This, &dest_rect, cbStride, pbBuffer);
+        goto end;
+    }
+
     /* MSDN recommends calling CopyPixels once for each scanline from top to
      * bottom, and claims codecs optimize for this. Ideally, when called in this
      * way, we should avoid requesting a scanline from the source more than
@@ -347,10 +642,32 @@ static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
         hr = get_pixelformat_bpp(&src_pixelformat, &This->bpp);
     }
 
+    if (SUCCEEDED(hr) && mode != WICBitmapInterpolationModeNearestNeighbor &&
+        !is_filterable_format(&src_pixelformat))
+    {
+        FIXME("mode %i is not supported for format %s, using nearest neighbor\n",
+              mode, debugstr_guid(&src_pixelformat));
+        mode = WICBitmapInterpolationModeNearestNeighbor;
+    }
+
     if (SUCCEEDED(hr))
     {
         switch (mode)
         {
+        case WICBitmapInterpolationModeLinear:
+        case WICBitmapInterpolationModeCubic:
+        case WICBitmapInterpolationModeFant:
+            hr = init_scaler_filter(&This->filter_x, mode, This->src_width, This->width);
+            if (SUCCEEDED(hr))
+                hr = init_scaler_filter(&This->filter_y, mode, This->src_height, This->height);
+            if (FAILED(hr))
+            {
+                free_scaler_filter(&This->filter_x);
+                break;
+            }
+            IWICBitmapSource_AddRef(pISource);
+            This->source = pISource;
+            break;
         default:
             FIXME("unsupported mode %i\n", mode);
             /* fall-through */
@@ -527,6 +844,13 @@ HRESULT BitmapScaler_Create(IWICBitmapScaler **scaler)
     This->src_height = 0;
     This->mode = 0;
     This->bpp = 0;
+    memset(&This->filter_x, 0, sizeof(This->filter_x));
+    memset(&This->filter_y, 0, sizeof(This->filter_y));
+    This->rows = NULL;
+    This->src_line = NULL;
+    This->cached_x = This->cached_width = -1;
+    This->first_row = This->next_row = 0;
+    This->next_dst_y = ~0u;
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": BitmapScaler.lock");
 
@@ -1312,6 +1312,111 @@ static void test_bitmap_scaler(void)
     IWICBitmap_Release(bitmap);
 }
 
+static void test_bitmap_scaler_modes(void)
+{
+    static const WICBitmapInterpolationMode modes[] =
+    {
+        WICBitmapInterpolationModeLinear,
+        WICBitmapInterpolationModeCubic,
+        WICBitmapInterpolationModeFant,
+    };
+    static const UINT sizes[][2] = {{4, 3}, {16, 12}, {5, 7}};
+    BYTE src[8 * 6 * 4], full[16 * 12 * 4], part[16 * 12 * 4];
+    IWICBitmapScaler *scaler;
+    IWICBitmap *bitmap;
+    UINT i, j, x, y;
+    WICRect rect;
+    HRESULT hr;
+
+    /* 2x2 blocks whose average is 25 for every channel. */
+    for (y = 0; y < 6; y++)
+        for (x = 0; x < 8 * 4; x++)
+            src[y * 8 * 4 + x] = 10 * (1 + (x / 4 % 2) + 2 * (y % 2));
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 8, 6, &GUID_WICPixelFormat32bppBGRA,
+        8 * 4, sizeof(src), src, &bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+
+    hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+    ok(hr == S_OK, "Failed to create bitmap scaler, hr %#x.\n", hr);
+    hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, 4, 3, WICBitmapInterpolationModeFant);
+    ok(hr == S_OK, "Failed to initialize bitmap scaler, hr %#x.\n", hr);
+    hr = IWICBitmapScaler_CopyPixels(scaler, NULL, 4 * 4, sizeof(full), full);
+    ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+    for (i = 0; i < 4 * 3 * 4; i++)
+        if (full[i] != 25) break;
+    ok(i == 4 * 3 * 4, "Unexpected value %u at %u.\n", full[i], i);
+    IWICBitmapScaler_Release(scaler);
+    IWICBitmap_Release(bitmap);
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(sizes); j++)
+        {
+            UINT width = sizes[j][0], height = sizes[j][1], stride = width * 4;
+
+            winetest_push_context("mode %u, %ux%u", modes[i], width, height);
+
+            /* A flat color stays flat. */
+            memset(src, 0x5a, sizeof(src));
+            hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 8, 6, &GUID_WICPixelFormat32bppBGRA,
+                8 * 4, sizeof(src), src, &bitmap);
+            ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+            hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+            ok(hr == S_OK, "Failed to create bitmap scaler, hr %#x.\n", hr);
+            hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, width, height, modes[i]);
+            ok(hr == S_OK, "Failed to initialize bitmap scaler, hr %#x.\n", hr);
+            hr = IWICBitmapScaler_CopyPixels(scaler, NULL, stride, sizeof(full), full);
+            ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+            for (x = 0; x < stride * height; x++)
+                if (full[x] != 0x5a) break;
+            ok(x == stride * height, "Unexpected value %#x at %u.\n", full[x], x);
+            IWICBitmapScaler_Release(scaler);
+            IWICBitmap_Release(bitmap);
+
+            /* Copying one row at a time or a sub-rectangle gives the same pixels as copying everything. */
+            for (x = 0; x < sizeof(src); x++)
+                src[x] = x * 37 + x / 32 * 11;
+            hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 8, 6, &GUID_WICPixelFormat32bppBGRA,
+                8 * 4, sizeof(src), src, &bitmap);
+            ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+            hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+            ok(hr == S_OK, "Failed to create bitmap scaler, hr %#x.\n", hr);
+            hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, width, height, modes[i]);
+            ok(hr == S_OK, "Failed to initialize bitmap scaler, hr %#x.\n", hr);
+            hr = IWICBitmapScaler_CopyPixels(scaler, NULL, stride, sizeof(full), full);
+            ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+
+            memset(part, 0, sizeof(part));
+            for (y = 0; y < height; y++)
+            {
+                rect.X = 0;
+                rect.Y = y;
+                rect.Width = width;
+                rect.Height = 1;
+                hr = IWICBitmapScaler_CopyPixels(scaler, &rect, stride, stride, part + y * stride);
+                ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+            }
+            ok(!memcmp(part, full, stride * height), "Rows don't match.\n");
+
+            rect.X = width / 2;
+            rect.Y = height / 3;
+            rect.Width = width - rect.X;
+            rect.Height = height - rect.Y;
+            hr = IWICBitmapScaler_CopyPixels(scaler, &rect, stride, sizeof(part), part);
+            ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+            for (y = 0; y < rect.Height; y++)
+                ok(!memcmp(part + y * stride, full + (rect.Y + y) * stride + rect.X * 4, rect.Width * 4),
+                    "Row %u of the sub-rectangle doesn't match.\n", y);
+
+            IWICBitmapScaler_Release(scaler);
+            IWICBitmap_Release(bitmap);
+
+            winetest_pop_context();
+        }
+    }
+}
+
 static LONG obj_refcount(void *obj)
 {
     IUnknown_AddRef((IUnknown *)obj);
@@ -1482,6 +1587,7 @@ START_TEST(bitmap)
     test_CreateBitmapFromHBITMAP();
     test_clipper();
     test_bitmap_scaler();
+    test_bitmap_scaler_modes();
 
     IWICImagingFactory_Release(factory);
 
@@ -566,6 +566,31 @@ static const BYTE bits_24bppBGR_gray[] = {
 static const struct bitmap_data testdata_24bppBGR_gray = {
     &GUID_WICPixelFormat24bppBGR, 24, bits_24bppBGR_gray, 32, 2, 96.0, 96.0};
 
+/* 9 pixels wide, so that conversions also go through the code for the last few pixels of a row */
+static const BYTE bits_32bppBGRA_alpha[] = {
+    12,200,255,255, 0,0,0,0, 50,100,255,51, 51,102,255,85, 3,6,9,85, 15,30,255,17, 5,10,255,153, 150,200,250,153, 5,10,250,102,
+    255,0,128,255, 0,0,0,0, 255,0,85,51, 0,255,0,85, 255,255,255,17, 0,0,0,153, 255,255,255,153, 250,5,0,102, 15,100,0,153};
+static const struct bitmap_data testdata_32bppBGRA_alpha = {
+    &GUID_WICPixelFormat32bppBGRA, 32, bits_32bppBGRA_alpha, 9, 2, 96.0, 96.0};
+
+static const BYTE bits_32bppPBGRA_alpha[] = {
+    12,200,255,255, 0,0,0,0, 10,20,51,51, 17,34,85,85, 1,2,3,85, 1,2,17,17, 3,6,153,153, 90,120,150,153, 2,4,100,102,
+    255,0,128,255, 0,0,0,0, 51,0,17,51, 0,85,0,85, 17,17,17,17, 0,0,0,153, 153,153,153,153, 100,2,0,102, 9,60,0,153};
+static const struct bitmap_data testdata_32bppPBGRA_alpha = {
+    &GUID_WICPixelFormat32bppPBGRA, 32, bits_32bppPBGRA_alpha, 9, 2, 96.0, 96.0};
+
+static const BYTE bits_32bppBGRA_gray[] = {
+    76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255, 76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255,
+    76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255, 76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255,
+    76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255, 76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255,
+    76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255, 76,76,76,255, 220,220,220,255, 127,127,127,255, 0,0,0,255,
+    247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255, 247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255,
+    247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255, 247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255,
+    247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255, 247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255,
+    247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255, 247,247,247,255, 145,145,145,255, 230,230,230,255, 255,255,255,255};
+static const struct bitmap_data testdata_32bppBGRA_gray = {
+    &GUID_WICPixelFormat32bppBGRA, 32, bits_32bppBGRA_gray, 32, 2, 96.0, 96.0};
+
 static void test_conversion(const struct bitmap_data *src, const struct bitmap_data *dst, const char *name, BOOL todo)
 {
     BitmapTestSrc *src_obj;
@@ -1873,6 +1898,8 @@ START_TEST(converter)
     test_conversion(&testdata_32bppBGR, &testdata_32bppBGRA, "BGR -> BGRA", FALSE);
     test_conversion(&testdata_32bppBGRA, &testdata_32bppBGRA, "BGRA -> BGRA", FALSE);
     test_conversion(&testdata_32bppBGRA80, &testdata_32bppPBGRA, "BGRA -> PBGRA", FALSE);
+    test_conversion(&testdata_32bppBGRA_alpha, &testdata_32bppPBGRA_alpha, "BGRA -> PBGRA alpha", FALSE);
+    test_conversion(&testdata_32bppPBGRA_alpha, &testdata_32bppBGRA_alpha, "PBGRA -> BGRA alpha", FALSE);
 
     test_conversion(&testdata_32bppRGBA, &testdata_32bppRGB, "RGBA -> RGB", FALSE);
     test_conversion(&testdata_32bppRGB, &testdata_32bppRGBA, "RGB -> RGBA", FALSE);
@@ -1903,6 +1930,7 @@ START_TEST(converter)
     test_conversion(&testdata_32bppBGR, &testdata_8bppGray, "32bppBGR -> 8bppGray", FALSE);
     test_conversion(&testdata_32bppGrayFloat, &testdata_24bppBGR_gray, "32bppGrayFloat -> 24bppBGR gray", FALSE);
     test_conversion(&testdata_32bppGrayFloat, &testdata_8bppGray, "32bppGrayFloat -> 8bppGray", FALSE);
+    test_conversion(&testdata_8bppGray, &testdata_32bppBGRA_gray, "8bppGray -> 32bppBGRA", FALSE);
 
     test_invalid_conversion();
     test_default_converter();
@@ -1273,6 +1273,140 @@ end:
     if (dds_decoder) IWICDdsDecoder_Release(dds_decoder);
 }
 
+static void test_dds_decoder_large_frame(void)
+{
+    static const struct
+    {
+        BYTE *data;
+        UINT block_count;
+        DXGI_FORMAT format;
+    }
+    sources[] =
+    {
+        { test_dds_dxt1c, 1, DXGI_FORMAT_BC1_UNORM },
+        { test_dds_dxt1a, 1, DXGI_FORMAT_BC1_UNORM },
+        { test_dds_dxt3,  1, DXGI_FORMAT_BC2_UNORM },
+        { test_dds_dxt5,  4, DXGI_FORMAT_BC3_UNORM },
+    };
+    /* More than 16384 blocks, so that the frame is decoded by several threads,
+     * with partial blocks on the right and bottom edges. Each slice is small
+     * enough to be decoded on a single thread. */
+    const UINT width = 518, height = 517, slice_height = 128;
+    const UINT width_in_blocks = (width + 3) / 4, height_in_blocks = (height + 3) / 4;
+    const UINT block_count = width_in_blocks * height_in_blocks;
+    IWICBitmapFrameDecode *frame;
+    IWICBitmapDecoder *decoder;
+    DWORD *expected, *pixels;
+    UINT i, j, y, block_size;
+    IWICStream *stream;
+    BYTE *data;
+    WICRect rect;
+    HRESULT hr;
+
+    for (i = 0; i < ARRAY_SIZE(sources); i++)
+    {
+        winetest_push_context("Test %u", i);
+
+        block_size = sources[i].format == DXGI_FORMAT_BC1_UNORM ? 8 : 16;
+        data = HeapAlloc(GetProcessHeap(), 0, 128 + block_count * block_size);
+        expected = HeapAlloc(GetProcessHeap(), 0, width * height * sizeof(DWORD));
+        pixels = HeapAlloc(GetProcessHeap(), 0, width * height * sizeof(DWORD));
+
+        /* Build the image from the blocks of the smaller test images. */
+        memcpy(data, sources[i].data, 128);
+        *(DWORD *)(data + 12) = height;
+        *(DWORD *)(data + 16) = width;
+        *(DWORD *)(data + 20) = block_count * block_size;
+        *(DWORD *)(data + 28) = 1;
+        for (j = 0; j < block_count; j++)
+            memcpy(data + 128 + j * block_size,
+                   sources[i].data + 128 + ((j * 7 + j / 61) % sources[i].block_count) * block_size, block_size);
+        decode_block(data + 128, block_count, sources[i].format, width, height, expected);
+
+        stream = create_stream(data, 128 + block_count * block_size);
+        decoder = create_decoder();
+        if (!stream || !decoder) goto next;
+        hr = init_decoder(decoder, stream, S_OK, FALSE);
+        if (hr != S_OK) goto next;
+
+        hr = IWICBitmapDecoder_GetFrame(decoder, 0, &frame);
+        ok(hr == S_OK, "GetFrame failed, hr %#x\n", hr);
+        if (hr != S_OK) goto next;
+
+        rect.X = 5;
+        rect.Y = 123;
+        rect.Width = 7;
+        rect.Height = 9;
+        memset(pixels, 0, width * height * sizeof(DWORD));
+        hr = IWICBitmapFrameDecode_CopyPixels(frame, &rect, rect.Width * sizeof(DWORD),
+                                              rect.Width * rect.Height * sizeof(DWORD), (BYTE *)pixels);
+        ok(hr == S_OK, "CopyPixels failed, hr %#x\n", hr);
+        for (j = 0; j < rect.Height; j++)
+        {
+            ok(color_buffer_match(expected + (rect.Y + j) * width + rect.X, pixels + j * rect.Width, rect.Width),
+               "Pixels mismatch in row %u\n", j);
+        }
+
+        memset(pixels, 0, width * height * sizeof(DWORD));
+        hr = IWICBitmapFrameDecode_CopyPixels(frame, NULL, width * sizeof(DWORD),
+                                              width * height * sizeof(DWORD), (BYTE *)pixels);
+        ok(hr == S_OK, "CopyPixels failed, hr %#x\n", hr);
+        ok(color_buffer_match(expected, pixels, width * height), "Pixels mismatch\n");
+
+        IWICBitmapFrameDecode_Release(frame);
+        IWICBitmapDecoder_Release(decoder);
+        decoder = NULL;
+        IWICStream_Release(stream);
+        stream = NULL;
+
+        /* Compare with the frame decoded a slice at a time. */
+        for (y = 0; y < height; y += slice_height)
+        {
+            UINT rows = min(slice_height, height - y);
+            UINT slice_blocks = width_in_blocks * ((rows + 3) / 4);
+            IWICBitmapDecoder *slice_decoder;
+            IWICStream *slice_stream;
+            BYTE *slice;
+
+            slice = HeapAlloc(GetProcessHeap(), 0, 128 + slice_blocks * block_size);
+            memcpy(slice, data, 128);
+            *(DWORD *)(slice + 12) = rows;
+            *(DWORD *)(slice + 20) = slice_blocks * block_size;
+            memcpy(slice + 128, data + 128 + (y / 4) * width_in_blocks * block_size, slice_blocks * block_size);
+
+            slice_stream = create_stream(slice, 128 + slice_blocks * block_size);
+            slice_decoder = create_decoder();
+            if (slice_stream && slice_decoder && init_decoder(slice_decoder, slice_stream, S_OK, FALSE) == S_OK)
+            {
+                hr = IWICBitmapDecoder_GetFrame(slice_decoder, 0, &frame);
+                ok(hr == S_OK, "GetFrame failed, hr %#x\n", hr);
+                if (hr == S_OK)
+                {
+                    memset(pixels, 0, width * rows * sizeof(DWORD));
+                    hr = IWICBitmapFrameDecode_CopyPixels(frame, NULL, width * sizeof(DWORD),
+                                                          width * rows * sizeof(DWORD), (BYTE *)pixels);
+                    ok(hr == S_OK, "CopyPixels failed, hr %#x\n", hr);
+                    ok(color_buffer_match(expected + y * width, pixels, width * rows),
+                       "Pixels mismatch in slice at row %u\n", y);
+                    IWICBitmapFrameDecode_Release(frame);
+                }
+            }
+
+            if (slice_decoder) IWICBitmapDecoder_Release(slice_decoder);
+            if (slice_stream) IWICStream_Release(slice_stream);
+            HeapFree(GetProcessHeap(), 0, slice);
+        }
+
+    next:
+        if (decoder) IWICBitmapDecoder_Release(decoder);
+        if (stream) IWICStream_Release(stream);
+        HeapFree(GetProcessHeap(), 0, pixels);
+        HeapFree(GetProcessHeap(), 0, expected);
+        HeapFree(GetProcessHeap(), 0, data);
+        winetest_pop_context();
+    }
+}
+
 static void test_dds_decoder(void)
 {
     int i;
@@ -1312,6 +1446,8 @@ static void test_dds_decoder(void)
         if (stream) IWICStream_Release(stream);
         winetest_pop_context();
     }
+
+    test_dds_decoder_large_frame();
 }
 
 static void test_dds_encoder_initialize(void)
@@ -20,6 +20,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(d3d_sync);
 WINE_DECLARE_DEBUG_CHANNEL(fps);
 
@@ -34,6 +35,15 @@ struct wined3d_deferred_upload
     uint32_t upload_flags;
 };
 
+/* A resource referenced by a deferred context, together with the number of
+ * times it was acquired. Each resource is referenced only once per command
+ * list, so executing the list needs a single atomic update per resource. */
+struct wined3d_deferred_resource
+{
+    struct wined3d_resource *resource;
+    LONG access_count;
+};
+
 struct wined3d_deferred_query_issue
 {
     struct wined3d_query *query;
@@ -50,7 +60,7 @@ struct wined3d_command_list
     void *data;
 
     SIZE_T resource_count;
-    struct wined3d_resource **resources;
+    struct wined3d_deferred_resource *resources;
 
     SIZE_T upload_count;
     struct wined3d_deferred_upload *uploads;
@@ -2407,7 +2417,7 @@ static void wined3d_cs_acquire_command_list(struct wined3d_device_context *conte
     }
 
     for (i = 0; i < list->resource_count; ++i)
-        wined3d_resource_acquire(list->resources[i]);
+        InterlockedExchangeAdd(&list->resources[i].resource->access_count, list->resources[i].access_count);
 
     for (i = 0; i < list->command_list_count; ++i)
         wined3d_cs_acquire_command_list(context, list->command_lists[i]);
@@ -3219,13 +3229,44 @@ static void wined3d_cs_queue_submit(struct wined3d_cs_queue *queue, struct wined
     struct wined3d_cs_packet *packet;
     size_t packet_size;
 
-    packet = (struct wined3d_cs_packet *)&queue->data[queue->head];
+    packet = (struct wined3d_cs_packet *)&queue->write_chunk->data[queue->write_offset];
     TRACE("Queuing op %s at %p.\n", debug_cs_op(*(const enum wined3d_cs_op *)packet->data), packet);
     packet_size = FIELD_OFFSET(struct wined3d_cs_packet, data[packet->size]);
-    InterlockedExchange(&queue->head, (queue->head + packet_size) & (WINED3D_CS_QUEUE_SIZE - 1));
+    queue->write_offset += packet_size;
+    InterlockedExchange(&queue->head, (ULONG)queue->head + packet_size);
 
     if (InterlockedCompareExchange(&cs->waiting_for_event, FALSE, TRUE))
-        SetEvent(cs->event);
+        RtlWakeAddressAll(&cs->waiting_for_event);
+}
+
+/* Wait for the CS thread to move the tail of the queue away from "tail".
+ * Spin for a while first, since the CS thread usually catches up quickly. */
+static void wined3d_cs_queue_wait_tail(struct wined3d_cs_queue *queue, LONG tail, struct wined3d_cs *cs)
+{
+    BOOL timed = TRACE_ON(d3d_perf);
+    LARGE_INTEGER start, end;
+    unsigned int spin_count;
+
+    if (timed)
+        QueryPerformanceCounter(&start);
+    for (spin_count = 0; spin_count < wined3d_settings.cs_spin_count; ++spin_count)
+    {
+        if (*(volatile LONG *)&queue->tail != tail)
+            goto done;
+        YieldProcessor();
+    }
+
+    InterlockedIncrement(&queue->waiting_for_space);
+    while (*(volatile LONG *)&queue->tail == tail)
+        RtlWaitOnAddress(&queue->tail, &tail, sizeof(tail), NULL);
+    InterlockedDecrement(&queue->waiting_for_space);
+
+done:
+    if (timed)
+    {
+        QueryPerformanceCounter(&end);
+        InterlockedExchangeAdd64(&cs->producer_stall_time, end.QuadPart - start.QuadPart);
+    }
 }
 
 static void wined3d_cs_mt_submit(struct wined3d_device_context *context, enum wined3d_cs_queue_id queue_id)
@@ -3238,64 +3279,75 @@ static void wined3d_cs_mt_submit(struct wined3d_device_context *context, enum wi
     wined3d_cs_queue_submit(&cs->queue[queue_id], cs);
 }
 
+/* Returns the chunk to continue writing packets to. Chunks released by the
+ * CS thread are reused first. Once the queue has reached its maximum size,
+ * wait for the CS thread to release one. */
+static struct wined3d_cs_queue_chunk *wined3d_cs_queue_get_chunk(struct wined3d_cs_queue *queue,
+        struct wined3d_cs *cs)
+{
+    struct wined3d_cs_queue_chunk *chunk;
+    SLIST_ENTRY *entry;
+    LONG tail;
+
+    for (;;)
+    {
+        /* Read the tail before checking the free list. The CS thread releases
+         * chunks before it moves the tail, so we can't miss a release. */
+        tail = *(volatile LONG *)&queue->tail;
+        if ((entry = InterlockedPopEntrySList(&queue->free_chunks)))
+            return CONTAINING_RECORD(entry, struct wined3d_cs_queue_chunk, entry);
+
+        if (queue->chunk_count < ARRAY_SIZE(queue->chunks) && (chunk = heap_alloc(sizeof(*chunk))))
+        {
+            TRACE("Growing queue %p to %u chunks.\n", queue, queue->chunk_count + 1);
+            queue->chunks[queue->chunk_count++] = chunk;
+            return chunk;
+        }
+
+        TRACE("Waiting for a free chunk. Head %u, tail %u.\n", queue->head, tail);
+        wined3d_cs_queue_wait_tail(queue, tail, cs);
+    }
+}
+
 static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size_t size, struct wined3d_cs *cs)
 {
-    size_t queue_size = ARRAY_SIZE(queue->data);
     size_t header_size, packet_size, remaining;
+    struct wined3d_cs_queue_chunk *chunk;
     struct wined3d_cs_packet *packet;
 
     header_size = FIELD_OFFSET(struct wined3d_cs_packet, data[0]);
     packet_size = FIELD_OFFSET(struct wined3d_cs_packet, data[size]);
     packet_size = (packet_size + header_size - 1) & ~(header_size - 1);
     size = packet_size - header_size;
-    if (packet_size >= WINED3D_CS_QUEUE_SIZE)
+    if (packet_size > WINED3D_CS_QUEUE_CHUNK_SIZE - header_size)
     {
-        ERR("Packet size %lu >= queue size %u.\n",
-                (unsigned long)packet_size, WINED3D_CS_QUEUE_SIZE);
+        ERR("Packet size %lu > queue chunk size %u - %lu.\n", (unsigned long)packet_size,
+                WINED3D_CS_QUEUE_CHUNK_SIZE, (unsigned long)header_size);
         return NULL;
     }
 
-    remaining = queue_size - queue->head;
-    if (remaining < packet_size)
+    /* Every chunk ends with a nop, which is only submitted once the next
+     * chunk is linked in. Once the CS thread reaches the end of a chunk, it
+     * can release it and continue with the next one. */
+    remaining = WINED3D_CS_QUEUE_CHUNK_SIZE - queue->write_offset;
+    if (remaining < packet_size + header_size)
     {
-        size_t nop_size = remaining - header_size;
-        struct wined3d_cs_nop *nop;
+        chunk = wined3d_cs_queue_get_chunk(queue, cs);
+        queue->write_chunk->next = chunk;
 
         TRACE("Inserting a nop for %lu + %lu bytes.\n",
-                (unsigned long)header_size, (unsigned long)nop_size);
-
-        nop = wined3d_cs_queue_require_space(queue, nop_size, cs);
-        if (nop_size)
-            nop->opcode = WINED3D_CS_OP_NOP;
-
+                (unsigned long)header_size, (unsigned long)(remaining - header_size));
+        packet = (struct wined3d_cs_packet *)&queue->write_chunk->data[queue->write_offset];
+        packet->size = remaining - header_size;
+        if (packet->size)
+            *(enum wined3d_cs_op *)packet->data = WINED3D_CS_OP_NOP;
         wined3d_cs_queue_submit(queue, cs);
-        assert(!queue->head);
-    }
-
-    for (;;)
-    {
-        LONG tail = *(volatile LONG *)&queue->tail;
-        LONG head = queue->head;
-        LONG new_pos;
-
-        /* Empty. */
-        if (head == tail)
-            break;
-        new_pos = (head + packet_size) & (WINED3D_CS_QUEUE_SIZE - 1);
-        /* Head ahead of tail. We checked the remaining size above, so we only
-         * need to make sure we don't make head equal to tail. */
-        if (head > tail && (new_pos != tail))
-            break;
-        /* Tail ahead of head. Make sure the new head is before the tail as
-         * well. Note that new_pos is 0 when it's at the end of the queue. */
-        if (new_pos < tail && new_pos)
-            break;
 
-        TRACE("Waiting for free space. Head %u, tail %u, packet size %lu.\n",
-                head, tail, (unsigned long)packet_size);
+        queue->write_chunk = chunk;
+        queue->write_offset = 0;
     }
 
-    packet = (struct wined3d_cs_packet *)&queue->data[queue->head];
+    packet = (struct wined3d_cs_packet *)&queue->write_chunk->data[queue->write_offset];
     packet->size = size;
     return packet->data;
 }
@@ -3314,12 +3366,14 @@ static void *wined3d_cs_mt_require_space(struct wined3d_device_context *context,
 static void wined3d_cs_mt_finish(struct wined3d_device_context *context, enum wined3d_cs_queue_id queue_id)
 {
     struct wined3d_cs *cs = wined3d_cs_from_context(context);
+    struct wined3d_cs_queue *queue = &cs->queue[queue_id];
+    LONG tail;
 
     if (cs->thread_id == GetCurrentThreadId())
         return wined3d_cs_st_finish(context, queue_id);
 
-    while (cs->queue[queue_id].head != *(volatile LONG *)&cs->queue[queue_id].tail)
-        YieldProcessor();
+    while (queue->head != (tail = *(volatile LONG *)&queue->tail))
+        wined3d_cs_queue_wait_tail(queue, tail, cs);
 }
 
 static const struct wined3d_device_context_ops wined3d_cs_mt_ops =
@@ -3356,6 +3410,9 @@ static void poll_queries(struct wined3d_cs *cs)
 
 static void wined3d_cs_wait_event(struct wined3d_cs *cs)
 {
+    static const BOOL waiting = TRUE;
+    LARGE_INTEGER start, end;
+
     InterlockedExchange(&cs->waiting_for_event, TRUE);
 
     /* The main thread might have enqueued a command and blocked on it after
@@ -3363,14 +3420,23 @@ static void wined3d_cs_wait_event(struct wined3d_cs *cs)
      * "waiting_for_event" was set.
      *
      * Likewise, we can race with the main thread when resetting
-     * "waiting_for_event", in which case we would need to call
-     * WaitForSingleObject() because the main thread called SetEvent(). */
+     * "waiting_for_event", in which case the main thread has already reset
+     * it and RtlWaitOnAddress() returns immediately. */
     if (!(wined3d_cs_queue_is_empty(cs, &cs->queue[WINED3D_CS_QUEUE_DEFAULT])
             && wined3d_cs_queue_is_empty(cs, &cs->queue[WINED3D_CS_QUEUE_MAP]))
             && InterlockedCompareExchange(&cs->waiting_for_event, FALSE, TRUE))
         return;
 
-    WaitForSingleObject(cs->event, INFINITE);
+    if (!TRACE_ON(d3d_perf))
+    {
+        RtlWaitOnAddress(&cs->waiting_for_event, &waiting, sizeof(waiting), NULL);
+        return;
+    }
+
+    QueryPerformanceCounter(&start);
+    RtlWaitOnAddress(&cs->waiting_for_event, &waiting, sizeof(waiting), NULL);
+    QueryPerformanceCounter(&end);
+    cs->consumer_idle_time += end.QuadPart - start.QuadPart;
 }
 
 static void wined3d_cs_command_lock(const struct wined3d_cs *cs)
@@ -3387,6 +3453,7 @@ static void wined3d_cs_command_unlock(const struct wined3d_cs *cs)
 
 static DWORD WINAPI wined3d_cs_run(void *ctx)
 {
+    struct wined3d_cs_queue_chunk *chunk;
     struct wined3d_cs_packet *packet;
     struct wined3d_cs_queue *queue;
     unsigned int spin_count = 0;
@@ -3394,7 +3461,7 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
     enum wined3d_cs_op opcode;
     HMODULE wined3d_module;
     unsigned int poll = 0;
-    SIZE_T tail;
+    SIZE_T offset, size;
 
     TRACE("Started.\n");
 
@@ -3420,15 +3487,15 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
             queue = &cs->queue[WINED3D_CS_QUEUE_DEFAULT];
             if (wined3d_cs_queue_is_empty(cs, queue))
             {
-                if (++spin_count >= WINED3D_CS_SPIN_COUNT && list_empty(&cs->query_poll_list))
+                if (++spin_count >= wined3d_settings.cs_spin_count && list_empty(&cs->query_poll_list))
                     wined3d_cs_wait_event(cs);
                 continue;
             }
         }
         spin_count = 0;
 
-        tail = queue->tail;
-        packet = wined3d_next_cs_packet(queue->data, &tail);
+        offset = queue->read_offset;
+        packet = wined3d_next_cs_packet(queue->read_chunk->data, &offset);
         if (packet->size)
         {
             opcode = *(const enum wined3d_cs_op *)packet->data;
@@ -3447,16 +3514,60 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
             TRACE("%s at %p executed.\n", debug_cs_op(opcode), packet);
         }
 
-        tail &= (WINED3D_CS_QUEUE_SIZE - 1);
-        InterlockedExchange(&queue->tail, tail);
+        size = offset - queue->read_offset;
+        if (offset == WINED3D_CS_QUEUE_CHUNK_SIZE)
+        {
+            chunk = queue->read_chunk;
+            queue->read_chunk = chunk->next;
+            InterlockedPushEntrySList(&queue->free_chunks, &chunk->entry);
+            offset = 0;
+        }
+        queue->read_offset = offset;
+
+        InterlockedExchange(&queue->tail, (ULONG)queue->tail + size);
+        if (*(volatile LONG *)&queue->waiting_for_space)
+            RtlWakeAddressAll(&queue->tail);
     }
 
-    cs->queue[WINED3D_CS_QUEUE_MAP].tail = cs->queue[WINED3D_CS_QUEUE_MAP].head;
-    cs->queue[WINED3D_CS_QUEUE_DEFAULT].tail = cs->queue[WINED3D_CS_QUEUE_DEFAULT].head;
+    InterlockedExchange(&cs->queue[WINED3D_CS_QUEUE_MAP].tail, cs->queue[WINED3D_CS_QUEUE_MAP].head);
+    InterlockedExchange(&cs->queue[WINED3D_CS_QUEUE_DEFAULT].tail, cs->queue[WINED3D_CS_QUEUE_DEFAULT].head);
+    RtlWakeAddressAll(&cs->queue[WINED3D_CS_QUEUE_MAP].tail);
+    RtlWakeAddressAll(&cs->queue[WINED3D_CS_QUEUE_DEFAULT].tail);
     TRACE("Stopped.\n");
     FreeLibraryAndExitThread(wined3d_module, 0);
 }
 
+static void wined3d_cs_queue_cleanup(struct wined3d_cs_queue *queue)
+{
+    unsigned int i;
+
+    for (i = 0; i < queue->chunk_count; ++i)
+        heap_free(queue->chunks[i]);
+    queue->chunk_count = 0;
+}
+
+static BOOL wined3d_cs_queue_init(struct wined3d_cs_queue *queue)
+{
+    struct wined3d_cs_queue_chunk *chunk;
+    unsigned int i;
+
+    InitializeSListHead(&queue->free_chunks);
+    for (i = 0; i < WINED3D_CS_QUEUE_INITIAL_CHUNKS; ++i)
+    {
+        if (!(chunk = heap_alloc(sizeof(*chunk))))
+        {
+            wined3d_cs_queue_cleanup(queue);
+            return FALSE;
+        }
+        queue->chunks[queue->chunk_count++] = chunk;
+        if (i)
+            InterlockedPushEntrySList(&queue->free_chunks, &chunk->entry);
+    }
+    queue->write_chunk = queue->read_chunk = queue->chunks[0];
+
+    return TRUE;
+}
+
 struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
         const enum wined3d_feature_level *levels, unsigned int level_count)
 {
@@ -3490,9 +3601,10 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
     {
         cs->c.ops = &wined3d_cs_mt_ops;
 
-        if (!(cs->event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        if (!wined3d_cs_queue_init(&cs->queue[WINED3D_CS_QUEUE_DEFAULT])
+                || !wined3d_cs_queue_init(&cs->queue[WINED3D_CS_QUEUE_MAP]))
         {
-            ERR("Failed to create command stream event.\n");
+            ERR("Failed to allocate command stream queues.\n");
             heap_free(cs->data);
             goto fail;
         }
@@ -3501,7 +3613,6 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
                 (const WCHAR *)wined3d_cs_run, &cs->wined3d_module)))
         {
             ERR("Failed to get wined3d module handle.\n");
-            CloseHandle(cs->event);
             heap_free(cs->data);
             goto fail;
         }
@@ -3510,7 +3621,6 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
         {
             ERR("Failed to create wined3d command stream thread.\n");
             FreeLibrary(cs->wined3d_module);
-            CloseHandle(cs->event);
             heap_free(cs->data);
             goto fail;
         }
@@ -3519,6 +3629,8 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
     return cs;
 
 fail:
+    wined3d_cs_queue_cleanup(&cs->queue[WINED3D_CS_QUEUE_MAP]);
+    wined3d_cs_queue_cleanup(&cs->queue[WINED3D_CS_QUEUE_DEFAULT]);
     wined3d_state_destroy(cs->c.state);
     state_cleanup(&cs->state);
     heap_free(cs);
@@ -3531,10 +3643,19 @@ void wined3d_cs_destroy(struct wined3d_cs *cs)
     {
         wined3d_cs_emit_stop(cs);
         CloseHandle(cs->thread);
-        if (!CloseHandle(cs->event))
-            ERR("Closing event failed.\n");
+
+        if (TRACE_ON(d3d_perf))
+        {
+            LARGE_INTEGER freq;
+
+            QueryPerformanceFrequency(&freq);
+            TRACE_(d3d_perf)("Command stream producer stalled for %.3f ms, consumer idle for %.3f ms.\n",
+                    cs->producer_stall_time * 1000.0 / freq.QuadPart, cs->consumer_idle_time * 1000.0 / freq.QuadPart);
+        }
     }
 
+    wined3d_cs_queue_cleanup(&cs->queue[WINED3D_CS_QUEUE_MAP]);
+    wined3d_cs_queue_cleanup(&cs->queue[WINED3D_CS_QUEUE_DEFAULT]);
     wined3d_state_destroy(cs->c.state);
     state_cleanup(&cs->state);
     heap_free(cs->data);
@@ -3615,7 +3736,10 @@ struct wined3d_deferred_context
     void *data;
 
     SIZE_T resource_count, resources_capacity;
-    struct wined3d_resource **resources;
+    struct wined3d_deferred_resource *resources;
+    /* Open-addressed index into "resources"; entries store the index plus one. */
+    SIZE_T resource_hash_size;
+    SIZE_T *resource_hash;
 
     SIZE_T upload_count, uploads_capacity;
     struct wined3d_deferred_upload *uploads;
@@ -3810,16 +3934,64 @@ static void wined3d_deferred_context_flush(struct wined3d_device_context *contex
     FIXME("context %p, stub!\n", context);
 }
 
+static SIZE_T wined3d_deferred_context_hash_resource(const struct wined3d_resource *resource, SIZE_T hash_size)
+{
+    return (((ULONG_PTR)resource >> 4) * 0x9e3779b1u) & (hash_size - 1);
+}
+
+static bool wined3d_deferred_context_grow_resource_hash(struct wined3d_deferred_context *deferred)
+{
+    SIZE_T i, j, new_size = max(deferred->resource_hash_size * 2, 64);
+    SIZE_T *new_hash;
+
+    if (!(new_hash = heap_calloc(new_size, sizeof(*new_hash))))
+        return false;
+
+    for (i = 0; i < deferred->resource_count; ++i)
+    {
+        j = wined3d_deferred_context_hash_resource(deferred->resources[i].resource, new_size);
+        while (new_hash[j])
+            j = (j + 1) & (new_size - 1);
+        new_hash[j] = i + 1;
+    }
+
+    heap_free(deferred->resource_hash);
+    deferred->resource_hash = new_hash;
+    deferred->resource_hash_size = new_size;
+    return true;
+}
+
 static void wined3d_deferred_context_acquire_resource(struct wined3d_device_context *context,
         struct wined3d_resource *resource)
 {
     struct wined3d_deferred_context *deferred = wined3d_deferred_context_from_context(context);
+    SIZE_T i, idx;
+
+    if (deferred->resource_count * 2 >= deferred->resource_hash_size
+            && !wined3d_deferred_context_grow_resource_hash(deferred))
+        return;
+
+    /* The same resources tend to be acquired by every draw, so only count the
+     * acquisition here. This avoids both growing the list with duplicates and
+     * touching the shared resource reference count from every recording thread. */
+    i = wined3d_deferred_context_hash_resource(resource, deferred->resource_hash_size);
+    while ((idx = deferred->resource_hash[i]))
+    {
+        if (deferred->resources[idx - 1].resource == resource)
+        {
+            ++deferred->resources[idx - 1].access_count;
+            return;
+        }
+        i = (i + 1) & (deferred->resource_hash_size - 1);
+    }
 
     if (!wined3d_array_reserve((void **)&deferred->resources, &deferred->resources_capacity,
             deferred->resource_count + 1, sizeof(*deferred->resources)))
         return;
 
-    deferred->resources[deferred->resource_count++] = resource;
+    deferred->resources[deferred->resource_count].resource = resource;
+    deferred->resources[deferred->resource_count].access_count = 1;
+    deferred->resource_hash[i] = ++deferred->resource_count;
     wined3d_resource_incref(resource);
 }
 
@@ -3928,8 +4100,9 @@ void CDECL wined3d_deferred_context_destroy(struct wined3d_device_context *conte
     TRACE("context %p.\n", context);
 
     for (i = 0; i < deferred->resource_count; ++i)
-        wined3d_resource_decref(deferred->resources[i]);
+        wined3d_resource_decref(deferred->resources[i].resource);
     heap_free(deferred->resources);
+    heap_free(deferred->resource_hash);
 
     for (i = 0; i < deferred->upload_count; ++i)
     {
@@ -4051,6 +4224,8 @@ HRESULT CDECL wined3d_deferred_context_record_command_list(struct wined3d_device
 
     deferred->data_size = 0;
     deferred->resource_count = 0;
+    if (deferred->resource_hash)
+        memset(deferred->resource_hash, 0, deferred->resource_hash_size * sizeof(*deferred->resource_hash));
     deferred->upload_count = 0;
     deferred->command_list_count = 0;
     deferred->query_count = 0;
@@ -4107,7 +4282,7 @@ ULONG CDECL wined3d_command_list_decref(struct wined3d_command_list *list)
         for (i = 0; i < list->command_list_count; ++i)
             wined3d_command_list_decref(list->command_lists[i]);
         for (i = 0; i < list->resource_count; ++i)
-            wined3d_resource_decref(list->resources[i]);
+            wined3d_resource_decref(list->resources[i].resource);
         for (i = 0; i < list->upload_count; ++i)
             wined3d_resource_decref(list->uploads[i].resource);
         for (i = 0; i < list->query_count; ++i)
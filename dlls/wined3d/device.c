@@ -29,6 +29,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
 struct wined3d_matrix_3x3
@@ -206,10 +207,79 @@ static void device_leftover_depth_stencil_state(struct wine_rb_entry *entry, voi
     ERR("Leftover depth/stencil state %p.\n", state);
 }
 
+static void wined3d_device_context_skip_redundant(const struct wined3d_device_context *context,
+        enum wined3d_redundant_state type)
+{
+    if (TRACE_ON(d3d_perf))
+        InterlockedIncrement(&context->device->redundant_state_count[type]);
+}
+
+/* Shrink the range [*start_idx, *start_idx + *count) to the part where
+ * "values" differ from "current", which is the state array indexed by
+ * *start_idx. Returns FALSE if the whole range matches. */
+static BOOL wined3d_shrink_state_range(const void **values, const void *current, size_t element_size,
+        unsigned int *start_idx, unsigned int *count)
+{
+    const BYTE *v = *values, *c = current;
+    unsigned int first = 0, end = *count;
+
+    while (first < end && !memcmp(&v[first * element_size], &c[first * element_size], element_size))
+        ++first;
+    if (first == end)
+        return FALSE;
+    while (!memcmp(&v[(end - 1) * element_size], &c[(end - 1) * element_size], element_size))
+        --end;
+
+    *values = &v[first * element_size];
+    *start_idx += first;
+    *count = end - first;
+    return TRUE;
+}
+
+static void wined3d_device_dump_redundant_state_counts(const struct wined3d_device *device)
+{
+    static const char * const names[] =
+    {
+        "shader",
+        "constant buffers",
+        "blend state",
+        "depth/stencil state",
+        "rasterizer state",
+        "viewports",
+        "scissor rects",
+        "shader resource views",
+        "samplers",
+        "unordered access views",
+        "predication",
+        "stream sources",
+        "index buffer",
+        "vertex declaration",
+        "stream outputs",
+        "shader constants",
+        "transform",
+        "render state",
+        "sampler state",
+        "texture state",
+        "texture",
+    };
+    unsigned int i;
+
+    C_ASSERT(ARRAY_SIZE(names) == WINED3D_REDUNDANT_COUNT);
+
+    for (i = 0; i < ARRAY_SIZE(names); ++i)
+    {
+        if (device->redundant_state_count[i])
+            TRACE_(d3d_perf)("Skipped %d redundant %s changes.\n", device->redundant_state_count[i], names[i]);
+    }
+}
+
 void wined3d_device_cleanup(struct wined3d_device *device)
 {
     unsigned int i;
 
+    if (TRACE_ON(d3d_perf))
+        wined3d_device_dump_redundant_state_counts(device);
+
     if (device->swapchain_count)
         wined3d_device_uninit_3d(device);
 
@@ -1303,6 +1373,7 @@ static void wined3d_device_set_transform(struct wined3d_device *device,
     if (!memcmp(&device->cs->c.state->transforms[state], matrix, sizeof(*matrix)))
     {
         TRACE("The application is setting the same matrix over again.\n");
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_TRANSFORM);
         return;
     }
 
@@ -1598,7 +1669,10 @@ static void wined3d_device_set_render_state(struct wined3d_device *device,
     }
 
     if (value == device->cs->c.state->render_states[state])
+    {
         TRACE("Application is setting the old value over, nothing to do.\n");
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_RENDER_STATE);
+    }
     else
     {
         device->cs->c.state->render_states[state] = value;
@@ -1621,6 +1695,7 @@ static void wined3d_device_set_sampler_state(struct wined3d_device *device,
     if (value == device->cs->c.state->sampler_states[sampler_idx][state])
     {
         TRACE("Application is setting the old value over, nothing to do.\n");
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_SAMPLER_STATE);
         return;
     }
 
@@ -1793,7 +1868,10 @@ void CDECL wined3d_device_context_set_shader(struct wined3d_device_context *cont
     wined3d_device_context_lock(context);
     prev = state->shader[type];
     if (shader == prev)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_SHADER);
         goto out;
+    }
 
     if (shader)
         wined3d_shader_incref(shader);
@@ -1829,8 +1907,12 @@ void CDECL wined3d_device_context_set_constant_buffers(struct wined3d_device_con
     }
 
     wined3d_device_context_lock(context);
-    if (!memcmp(buffers, &state->cb[type][start_idx], count * sizeof(*buffers)))
+    if (!wined3d_shrink_state_range((const void **)&buffers, &state->cb[type][start_idx],
+            sizeof(*buffers), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_CONSTANT_BUFFERS);
         goto out;
+    }
 
     wined3d_device_context_emit_set_constant_buffers(context, type, start_idx, count, buffers);
     for (i = 0; i < count; ++i)
@@ -1861,7 +1943,10 @@ void CDECL wined3d_device_context_set_blend_state(struct wined3d_device_context
     prev = state->blend_state;
     if (prev == blend_state && !memcmp(blend_factor, &state->blend_factor, sizeof(*blend_factor))
             && sample_mask == state->sample_mask)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_BLEND_STATE);
         goto out;
+    }
 
     if (blend_state)
         wined3d_blend_state_incref(blend_state);
@@ -1886,7 +1971,10 @@ void CDECL wined3d_device_context_set_depth_stencil_state(struct wined3d_device_
     wined3d_device_context_lock(context);
     prev = state->depth_stencil_state;
     if (prev == depth_stencil_state && state->stencil_ref == stencil_ref)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_DEPTH_STENCIL_STATE);
         goto out;
+    }
 
     if (depth_stencil_state)
         wined3d_depth_stencil_state_incref(depth_stencil_state);
@@ -1910,7 +1998,10 @@ void CDECL wined3d_device_context_set_rasterizer_state(struct wined3d_device_con
     wined3d_device_context_lock(context);
     prev = state->rasterizer_state;
     if (prev == rasterizer_state)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_RASTERIZER_STATE);
         goto out;
+    }
 
     if (rasterizer_state)
         wined3d_rasterizer_state_incref(rasterizer_state);
@@ -1937,6 +2028,13 @@ void CDECL wined3d_device_context_set_viewports(struct wined3d_device_context *c
     }
 
     wined3d_device_context_lock(context);
+    if (state->viewport_count == viewport_count
+            && (!viewport_count || !memcmp(state->viewports, viewports, viewport_count * sizeof(*viewports))))
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_VIEWPORTS);
+        goto out;
+    }
+
     if (viewport_count)
         memcpy(state->viewports, viewports, viewport_count * sizeof(*viewports));
     else
@@ -1944,6 +2042,7 @@ void CDECL wined3d_device_context_set_viewports(struct wined3d_device_context *c
     state->viewport_count = viewport_count;
 
     wined3d_device_context_emit_set_viewports(context, viewport_count, viewports);
+out:
     wined3d_device_context_unlock(context);
 }
 
@@ -1965,6 +2064,7 @@ void CDECL wined3d_device_context_set_scissor_rects(struct wined3d_device_contex
             && !memcmp(state->scissor_rects, rects, rect_count * sizeof(*rects)))
     {
         TRACE("App is setting the old scissor rectangles over, nothing to do.\n");
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_SCISSOR_RECTS);
         goto out;
     }
 
@@ -1984,6 +2084,7 @@ void CDECL wined3d_device_context_set_shader_resource_views(struct wined3d_devic
         struct wined3d_shader_resource_view *const *const views)
 {
     struct wined3d_shader_resource_view *real_views[MAX_SHADER_RESOURCE_VIEWS];
+    struct wined3d_shader_resource_view *const *new_views = real_views;
     struct wined3d_state *state = context->state;
     const struct wined3d_rendertarget_view *dsv = state->fb.depth_stencil;
     unsigned int i;
@@ -1998,7 +2099,10 @@ void CDECL wined3d_device_context_set_shader_resource_views(struct wined3d_devic
 
     wined3d_device_context_lock(context);
     if (!memcmp(views, &state->shader_resource_view[type][start_idx], count * sizeof(*views)))
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_SHADER_RESOURCE_VIEWS);
         goto out;
+    }
 
     memcpy(real_views, views, count * sizeof(*views));
 
@@ -2014,11 +2118,20 @@ void CDECL wined3d_device_context_set_shader_resource_views(struct wined3d_devic
         }
     }
 
-    wined3d_device_context_emit_set_shader_resource_views(context, type, start_idx, count, real_views);
+    /* Applications often rebind a whole range of views to change only a few
+     * of them; only emit the part that actually changes. */
+    if (!wined3d_shrink_state_range((const void **)&new_views, &state->shader_resource_view[type][start_idx],
+            sizeof(*new_views), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_SHADER_RESOURCE_VIEWS);
+        goto out;
+    }
+
+    wined3d_device_context_emit_set_shader_resource_views(context, type, start_idx, count, new_views);
     for (i = 0; i < count; ++i)
     {
         struct wined3d_shader_resource_view *prev = state->shader_resource_view[type][start_idx + i];
-        struct wined3d_shader_resource_view *view = real_views[i];
+        struct wined3d_shader_resource_view *view = new_views[i];
 
         if (view)
         {
@@ -2052,8 +2165,12 @@ void CDECL wined3d_device_context_set_samplers(struct wined3d_device_context *co
     }
 
     wined3d_device_context_lock(context);
-    if (!memcmp(samplers, &state->sampler[type][start_idx], count * sizeof(*samplers)))
+    if (!wined3d_shrink_state_range((const void **)&samplers, &state->sampler[type][start_idx],
+            sizeof(*samplers), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_SAMPLERS);
         goto out;
+    }
 
     wined3d_device_context_emit_set_samplers(context, type, start_idx, count, samplers);
     for (i = 0; i < count; ++i)
@@ -2088,8 +2205,14 @@ void CDECL wined3d_device_context_set_unordered_access_views(struct wined3d_devi
     }
 
     wined3d_device_context_lock(context);
-    if (!memcmp(uavs, &state->unordered_access_view[pipeline][start_idx], count * sizeof(*uavs)) && !initial_counts)
+    /* Initial counts reset the UAV counters even for views that are already
+     * bound, so we can't skip anything in that case. */
+    if (!initial_counts && !wined3d_shrink_state_range((const void **)&uavs,
+            &state->unordered_access_view[pipeline][start_idx], sizeof(*uavs), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_UNORDERED_ACCESS_VIEWS);
         goto out;
+    }
 
     wined3d_device_context_emit_set_unordered_access_views(context, pipeline, start_idx, count, uavs, initial_counts);
     for (i = 0; i < count; ++i)
@@ -2291,6 +2414,12 @@ void CDECL wined3d_device_context_set_predication(struct wined3d_device_context
 
     wined3d_device_context_lock(context);
     prev = state->predicate;
+    if (prev == predicate && state->predicate_value == value)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_PREDICATION);
+        goto out;
+    }
+
     if (predicate)
     {
         FIXME("Predicated rendering not implemented.\n");
@@ -2301,6 +2430,7 @@ void CDECL wined3d_device_context_set_predication(struct wined3d_device_context
     wined3d_device_context_emit_set_predication(context, predicate, value);
     if (prev)
         wined3d_query_decref(prev);
+out:
     wined3d_device_context_unlock(context);
 }
 
@@ -2330,8 +2460,12 @@ HRESULT CDECL wined3d_device_context_set_stream_sources(struct wined3d_device_co
     }
 
     wined3d_device_context_lock(context);
-    if (!memcmp(streams, &state->streams[start_idx], count * sizeof(*streams)))
+    if (!wined3d_shrink_state_range((const void **)&streams, &state->streams[start_idx],
+            sizeof(*streams), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_STREAM_SOURCES);
         goto out;
+    }
 
     wined3d_device_context_emit_set_stream_sources(context, start_idx, count, streams);
     for (i = 0; i < count; ++i)
@@ -2368,7 +2502,10 @@ void CDECL wined3d_device_context_set_index_buffer(struct wined3d_device_context
     prev_offset = state->index_offset;
 
     if (prev_buffer == buffer && prev_format == format_id && prev_offset == offset)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_INDEX_BUFFER);
         goto out;
+    }
 
     if (buffer)
         wined3d_buffer_incref(buffer);
@@ -2393,7 +2530,10 @@ void CDECL wined3d_device_context_set_vertex_declaration(struct wined3d_device_c
     wined3d_device_context_lock(context);
     prev = state->vertex_declaration;
     if (declaration == prev)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_VERTEX_DECLARATION);
         goto out;
+    }
 
     if (declaration)
         wined3d_vertex_declaration_incref(declaration);
@@ -2414,6 +2554,22 @@ void CDECL wined3d_device_context_set_stream_outputs(struct wined3d_device_conte
     TRACE("context %p, outputs %p.\n", context, outputs);
 
     wined3d_device_context_lock(context);
+    /* Binding a buffer with an explicit offset restarts stream output at that
+     * offset, even if the buffer is already bound, so only bindings that
+     * append to the current position can be skipped. */
+    for (i = 0; i < WINED3D_MAX_STREAM_OUTPUT_BUFFERS; ++i)
+    {
+        if (outputs[i].buffer != state->stream_output[i].buffer
+                || outputs[i].offset != state->stream_output[i].offset
+                || (outputs[i].buffer && outputs[i].offset != ~0u))
+            break;
+    }
+    if (i == WINED3D_MAX_STREAM_OUTPUT_BUFFERS)
+    {
+        wined3d_device_context_skip_redundant(context, WINED3D_REDUNDANT_STREAM_OUTPUTS);
+        goto out;
+    }
+
     wined3d_device_context_emit_set_stream_outputs(context, outputs);
     for (i = 0; i < WINED3D_MAX_STREAM_OUTPUT_BUFFERS; ++i)
     {
@@ -2426,6 +2582,7 @@ void CDECL wined3d_device_context_set_stream_outputs(struct wined3d_device_conte
         if (prev_buffer)
             wined3d_buffer_decref(prev_buffer);
     }
+out:
     wined3d_device_context_unlock(context);
 }
 
@@ -2505,6 +2662,13 @@ static void wined3d_device_set_vs_consts_b(struct wined3d_device *device,
     TRACE("device %p, start_idx %u, count %u, constants %p.\n",
             device, start_idx, count, constants);
 
+    if (!wined3d_shrink_state_range((const void **)&constants, &device->cs->c.state->vs_consts_b[start_idx],
+            sizeof(*constants), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_SHADER_CONSTANTS);
+        return;
+    }
+
     memcpy(&device->cs->c.state->vs_consts_b[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2523,6 +2687,13 @@ static void wined3d_device_set_vs_consts_i(struct wined3d_device *device,
     TRACE("device %p, start_idx %u, count %u, constants %p.\n",
             device, start_idx, count, constants);
 
+    if (!wined3d_shrink_state_range((const void **)&constants, &device->cs->c.state->vs_consts_i[start_idx],
+            sizeof(*constants), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_SHADER_CONSTANTS);
+        return;
+    }
+
     memcpy(&device->cs->c.state->vs_consts_i[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2541,6 +2712,13 @@ static void wined3d_device_set_vs_consts_f(struct wined3d_device *device,
     TRACE("device %p, start_idx %u, count %u, constants %p.\n",
             device, start_idx, count, constants);
 
+    if (!wined3d_shrink_state_range((const void **)&constants, &device->cs->c.state->vs_consts_f[start_idx],
+            sizeof(*constants), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_SHADER_CONSTANTS);
+        return;
+    }
+
     memcpy(&device->cs->c.state->vs_consts_f[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2559,6 +2737,13 @@ static void wined3d_device_set_ps_consts_b(struct wined3d_device *device,
     TRACE("device %p, start_idx %u, count %u, constants %p.\n",
             device, start_idx, count, constants);
 
+    if (!wined3d_shrink_state_range((const void **)&constants, &device->cs->c.state->ps_consts_b[start_idx],
+            sizeof(*constants), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_SHADER_CONSTANTS);
+        return;
+    }
+
     memcpy(&device->cs->c.state->ps_consts_b[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2577,6 +2762,13 @@ static void wined3d_device_set_ps_consts_i(struct wined3d_device *device,
     TRACE("device %p, start_idx %u, count %u, constants %p.\n",
             device, start_idx, count, constants);
 
+    if (!wined3d_shrink_state_range((const void **)&constants, &device->cs->c.state->ps_consts_i[start_idx],
+            sizeof(*constants), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_SHADER_CONSTANTS);
+        return;
+    }
+
     memcpy(&device->cs->c.state->ps_consts_i[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2595,6 +2787,13 @@ static void wined3d_device_set_ps_consts_f(struct wined3d_device *device,
     TRACE("device %p, start_idx %u, count %u, constants %p.\n",
             device, start_idx, count, constants);
 
+    if (!wined3d_shrink_state_range((const void **)&constants, &device->cs->c.state->ps_consts_f[start_idx],
+            sizeof(*constants), &start_idx, &count))
+    {
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_SHADER_CONSTANTS);
+        return;
+    }
+
     memcpy(&device->cs->c.state->ps_consts_f[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -3595,6 +3794,7 @@ static void wined3d_device_set_texture_stage_state(struct wined3d_device *device
     if (value == device->cs->c.state->texture_states[stage][state])
     {
         TRACE("Application is setting the old value over, nothing to do.\n");
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_TEXTURE_STATE);
         return;
     }
 
@@ -3624,6 +3824,7 @@ static void wined3d_device_set_texture(struct wined3d_device *device,
     if (texture == prev)
     {
         TRACE("App is setting the same texture again, nothing to do.\n");
+        wined3d_device_context_skip_redundant(&device->cs->c, WINED3D_REDUNDANT_TEXTURE);
         return;
     }
 
@@ -638,6 +638,206 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+static int __cdecl shader_glsl_cache_key_compare(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(struct wined3d_shader_cache_key));
+}
+
+/* Context activation is done by the caller. Adds the sources of the shaders
+ * attached to "program" and the identification of the GL driver to "key".
+ * Shaders are hashed separately and sorted, since the order in which
+ * glGetAttachedShaders() returns them is not defined. */
+static BOOL shader_glsl_get_program_cache_key(const struct wined3d_gl_info *gl_info, GLuint program,
+        struct wined3d_shader_cache_key *key)
+{
+    struct wined3d_shader_cache_key *shader_keys;
+    GLint i, shader_count, length, type;
+    SIZE_T source_size = 0;
+    char *source = NULL;
+    GLuint *shaders;
+
+    GL_EXTCALL(glGetProgramiv(program, GL_ATTACHED_SHADERS, &shader_count));
+    if (!(shaders = heap_calloc(shader_count, sizeof(*shaders))))
+        return FALSE;
+    if (!(shader_keys = heap_calloc(shader_count, sizeof(*shader_keys))))
+    {
+        heap_free(shaders);
+        return FALSE;
+    }
+
+    GL_EXTCALL(glGetAttachedShaders(program, shader_count, NULL, shaders));
+    for (i = 0; i < shader_count; ++i)
+    {
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type));
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length));
+        if (length <= 0 || !wined3d_array_reserve((void **)&source, &source_size, length, 1))
+            break;
+        GL_EXTCALL(glGetShaderSource(shaders[i], length, &length, source));
+
+        wined3d_shader_cache_key_init(&shader_keys[i], NULL);
+        wined3d_shader_cache_key_update(&shader_keys[i], &type, sizeof(type));
+        wined3d_shader_cache_key_update(&shader_keys[i], source, length);
+    }
+    heap_free(source);
+    heap_free(shaders);
+    checkGLcall("get program sources");
+
+    if (i < shader_count)
+    {
+        heap_free(shader_keys);
+        return FALSE;
+    }
+
+    qsort(shader_keys, shader_count, sizeof(*shader_keys), shader_glsl_cache_key_compare);
+    wined3d_shader_cache_key_update(key, shader_keys, shader_count * sizeof(*shader_keys));
+    heap_free(shader_keys);
+
+    wined3d_shader_cache_key_update_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_VENDOR));
+    wined3d_shader_cache_key_update_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_RENDERER));
+    wined3d_shader_cache_key_update_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_VERSION));
+
+    return TRUE;
+}
+
+/* Context activation is done by the caller. If "key" is not NULL, it should
+ * describe any program state set before linking, e.g. attribute and fragment
+ * data locations. The program binary is then loaded from the shader cache
+ * when possible, and stored to it otherwise. */
+static void shader_glsl_link_program(const struct wined3d_gl_info *gl_info, GLuint program,
+        struct wined3d_shader_cache_key *key)
+{
+    GLint status = GL_FALSE, length;
+    GLenum format;
+    size_t size;
+    BYTE *data;
+
+    if (key && (!gl_info->supported[ARB_GET_PROGRAM_BINARY] || !wined3d_shader_cache_enabled()
+            || !shader_glsl_get_program_cache_key(gl_info, program, key)))
+        key = NULL;
+
+    if (key)
+    {
+        if ((data = wined3d_shader_cache_load(key, &size)))
+        {
+            if (size > sizeof(format))
+            {
+                memcpy(&format, data, sizeof(format));
+                GL_EXTCALL(glProgramBinary(program, format, data + sizeof(format), size - sizeof(format)));
+                GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+                checkGLcall("glProgramBinary");
+            }
+            heap_free(data);
+
+            if (status)
+            {
+                TRACE("Loaded GLSL shader program %u from the shader cache.\n", program);
+                return;
+            }
+            WARN("Failed to load cached binary for program %u.\n", program);
+        }
+
+        GL_EXTCALL(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
+
+    TRACE("Linking GLSL shader program %u.\n", program);
+    GL_EXTCALL(glLinkProgram(program));
+    shader_glsl_validate_link(gl_info, program);
+
+    if (!key)
+        return;
+
+    GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    GL_EXTCALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (!status || length <= 0 || !(data = heap_alloc(sizeof(format) + length)))
+        return;
+
+    GL_EXTCALL(glGetProgramBinary(program, length, &length, &format, data + sizeof(format)));
+    checkGLcall("glGetProgramBinary");
+    memcpy(data, &format, sizeof(format));
+    if (length > 0)
+        wined3d_shader_cache_store(key, data, sizeof(format) + length);
+    heap_free(data);
+}
+
+/* Context activation is done by the caller. Computes the cache key for the
+ * generated source of a shader variant. Besides the D3D shader and its compile
+ * arguments, the source depends on the capabilities of the GL implementation
+ * and on a few settings. */
+static void shader_glsl_get_source_cache_key(const struct wined3d_context_gl *context_gl,
+        const struct wined3d_shader *shader, const void *args, size_t args_size,
+        struct wined3d_shader_cache_key *key)
+{
+    const struct wined3d_gl_info *gl_info = context_gl->gl_info;
+
+    wined3d_shader_cache_key_init(key, "glsl_source");
+    wined3d_shader_cache_key_update(key, &shader->reg_maps.shader_version.type,
+            sizeof(shader->reg_maps.shader_version.type));
+    wined3d_shader_cache_key_update(key, shader->byte_code, shader->byte_code_size);
+    wined3d_shader_cache_key_update(key, &shader->load_local_constsF, sizeof(shader->load_local_constsF));
+    wined3d_shader_cache_key_update(key, args, args_size);
+
+    wined3d_shader_cache_key_update(key, &gl_info->glsl_version, sizeof(gl_info->glsl_version));
+    wined3d_shader_cache_key_update(key, &gl_info->limits, sizeof(gl_info->limits));
+    wined3d_shader_cache_key_update(key, &gl_info->reserved_glsl_constants, sizeof(gl_info->reserved_glsl_constants));
+    wined3d_shader_cache_key_update(key, &gl_info->quirks, sizeof(gl_info->quirks));
+    wined3d_shader_cache_key_update(key, gl_info->supported, sizeof(gl_info->supported));
+    wined3d_shader_cache_key_update(key, context_gl->c.d3d_info, sizeof(*context_gl->c.d3d_info));
+
+    wined3d_shader_cache_key_update(key, &wined3d_settings.check_float_constants,
+            sizeof(wined3d_settings.check_float_constants));
+    wined3d_shader_cache_key_update(key, &wined3d_settings.offscreen_rendering_mode,
+            sizeof(wined3d_settings.offscreen_rendering_mode));
+    wined3d_shader_cache_key_update(key, &wined3d_settings.strict_shader_math,
+            sizeof(wined3d_settings.strict_shader_math));
+}
+
+/* Context activation is done by the caller. Creates a shader object from the
+ * cached source for "key". The first "extra_size" bytes of the entry hold
+ * additional state recorded while generating the source, and are copied to
+ * "extra". Returns 0 if there is no usable entry. */
+static GLuint shader_glsl_compile_cached_source(const struct wined3d_gl_info *gl_info, GLenum type,
+        const struct wined3d_shader_cache_key *key, void *extra, size_t extra_size)
+{
+    GLuint shader_id;
+    size_t size;
+    char *data;
+
+    if (!(data = wined3d_shader_cache_load(key, &size)))
+        return 0;
+
+    if (size <= extra_size || data[size - 1])
+    {
+        WARN("Ignoring invalid cached shader source.\n");
+        heap_free(data);
+        return 0;
+    }
+    if (extra_size)
+        memcpy(extra, data, extra_size);
+
+    shader_id = GL_EXTCALL(glCreateShader(type));
+    TRACE("Using cached source for shader object %u.\n", shader_id);
+    shader_glsl_compile(gl_info, shader_id, data + extra_size);
+    heap_free(data);
+
+    return shader_id;
+}
+
+static void shader_glsl_store_source(const struct wined3d_shader_cache_key *key,
+        const struct wined3d_string_buffer *buffer, const void *extra, size_t extra_size)
+{
+    size_t size = extra_size + buffer->content_size + 1;
+    char *data;
+
+    if (!(data = heap_alloc(size)))
+        return;
+
+    if (extra_size)
+        memcpy(data, extra, extra_size);
+    memcpy(data + extra_size, buffer->buffer, buffer->content_size + 1);
+    wined3d_shader_cache_store(key, data, size);
+    heap_free(data);
+}
+
 static BOOL shader_glsl_use_layout_qualifier(const struct wined3d_gl_info *gl_info)
 {
     /* Layout qualifiers were introduced in GLSL 1.40. The Nvidia Legacy GPU
@@ -8509,11 +8709,13 @@ static GLuint find_glsl_fragment_shader(const struct wined3d_context_gl *context
         const struct ps_compile_args *args, const struct ps_np2fixup_info **np2fixup_info)
 {
     struct glsl_ps_compiled_shader *gl_shaders, *new_array;
+    struct wined3d_shader_cache_key cache_key;
     struct glsl_shader_private *shader_data;
     struct ps_np2fixup_info *np2fixup;
+    GLuint ret = 0;
+    bool cache;
     UINT i;
     DWORD new_size;
-    GLuint ret;
 
     if (!shader->backend_data)
     {
@@ -8569,8 +8771,21 @@ static GLuint find_glsl_fragment_shader(const struct wined3d_context_gl *context
     memset(np2fixup, 0, sizeof(*np2fixup));
     *np2fixup_info = args->np2_fixup ? np2fixup : NULL;
 
-    string_buffer_clear(buffer);
-    ret = shader_glsl_generate_fragment_shader(context_gl, buffer, string_buffers, shader, args, np2fixup);
+    /* Generating the source also fills in the NP2 fixup information, so it is
+     * cached together with the source. */
+    if ((cache = wined3d_shader_cache_enabled()))
+    {
+        shader_glsl_get_source_cache_key(context_gl, shader, args, sizeof(*args), &cache_key);
+        ret = shader_glsl_compile_cached_source(context_gl->gl_info, GL_FRAGMENT_SHADER,
+                &cache_key, np2fixup, sizeof(*np2fixup));
+    }
+    if (!ret)
+    {
+        string_buffer_clear(buffer);
+        ret = shader_glsl_generate_fragment_shader(context_gl, buffer, string_buffers, shader, args, np2fixup);
+        if (ret && cache)
+            shader_glsl_store_source(&cache_key, buffer, np2fixup, sizeof(*np2fixup));
+    }
     gl_shaders[shader_data->num_gl_shaders++].id = ret;
 
     return ret;
@@ -8603,9 +8818,12 @@ static GLuint find_glsl_vertex_shader(const struct wined3d_context_gl *context_g
 {
     struct glsl_vs_compiled_shader *gl_shaders, *new_array;
     uint32_t use_map = context_gl->c.stream_info.use_map;
+    struct wined3d_shader_cache_key cache_key;
     struct glsl_shader_private *shader_data;
+    struct vs_compile_args cache_args;
     unsigned int i, new_size;
-    GLuint ret;
+    GLuint ret = 0;
+    bool cache;
 
     if (!shader->backend_data)
     {
@@ -8654,8 +8872,21 @@ static GLuint find_glsl_vertex_shader(const struct wined3d_context_gl *context_g
 
     gl_shaders[shader_data->num_gl_shaders].args = *args;
 
-    string_buffer_clear(&priv->shader_buffer);
-    ret = shader_glsl_generate_vertex_shader(context_gl, priv, shader, args);
+    if ((cache = wined3d_shader_cache_enabled()))
+    {
+        /* The padding bit is never initialised. */
+        cache_args = *args;
+        cache_args.padding = 0;
+        shader_glsl_get_source_cache_key(context_gl, shader, &cache_args, sizeof(cache_args), &cache_key);
+        ret = shader_glsl_compile_cached_source(context_gl->gl_info, GL_VERTEX_SHADER, &cache_key, NULL, 0);
+    }
+    if (!ret)
+    {
+        string_buffer_clear(&priv->shader_buffer);
+        ret = shader_glsl_generate_vertex_shader(context_gl, priv, shader, args);
+        if (ret && cache)
+            shader_glsl_store_source(&cache_key, &priv->shader_buffer, NULL, 0);
+    }
     gl_shaders[shader_data->num_gl_shaders++].id = ret;
 
     return ret;
@@ -10101,6 +10332,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     struct wined3d_string_buffer *buffer = &priv->shader_buffer;
     struct glsl_cs_compiled_shader *gl_shaders;
     struct glsl_shader_private *shader_data;
+    struct wined3d_shader_cache_key cache_key;
     struct glsl_shader_prog_link *entry;
     GLuint shader_id, program_id;
 
@@ -10156,9 +10388,8 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
 
     list_add_head(&shader->linked_programs, &entry->cs.shader_entry);
 
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    wined3d_shader_cache_key_init(&cache_key, "glsl");
+    shader_glsl_link_program(gl_info, program_id, &cache_key);
 
     GL_EXTCALL(glUseProgram(program_id));
     checkGLcall("glUseProgram");
@@ -10227,6 +10458,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
     const struct ps_np2fixup_info *np2fixup_info = NULL;
     struct wined3d_shader *hshader, *dshader, *gshader;
     struct glsl_shader_prog_link *entry = NULL;
+    struct wined3d_shader_cache_key cache_key;
     struct wined3d_shader *vshader = NULL;
     struct wined3d_shader *pshader = NULL;
     GLuint reorder_shader_id = 0;
@@ -10241,6 +10473,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
     struct list *ps_list, *vs_list;
     WORD attribs_map;
     struct wined3d_string_buffer *tmp_name;
+    BOOL sm4_vs, dual_source;
 
     if (!(context_gl->c.shader_update_mask & (1u << WINED3D_SHADER_TYPE_VERTEX)) && ctx_data->glsl_program)
     {
@@ -10405,6 +10638,16 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
         attribs_map = (1u << WINED3D_FFP_ATTRIBS_COUNT) - 1;
     }
 
+    /* The attribute and fragment data locations bound below are part of the
+     * linked program, so they need to be part of its cache key as well. */
+    sm4_vs = vshader && vshader->reg_maps.shader_version.major >= 4;
+    dual_source = state->blend_state && state->blend_state->dual_source;
+    wined3d_shader_cache_key_init(&cache_key, "glsl");
+    wined3d_shader_cache_key_update(&cache_key, &attribs_map, sizeof(attribs_map));
+    wined3d_shader_cache_key_update(&cache_key, &sm4_vs, sizeof(sm4_vs));
+    wined3d_shader_cache_key_update(&cache_key, &dual_source, sizeof(dual_source));
+    wined3d_shader_cache_key_update_so_desc(&cache_key, gshader ? gshader->u.gs.so_desc : NULL);
+
     if (!shader_glsl_use_explicit_attrib_location(gl_info))
     {
         /* Bind vertex attributes to a corresponding index number to match
@@ -10424,7 +10667,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
 
             string_buffer_sprintf(tmp_name, "vs_in%u", i);
             GL_EXTCALL(glBindAttribLocation(program_id, i, tmp_name->buffer));
-            if (vshader && vshader->reg_maps.shader_version.major >= 4)
+            if (sm4_vs)
             {
                 string_buffer_sprintf(tmp_name, "vs_in_uint%u", i);
                 GL_EXTCALL(glBindAttribLocation(program_id, i, tmp_name->buffer));
@@ -10439,7 +10682,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
             for (i = 0; i < WINED3D_MAX_RENDER_TARGETS; ++i)
             {
                 string_buffer_sprintf(tmp_name, "color_out%u", i);
-                if (state->blend_state && state->blend_state->dual_source)
+                if (dual_source)
                     GL_EXTCALL(glBindFragDataLocationIndexed(program_id, 0, i, tmp_name->buffer));
                 else
                     GL_EXTCALL(glBindFragDataLocation(program_id, i, tmp_name->buffer));
@@ -10488,10 +10731,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
         list_add_head(ps_list, &entry->ps.shader_entry);
     }
 
-    /* Link the program */
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    shader_glsl_link_program(gl_info, program_id, &cache_key);
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? vshader->limits->constant_float : 0);
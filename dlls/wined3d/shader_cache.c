@@ -0,0 +1,444 @@
+/*
+ * Persistent cache of backend shaders
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include "wined3d_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(shader_cache);
+
+/* Bump this whenever the layout of the cache files or the meaning of the
+ * cached data changes. Entries with a different version are ignored. */
+#define WINED3D_SHADER_CACHE_VERSION 2
+
+static const char wined3d_shader_cache_magic[8] = "WD3DSHC";
+
+struct wined3d_shader_cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    struct wined3d_shader_cache_key key;
+    uint64_t data_size;
+    uint64_t checksum;
+};
+
+struct wined3d_shader_cache_file
+{
+    char name[36];
+    FILETIME time;
+    uint64_t size;
+};
+
+static struct
+{
+    char path[MAX_PATH];
+    const char *build_id;
+    uint64_t max_size;
+    uint64_t total_size;
+    bool enabled;
+
+    LONG hits, misses, stores, evictions;
+} shader_cache;
+
+static CRITICAL_SECTION shader_cache_cs;
+static CRITICAL_SECTION_DEBUG shader_cache_cs_debug =
+{
+    0, 0, &shader_cache_cs,
+    {&shader_cache_cs_debug.ProcessLocksList,
+    &shader_cache_cs_debug.ProcessLocksList},
+    0, 0, {(DWORD_PTR)(__FILE__ ": shader_cache_cs")}
+};
+static CRITICAL_SECTION shader_cache_cs = {&shader_cache_cs_debug, -1, 0, 0, 0, 0};
+
+void wined3d_shader_cache_key_init(struct wined3d_shader_cache_key *key, const char *backend)
+{
+    key->hash[0] = 0xcbf29ce484222325ull;
+    key->hash[1] = 0x6a09e667f3bcc908ull;
+    wined3d_shader_cache_key_update_string(key, backend);
+}
+
+/* Two independent 64-bit lanes: FNV-1a, and a multiply/xorshift mix. */
+void wined3d_shader_cache_key_update(struct wined3d_shader_cache_key *key, const void *data, size_t size)
+{
+    uint64_t h0 = key->hash[0], h1 = key->hash[1];
+    const uint8_t *ptr = data;
+    size_t i;
+
+    for (i = 0; i < size; ++i)
+    {
+        h0 = (h0 ^ ptr[i]) * 0x100000001b3ull;
+        h1 = (h1 ^ ptr[i]) * 0x9e3779b97f4a7c15ull;
+        h1 ^= h1 >> 29;
+    }
+
+    key->hash[0] = h0;
+    key->hash[1] = h1;
+}
+
+void wined3d_shader_cache_key_update_string(struct wined3d_shader_cache_key *key, const char *str)
+{
+    uint32_t len = str ? strlen(str) : ~0u;
+
+    wined3d_shader_cache_key_update(key, &len, sizeof(len));
+    if (str)
+        wined3d_shader_cache_key_update(key, str, len);
+}
+
+void wined3d_shader_cache_key_update_so_desc(struct wined3d_shader_cache_key *key,
+        const struct wined3d_stream_output_desc *so_desc)
+{
+    unsigned int i;
+
+    if (!so_desc)
+    {
+        wined3d_shader_cache_key_update_string(key, NULL);
+        return;
+    }
+
+    for (i = 0; i < so_desc->element_count; ++i)
+    {
+        const struct wined3d_stream_output_element *e = &so_desc->elements[i];
+
+        wined3d_shader_cache_key_update(key, &e->stream_idx, sizeof(e->stream_idx));
+        wined3d_shader_cache_key_update_string(key, e->semantic_name);
+        wined3d_shader_cache_key_update(key, &e->semantic_idx, sizeof(e->semantic_idx));
+        wined3d_shader_cache_key_update(key, &e->component_idx, sizeof(e->component_idx));
+        wined3d_shader_cache_key_update(key, &e->component_count, sizeof(e->component_count));
+        wined3d_shader_cache_key_update(key, &e->output_slot, sizeof(e->output_slot));
+    }
+    wined3d_shader_cache_key_update(key, so_desc->buffer_strides,
+            so_desc->buffer_stride_count * sizeof(*so_desc->buffer_strides));
+    wined3d_shader_cache_key_update(key, &so_desc->rasterizer_stream_idx, sizeof(so_desc->rasterizer_stream_idx));
+}
+
+static uint64_t wined3d_shader_cache_checksum(const void *data, size_t size)
+{
+    struct wined3d_shader_cache_key key;
+
+    wined3d_shader_cache_key_init(&key, NULL);
+    wined3d_shader_cache_key_update(&key, data, size);
+    return key.hash[0] ^ key.hash[1];
+}
+
+static void wined3d_shader_cache_get_file_name(const struct wined3d_shader_cache_key *key, char *name)
+{
+    sprintf(name, "%08x%08x%08x%08x.bin", (unsigned int)(key->hash[0] >> 32), (unsigned int)key->hash[0],
+            (unsigned int)(key->hash[1] >> 32), (unsigned int)key->hash[1]);
+}
+
+/* Entries are specific to the Wine build that created them, since the cached
+ * data depends on how wined3d translates shaders. */
+static void wined3d_shader_cache_get_entry_key(const struct wined3d_shader_cache_key *key,
+        struct wined3d_shader_cache_key *entry_key)
+{
+    *entry_key = *key;
+    wined3d_shader_cache_key_update_string(entry_key, shader_cache.build_id);
+}
+
+static bool wined3d_shader_cache_get_file_path(const struct wined3d_shader_cache_key *key,
+        char *path, size_t size)
+{
+    char name[36];
+
+    wined3d_shader_cache_get_file_name(key, name);
+    return snprintf(path, size, "%s\\%s", shader_cache.path, name) < size;
+}
+
+static bool wined3d_shader_cache_create_directory(const char *path)
+{
+    char buffer[MAX_PATH], *p;
+
+    if (CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS)
+        return true;
+
+    strcpy(buffer, path);
+    for (p = buffer; *p; ++p)
+    {
+        if (*p != '\\' || p == buffer || p[-1] == ':')
+            continue;
+        *p = 0;
+        CreateDirectoryA(buffer, NULL);
+        *p = '\\';
+    }
+
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+/* Returns the entries in the cache directory. The last write time of an
+ * entry is updated whenever it is loaded, and is used for LRU eviction. */
+static struct wined3d_shader_cache_file *wined3d_shader_cache_list_files(SIZE_T *count, uint64_t *total_size)
+{
+    struct wined3d_shader_cache_file *files = NULL;
+    SIZE_T files_size = 0;
+    WIN32_FIND_DATAA data;
+    char pattern[MAX_PATH];
+    HANDLE find;
+
+    *count = 0;
+    *total_size = 0;
+
+    if (snprintf(pattern, sizeof(pattern), "%s\\*.bin", shader_cache.path) >= sizeof(pattern))
+        return NULL;
+    if ((find = FindFirstFileA(pattern, &data)) == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    do
+    {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || strlen(data.cFileName) >= sizeof(files->name))
+            continue;
+        if (!wined3d_array_reserve((void **)&files, &files_size, *count + 1, sizeof(*files)))
+            break;
+        strcpy(files[*count].name, data.cFileName);
+        files[*count].time = data.ftLastWriteTime;
+        files[*count].size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        *total_size += files[*count].size;
+        ++*count;
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+
+    return files;
+}
+
+static int __cdecl wined3d_shader_cache_file_compare(const void *a, const void *b)
+{
+    const struct wined3d_shader_cache_file *f1 = a, *f2 = b;
+
+    return CompareFileTime(&f1->time, &f2->time);
+}
+
+/* Evict the least recently used entries until the cache is at three
+ * quarters of its size limit, so that we don't do this on every store. */
+static void wined3d_shader_cache_evict(void)
+{
+    struct wined3d_shader_cache_file *files;
+    uint64_t target = shader_cache.max_size / 4 * 3;
+    char path[MAX_PATH];
+    SIZE_T count, i;
+
+    if (!(files = wined3d_shader_cache_list_files(&count, &shader_cache.total_size)))
+        return;
+
+    qsort(files, count, sizeof(*files), wined3d_shader_cache_file_compare);
+    for (i = 0; i < count && shader_cache.total_size > target; ++i)
+    {
+        snprintf(path, sizeof(path), "%s\\%s", shader_cache.path, files[i].name);
+        if (!DeleteFileA(path))
+            continue;
+        shader_cache.total_size -= files[i].size;
+        ++shader_cache.evictions;
+        TRACE("Evicted %s, %s bytes.\n", debugstr_a(files[i].name), wine_dbgstr_longlong(files[i].size));
+    }
+
+    heap_free(files);
+}
+
+static BOOL WINAPI wined3d_shader_cache_init_once(INIT_ONCE *once, void *param, void **context)
+{
+    const char *(CDECL *p_wine_get_build_id)(void);
+    struct wined3d_shader_cache_file *files;
+    SIZE_T count;
+    DWORD len;
+
+    if (!wined3d_settings.shader_cache_size)
+    {
+        TRACE("Shader cache disabled.\n");
+        return TRUE;
+    }
+    shader_cache.max_size = (uint64_t)wined3d_settings.shader_cache_size << 20;
+
+    if (wined3d_settings.shader_cache_path)
+    {
+        len = strlen(wined3d_settings.shader_cache_path);
+        if (len >= sizeof(shader_cache.path))
+            return TRUE;
+        strcpy(shader_cache.path, wined3d_settings.shader_cache_path);
+    }
+    else
+    {
+        static const char suffix[] = "\\wine\\wined3d_shader_cache";
+
+        len = GetEnvironmentVariableA("LOCALAPPDATA", shader_cache.path, sizeof(shader_cache.path));
+        if (!len || len + sizeof(suffix) > sizeof(shader_cache.path))
+        {
+            WARN("Failed to get the local application data directory.\n");
+            return TRUE;
+        }
+        strcpy(shader_cache.path + len, suffix);
+    }
+
+    if (!wined3d_shader_cache_create_directory(shader_cache.path))
+    {
+        WARN("Failed to create shader cache directory %s.\n", debugstr_a(shader_cache.path));
+        return TRUE;
+    }
+
+    if ((p_wine_get_build_id = (void *)GetProcAddress(GetModuleHandleA("ntdll.dll"), "wine_get_build_id")))
+        shader_cache.build_id = p_wine_get_build_id();
+
+    files = wined3d_shader_cache_list_files(&count, &shader_cache.total_size);
+    heap_free(files);
+
+    TRACE("Using shader cache %s, %s bytes in %lu entries, limit %s bytes.\n", debugstr_a(shader_cache.path),
+            wine_dbgstr_longlong(shader_cache.total_size), (unsigned long)count,
+            wine_dbgstr_longlong(shader_cache.max_size));
+    shader_cache.enabled = true;
+
+    return TRUE;
+}
+
+bool wined3d_shader_cache_enabled(void)
+{
+    static INIT_ONCE init_once = INIT_ONCE_STATIC_INIT;
+
+    InitOnceExecuteOnce(&init_once, wined3d_shader_cache_init_once, NULL, NULL);
+    return shader_cache.enabled;
+}
+
+/* Returns a heap allocated copy of the cached data for "key", or NULL. */
+void *wined3d_shader_cache_load(const struct wined3d_shader_cache_key *key, size_t *size)
+{
+    struct wined3d_shader_cache_header header;
+    struct wined3d_shader_cache_key entry_key;
+    char path[MAX_PATH];
+    void *data = NULL;
+    SYSTEMTIME st;
+    FILETIME now;
+    HANDLE file;
+    DWORD read;
+
+    if (!wined3d_shader_cache_enabled())
+        return NULL;
+    wined3d_shader_cache_get_entry_key(key, &entry_key);
+    if (!wined3d_shader_cache_get_file_path(&entry_key, path, sizeof(path)))
+        return NULL;
+
+    file = CreateFileA(path, GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        goto miss;
+
+    if (!ReadFile(file, &header, sizeof(header), &read, NULL) || read != sizeof(header)
+            || memcmp(header.magic, wined3d_shader_cache_magic, sizeof(header.magic))
+            || header.version != WINED3D_SHADER_CACHE_VERSION
+            || memcmp(&header.key, &entry_key, sizeof(entry_key)) || header.data_size > ~0u)
+    {
+        WARN("Ignoring invalid cache entry %s.\n", debugstr_a(path));
+        goto fail;
+    }
+
+    if (!(data = heap_alloc(header.data_size)))
+        goto fail;
+    if (!ReadFile(file, data, header.data_size, &read, NULL) || read != header.data_size
+            || wined3d_shader_cache_checksum(data, header.data_size) != header.checksum)
+    {
+        WARN("Ignoring corrupted cache entry %s.\n", debugstr_a(path));
+        heap_free(data);
+        data = NULL;
+        goto fail;
+    }
+
+    /* Mark the entry as recently used. */
+    GetSystemTime(&st);
+    SystemTimeToFileTime(&st, &now);
+    SetFileTime(file, NULL, NULL, &now);
+    CloseHandle(file);
+
+    *size = header.data_size;
+    InterlockedIncrement(&shader_cache.hits);
+    TRACE("Loaded %s bytes from %s.\n", wine_dbgstr_longlong(header.data_size), debugstr_a(path));
+    return data;
+
+fail:
+    CloseHandle(file);
+miss:
+    InterlockedIncrement(&shader_cache.misses);
+    return NULL;
+}
+
+void wined3d_shader_cache_store(const struct wined3d_shader_cache_key *key, const void *data, size_t size)
+{
+    struct wined3d_shader_cache_header header;
+    struct wined3d_shader_cache_key entry_key;
+    char path[MAX_PATH], tmp_path[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA old;
+    uint64_t old_size = 0;
+    DWORD written;
+    HANDLE file;
+    bool ret;
+
+    if (!wined3d_shader_cache_enabled() || size > ~0u || sizeof(header) + size > shader_cache.max_size)
+        return;
+    wined3d_shader_cache_get_entry_key(key, &entry_key);
+    if (!wined3d_shader_cache_get_file_path(&entry_key, path, sizeof(path)))
+        return;
+
+    memcpy(header.magic, wined3d_shader_cache_magic, sizeof(header.magic));
+    header.version = WINED3D_SHADER_CACHE_VERSION;
+    header.reserved = 0;
+    header.key = entry_key;
+    header.data_size = size;
+    header.checksum = wined3d_shader_cache_checksum(data, size);
+
+    /* Write to a temporary file first, so that concurrent readers never see
+     * a partially written entry. */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%x.tmp", path, GetCurrentProcessId());
+    file = CreateFileA(tmp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        WARN("Failed to create %s, error %u.\n", debugstr_a(tmp_path), GetLastError());
+        return;
+    }
+    ret = WriteFile(file, &header, sizeof(header), &written, NULL) && written == sizeof(header)
+            && WriteFile(file, data, size, &written, NULL) && written == size;
+    CloseHandle(file);
+
+    /* Another process may have stored the same entry already; only account
+     * for the size difference when it is replaced. */
+    if (GetFileAttributesExA(path, GetFileExInfoStandard, &old))
+        old_size = ((uint64_t)old.nFileSizeHigh << 32) | old.nFileSizeLow;
+
+    if (!ret || !MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        WARN("Failed to write %s, error %u.\n", debugstr_a(path), GetLastError());
+        DeleteFileA(tmp_path);
+        return;
+    }
+
+    TRACE("Stored %lu bytes to %s.\n", (unsigned long)size, debugstr_a(path));
+
+    EnterCriticalSection(&shader_cache_cs);
+    ++shader_cache.stores;
+    shader_cache.total_size += sizeof(header) + size;
+    shader_cache.total_size -= min(old_size, shader_cache.total_size);
+    if (shader_cache.total_size > shader_cache.max_size)
+        wined3d_shader_cache_evict();
+    LeaveCriticalSection(&shader_cache_cs);
+}
+
+void wined3d_shader_cache_cleanup(void)
+{
+    if (!shader_cache.enabled)
+        return;
+
+    TRACE("%d hits, %d misses, %d stores, %d evictions, %s bytes in use.\n",
+            shader_cache.hits, shader_cache.misses, shader_cache.stores, shader_cache.evictions,
+            wine_dbgstr_longlong(shader_cache.total_size));
+}
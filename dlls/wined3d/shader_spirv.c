@@ -303,6 +303,27 @@ static void shader_spirv_init_shader_interface_vk(struct wined3d_shader_spirv_sh
     iface->vkd3d_interface.uav_counter_count = b->uav_counter_count;
 }
 
+static void shader_spirv_get_cache_key(struct wined3d_shader_cache_key *key,
+        const struct wined3d_shader_desc *shader_desc, enum wined3d_shader_type shader_type,
+        const struct shader_spirv_compile_arguments *args, const struct shader_spirv_resource_bindings *bindings,
+        const struct wined3d_stream_output_desc *so_desc)
+{
+    wined3d_shader_cache_key_init(key, "spirv");
+    wined3d_shader_cache_key_update_string(key, vkd3d_shader_get_version(NULL, NULL));
+    wined3d_shader_cache_key_update(key, shader_desc->byte_code, shader_desc->byte_code_size);
+    wined3d_shader_cache_key_update(key, &shader_type, sizeof(shader_type));
+    /* Compute shaders have no compile arguments. */
+    if (args)
+        wined3d_shader_cache_key_update(key, args, sizeof(*args));
+    else
+        wined3d_shader_cache_key_update_string(key, NULL);
+    wined3d_shader_cache_key_update(key, bindings->bindings, bindings->binding_count * sizeof(*bindings->bindings));
+    wined3d_shader_cache_key_update(key, bindings->uav_counters,
+            bindings->uav_counter_count * sizeof(*bindings->uav_counters));
+
+    wined3d_shader_cache_key_update_so_desc(key, so_desc);
+}
+
 static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *context_vk,
         const struct wined3d_shader_desc *shader_desc, enum wined3d_shader_type shader_type,
         const struct shader_spirv_compile_arguments *args, const struct shader_spirv_resource_bindings *bindings,
@@ -313,13 +334,27 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
     VkShaderModuleCreateInfo shader_create_info;
     struct vkd3d_shader_compile_info info;
     const struct wined3d_vk_info *vk_info;
+    struct wined3d_shader_cache_key key;
     struct wined3d_device_vk *device_vk;
     struct vkd3d_shader_code spirv;
+    bool cache = false;
     VkShaderModule module;
+    void *cached = NULL;
     char *messages;
     VkResult vr;
     int ret;
 
+    if (wined3d_shader_cache_enabled())
+    {
+        shader_spirv_get_cache_key(&key, shader_desc, shader_type, args, bindings, so_desc);
+        if ((cached = wined3d_shader_cache_load(&key, &spirv.size)))
+        {
+            spirv.code = cached;
+            goto create_module;
+        }
+        cache = true;
+    }
+
     shader_spirv_init_shader_interface_vk(&iface, bindings, so_desc);
     shader_spirv_init_compile_args(&compile_args, &iface.vkd3d_interface,
             VKD3D_SHADER_SPIRV_ENVIRONMENT_VULKAN_1_0, shader_type, args);
@@ -356,6 +391,10 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
         return VK_NULL_HANDLE;
     }
 
+    if (cache)
+        wined3d_shader_cache_store(&key, spirv.code, spirv.size);
+
+create_module:
     device_vk = wined3d_device_vk(context_vk->c.device);
     vk_info = &device_vk->vk_info;
 
@@ -364,15 +403,19 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
     shader_create_info.flags = 0;
     shader_create_info.codeSize = spirv.size;
     shader_create_info.pCode = spirv.code;
-    if ((vr = VK_CALL(vkCreateShaderModule(device_vk->vk_device, &shader_create_info, NULL, &module))) < 0)
-    {
+    vr = VK_CALL(vkCreateShaderModule(device_vk->vk_device, &shader_create_info, NULL, &module));
+
+    if (cached)
+        heap_free(cached);
+    else
         vkd3d_shader_free_shader_code(&spirv);
+
+    if (vr < 0)
+    {
         WARN("Failed to create Vulkan shader module, vr %s.\n", wined3d_debug_vkresult(vr));
         return VK_NULL_HANDLE;
     }
 
-    vkd3d_shader_free_shader_code(&spirv);
-
     return module;
 }
 
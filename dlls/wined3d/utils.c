@@ -27,6 +27,9 @@
 #include "config.h"
 
 #include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "wined3d_private.h"
 
@@ -762,6 +765,215 @@ struct wined3d_format_texture_info
             unsigned int width, unsigned int height, unsigned int depth);
 };
 
+#ifdef __SSE2__
+/* SSE2 versions of the inner loops of the upload conversions below. Each of
+ * these converts as many texels of a row as fit in whole vectors and returns
+ * the number of texels it converted; the caller converts the remaining ones
+ * with the scalar code. The results are identical to the scalar code. */
+
+static unsigned int convert_l4a4_unorm_sse2(const BYTE *src, WORD *dst, unsigned int width)
+{
+    const __m128i l_mask = _mm_set1_epi16(0x000f), a_mask = _mm_set1_epi16(0x00f0);
+    const __m128i zero = _mm_setzero_si128();
+    unsigned int x;
+
+    for (x = 0; x + 16 <= width; x += 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i lo = _mm_unpacklo_epi8(c, zero), hi = _mm_unpackhi_epi8(c, zero);
+
+        lo = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(lo, a_mask), 8), _mm_slli_epi16(_mm_and_si128(lo, l_mask), 4));
+        hi = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(hi, a_mask), 8), _mm_slli_epi16(_mm_and_si128(hi, l_mask), 4));
+        _mm_storeu_si128((__m128i *)&dst[x], lo);
+        _mm_storeu_si128((__m128i *)&dst[x + 8], hi);
+    }
+
+    return x;
+}
+
+static unsigned int convert_r5g5_snorm_l6_unorm_sse2(const WORD *src, WORD *dst, unsigned int width)
+{
+    const __m128i mask = _mm_set1_epi16(0x001f), bias = _mm_set1_epi16(16);
+    unsigned int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i r = _mm_add_epi16(_mm_and_si128(c, mask), bias);
+        __m128i g = _mm_add_epi16(_mm_and_si128(_mm_srli_epi16(c, 5), mask), bias);
+        __m128i l = _mm_srli_epi16(c, 10);
+
+        c = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(l, 5)), g);
+        _mm_storeu_si128((__m128i *)&dst[x], c);
+    }
+
+    return x;
+}
+
+static __m128i convert_r5g5_snorm_l6_unorm_ext_sse2_4(__m128i c)
+{
+    const __m128i mask = _mm_set1_epi32(0x1f), sign = _mm_set1_epi32(0x10), zero = _mm_setzero_si128();
+    __m128i r = _mm_and_si128(c, mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(c, 5), mask);
+    __m128i l = _mm_srli_epi32(c, 10);
+
+    /* Replicate the high bits into the low bits for positive values. */
+    r = _mm_or_si128(_mm_slli_epi32(r, 3),
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(r, sign), zero), _mm_srli_epi32(r, 1)));
+    g = _mm_or_si128(_mm_slli_epi32(g, 3),
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(g, sign), zero), _mm_srli_epi32(g, 1)));
+    l = _mm_or_si128(_mm_slli_epi32(l, 1), _mm_srli_epi32(l, 5));
+
+    return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_slli_epi32(l, 16));
+}
+
+static unsigned int convert_r5g5_snorm_l6_unorm_ext_sse2(const WORD *src, DWORD *dst, unsigned int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    unsigned int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+
+        _mm_storeu_si128((__m128i *)&dst[x], convert_r5g5_snorm_l6_unorm_ext_sse2_4(_mm_unpacklo_epi16(c, zero)));
+        _mm_storeu_si128((__m128i *)&dst[x + 4], convert_r5g5_snorm_l6_unorm_ext_sse2_4(_mm_unpackhi_epi16(c, zero)));
+    }
+
+    return x;
+}
+
+static unsigned int convert_r8g8_snorm_l8x8_unorm_sse2(const DWORD *src, DWORD *dst, unsigned int width)
+{
+    const __m128i byte_mask = _mm_set1_epi32(0xff), alpha_mask = _mm_set1_epi32(0xff000000);
+    const __m128i bias = _mm_set1_epi32(0x8080);
+    unsigned int x;
+
+    /* The alpha channel of the destination is left untouched. */
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[x]), bias);
+        __m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i *)&dst[x]), alpha_mask);
+
+        d = _mm_or_si128(d, _mm_and_si128(_mm_srli_epi32(c, 16), byte_mask));
+        d = _mm_or_si128(d, _mm_and_si128(c, _mm_set1_epi32(0xff00)));
+        d = _mm_or_si128(d, _mm_slli_epi32(_mm_and_si128(c, byte_mask), 16));
+        _mm_storeu_si128((__m128i *)&dst[x], d);
+    }
+
+    return x;
+}
+
+static unsigned int convert_r8g8_snorm_l8x8_unorm_nv_sse2(const DWORD *src, DWORD *dst, unsigned int width)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_or_si128(c, alpha));
+    }
+
+    return x;
+}
+
+static unsigned int convert_r8g8b8a8_snorm_sse2(const DWORD *src, DWORD *dst, unsigned int width)
+{
+    const __m128i byte_mask = _mm_set1_epi32(0xff), ga_mask = _mm_set1_epi32(0xff00ff00);
+    const __m128i bias = _mm_set1_epi32(0x80808080);
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[x]), bias);
+        __m128i d = _mm_and_si128(c, ga_mask);
+
+        d = _mm_or_si128(d, _mm_and_si128(_mm_srli_epi32(c, 16), byte_mask));
+        d = _mm_or_si128(d, _mm_slli_epi32(_mm_and_si128(c, byte_mask), 16));
+        _mm_storeu_si128((__m128i *)&dst[x], d);
+    }
+
+    return x;
+}
+
+/* Equivalent to float_24_to_32(), but constructs the result directly from the
+ * sign, exponent and mantissa bits. */
+static __m128 float_24_to_32_sse2(__m128i in)
+{
+    const __m128i m_mask = _mm_set1_epi32(0x7ffff), e_mask = _mm_set1_epi32(0x780000);
+    const __m128i inf_exponent = _mm_set1_epi32(0x780000), zero = _mm_setzero_si128();
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(in, _mm_set1_epi32(0x800000)), 8);
+    __m128i m = _mm_and_si128(in, m_mask);
+    __m128i e = _mm_and_si128(in, e_mask);
+    __m128i normal, denormal, special, is_zero_e, is_inf_e, is_nan;
+
+    /* Rebias the exponent from 7 to 127. */
+    normal = _mm_or_si128(_mm_add_epi32(_mm_slli_epi32(e, 4), _mm_set1_epi32(120 << 23)), _mm_slli_epi32(m, 4));
+    denormal = _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(m), _mm_set1_ps(1.0f / 33554432.0f)));
+    is_nan = _mm_andnot_si128(_mm_cmpeq_epi32(m, zero), _mm_set1_epi32(~0u));
+    special = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x7fc00000)),
+            _mm_andnot_si128(is_nan, _mm_or_si128(sign, _mm_set1_epi32(0x7f800000))));
+
+    is_zero_e = _mm_cmpeq_epi32(e, zero);
+    is_inf_e = _mm_cmpeq_epi32(e, inf_exponent);
+    normal = _mm_or_si128(normal, sign);
+    denormal = _mm_or_si128(denormal, sign);
+
+    normal = _mm_or_si128(_mm_and_si128(is_zero_e, denormal), _mm_andnot_si128(is_zero_e, normal));
+    return _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(is_inf_e, special), _mm_andnot_si128(is_inf_e, normal)));
+}
+
+static unsigned int convert_s8_uint_d24_float_sse2(const DWORD *src, DWORD *dst, unsigned int width)
+{
+    const __m128i stencil_mask = _mm_set1_epi32(0xff);
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i d = _mm_castps_si128(float_24_to_32_sse2(_mm_srli_epi32(c, 8)));
+        __m128i s = _mm_and_si128(c, stencil_mask);
+
+        _mm_storeu_si128((__m128i *)&dst[x * 2], _mm_unpacklo_epi32(d, s));
+        _mm_storeu_si128((__m128i *)&dst[x * 2 + 4], _mm_unpackhi_epi32(d, s));
+    }
+
+    return x;
+}
+
+static unsigned int x8_d24_unorm_upload_sse2(const DWORD *src, DWORD *dst, unsigned int width)
+{
+    const __m128i byte_mask = _mm_set1_epi32(0xff);
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+
+        c = _mm_or_si128(_mm_slli_epi32(c, 8), _mm_and_si128(_mm_srli_epi32(c, 16), byte_mask));
+        _mm_storeu_si128((__m128i *)&dst[x], c);
+    }
+
+    return x;
+}
+
+static unsigned int x8_d24_unorm_download_sse2(const DWORD *src, DWORD *dst, unsigned int width)
+{
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_srli_epi32(c, 8));
+    }
+
+    return x;
+}
+#endif
+
 static void convert_l4a4_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, UINT src_slice_pitch,
         UINT dst_row_pitch, UINT dst_slice_pitch, UINT width, UINT height, UINT depth)
 {
@@ -779,7 +991,13 @@ static void convert_l4a4_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, U
         {
             Source = src + z * src_slice_pitch + y * src_row_pitch;
             Dest = dst + z * dst_slice_pitch + y * dst_row_pitch;
-            for (x = 0; x < width; x++ )
+            x = 0;
+#ifdef __SSE2__
+            x = convert_l4a4_unorm_sse2(Source, (WORD *)Dest, width);
+            Source += x;
+            Dest += x * 2;
+#endif
+            for (; x < width; x++ )
             {
                 unsigned char color = (*Source++);
                 /* A */ Dest[1] = (color & 0xf0u) << 0;
@@ -808,7 +1026,13 @@ static void convert_r5g5_snorm_l6_unorm(const BYTE *src, BYTE *dst, UINT src_row
         {
             texel_out = (unsigned short *) (dst + z * dst_slice_pitch + y * dst_row_pitch);
             texel_in = (const unsigned short *)(src + z * src_slice_pitch + y * src_row_pitch);
-            for (x = 0; x < width; x++ )
+            x = 0;
+#ifdef __SSE2__
+            x = convert_r5g5_snorm_l6_unorm_sse2(texel_in, texel_out, width);
+            texel_in += x;
+            texel_out += x;
+#endif
+            for (; x < width; x++ )
             {
                 l_in = (*texel_in & 0xfc00u) >> 10;
                 g_in = (*texel_in & 0x03e0u) >> 5;
@@ -835,7 +1059,13 @@ static void convert_r5g5_snorm_l6_unorm_ext(const BYTE *src, BYTE *dst, UINT src
         {
             texel_in = (const unsigned short *)(src + z * src_slice_pitch + y * src_row_pitch);
             texel_out = dst + z * dst_slice_pitch + y * dst_row_pitch;
-            for (x = 0; x < width; x++ )
+            x = 0;
+#ifdef __SSE2__
+            x = convert_r5g5_snorm_l6_unorm_ext_sse2(texel_in, (DWORD *)texel_out, width);
+            texel_in += x;
+            texel_out += x * 4;
+#endif
+            for (; x < width; x++ )
             {
                 l_in = (*texel_in & 0xfc00u) >> 10;
                 g_in = (*texel_in & 0x03e0u) >> 5;
@@ -949,7 +1179,13 @@ static void convert_r8g8_snorm_l8x8_unorm(const BYTE *src, BYTE *dst, UINT src_r
         {
             Source = (const DWORD *)(src + z * src_slice_pitch + y * src_row_pitch);
             Dest = dst + z * dst_slice_pitch + y * dst_row_pitch;
-            for (x = 0; x < width; x++ )
+            x = 0;
+#ifdef __SSE2__
+            x = convert_r8g8_snorm_l8x8_unorm_sse2(Source, (DWORD *)Dest, width);
+            Source += x;
+            Dest += x * 4;
+#endif
+            for (; x < width; x++ )
             {
                 LONG color = (*Source++);
                 /* B */ Dest[0] = ((color >> 16) & 0xff);       /* L */
@@ -977,7 +1213,13 @@ static void convert_r8g8_snorm_l8x8_unorm_nv(const BYTE *src, BYTE *dst, UINT sr
         {
             Source = (const DWORD *)(src + z * src_slice_pitch + y * src_row_pitch);
             Dest = dst + z * dst_slice_pitch + y * dst_row_pitch;
-            for (x = 0; x < width; x++ )
+            x = 0;
+#ifdef __SSE2__
+            x = convert_r8g8_snorm_l8x8_unorm_nv_sse2(Source, (DWORD *)Dest, width);
+            Source += x;
+            Dest += x * 4;
+#endif
+            for (; x < width; x++ )
             {
                 LONG color = (*Source++);
                 /* L */ Dest[2] = ((color >> 16) & 0xff);   /* L */
@@ -1003,7 +1245,13 @@ static void convert_r8g8b8a8_snorm(const BYTE *src, BYTE *dst, UINT src_row_pitc
         {
             Source = (const DWORD *)(src + z * src_slice_pitch + y * src_row_pitch);
             Dest = dst + z * dst_slice_pitch + y * dst_row_pitch;
-            for (x = 0; x < width; x++ )
+            x = 0;
+#ifdef __SSE2__
+            x = convert_r8g8b8a8_snorm_sse2(Source, (DWORD *)Dest, width);
+            Source += x;
+            Dest += x * 4;
+#endif
+            for (; x < width; x++ )
             {
                 LONG color = (*Source++);
                 /* B */ Dest[0] = ((color >> 16) & 0xff) + 128; /* W */
@@ -1108,7 +1356,11 @@ static void convert_s8_uint_d24_float(const BYTE *src, BYTE *dst, UINT src_row_p
             float *dest_f = (float *)(dst + z * dst_slice_pitch + y * dst_row_pitch);
             DWORD *dest_s = (DWORD *)dest_f;
 
-            for (x = 0; x < width; ++x)
+            x = 0;
+#ifdef __SSE2__
+            x = convert_s8_uint_d24_float_sse2(source, dest_s, width);
+#endif
+            for (; x < width; ++x)
             {
                 dest_f[x * 2] = float_24_to_32((source[x] & 0xffffff00u) >> 8);
                 dest_s[x * 2 + 1] = source[x] & 0xff;
@@ -1131,7 +1383,11 @@ static void x8_d24_unorm_upload(const BYTE *src, BYTE *dst,
             const DWORD *source = (const DWORD *)(src + z * src_slice_pitch + y * src_row_pitch);
             DWORD *dest = (DWORD *)(dst + z * dst_slice_pitch + y * dst_row_pitch);
 
-            for (x = 0; x < width; ++x)
+            x = 0;
+#ifdef __SSE2__
+            x = x8_d24_unorm_upload_sse2(source, dest, width);
+#endif
+            for (; x < width; ++x)
             {
                 dest[x] = source[x] << 8 | ((source[x] >> 16) & 0xff);
             }
@@ -1153,7 +1409,11 @@ static void x8_d24_unorm_download(const BYTE *src, BYTE *dst,
             const DWORD *source = (const DWORD *)(src + z * src_slice_pitch + y * src_row_pitch);
             DWORD *dest = (DWORD *)(dst + z * dst_slice_pitch + y * dst_row_pitch);
 
-            for (x = 0; x < width; ++x)
+            x = 0;
+#ifdef __SSE2__
+            x = x8_d24_unorm_download_sse2(source, dest, width);
+#endif
+            for (; x < width; ++x)
             {
                 dest[x] = source[x] >> 8;
             }
@@ -1169,6 +1429,105 @@ static BOOL color_in_range(const struct wined3d_color_key *color_key, DWORD colo
             && color <= color_key->color_space_high_value;
 }
 
+#ifdef __SSE2__
+/* Returns a mask of the 32-bit lanes of "c" for which color_in_range() is
+ * TRUE. SSE2 only has signed comparisons, so flip the sign bits first. */
+static __m128i color_in_range_sse2(__m128i c, __m128i low, __m128i high)
+{
+    c = _mm_xor_si128(c, _mm_set1_epi32(0x80000000));
+    return _mm_andnot_si128(_mm_or_si128(_mm_cmplt_epi32(c, low), _mm_cmpgt_epi32(c, high)), _mm_set1_epi32(~0u));
+}
+
+/* Same as color_in_range_sse2(), for 16-bit lanes. */
+static __m128i color_in_range_16_sse2(__m128i c, __m128i low, __m128i high)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    return _mm_packs_epi32(color_in_range_sse2(_mm_unpacklo_epi16(c, zero), low, high),
+            color_in_range_sse2(_mm_unpackhi_epi16(c, zero), low, high));
+}
+
+static unsigned int convert_b5g6r5_unorm_b5g5r5a1_unorm_color_key_sse2(const WORD *src, WORD *dst,
+        unsigned int width, const struct wined3d_color_key *color_key)
+{
+    const __m128i alpha = _mm_set1_epi16(0x8000);
+    const __m128i low = _mm_set1_epi32(color_key->color_space_low_value ^ 0x80000000);
+    const __m128i high = _mm_set1_epi32(color_key->color_space_high_value ^ 0x80000000);
+    unsigned int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i d = _mm_or_si128(_mm_srli_epi16(_mm_and_si128(c, _mm_set1_epi16(0xffc0)), 1),
+                _mm_and_si128(c, _mm_set1_epi16(0x001f)));
+
+        d = _mm_or_si128(d, _mm_andnot_si128(color_in_range_16_sse2(c, low, high), alpha));
+        _mm_storeu_si128((__m128i *)&dst[x], d);
+    }
+
+    return x;
+}
+
+static unsigned int convert_b5g5r5x1_unorm_b5g5r5a1_unorm_color_key_sse2(const WORD *src, WORD *dst,
+        unsigned int width, const struct wined3d_color_key *color_key)
+{
+    const __m128i alpha = _mm_set1_epi16(0x8000);
+    const __m128i low = _mm_set1_epi32(color_key->color_space_low_value ^ 0x80000000);
+    const __m128i high = _mm_set1_epi32(color_key->color_space_high_value ^ 0x80000000);
+    unsigned int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i d = _mm_andnot_si128(alpha, c);
+
+        d = _mm_or_si128(d, _mm_andnot_si128(color_in_range_16_sse2(c, low, high), alpha));
+        _mm_storeu_si128((__m128i *)&dst[x], d);
+    }
+
+    return x;
+}
+
+static unsigned int convert_b8g8r8x8_unorm_b8g8r8a8_unorm_color_key_sse2(const DWORD *src, DWORD *dst,
+        unsigned int width, const struct wined3d_color_key *color_key)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i low = _mm_set1_epi32(color_key->color_space_low_value ^ 0x80000000);
+    const __m128i high = _mm_set1_epi32(color_key->color_space_high_value ^ 0x80000000);
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i d = _mm_andnot_si128(alpha, c);
+
+        d = _mm_or_si128(d, _mm_andnot_si128(color_in_range_sse2(c, low, high), alpha));
+        _mm_storeu_si128((__m128i *)&dst[x], d);
+    }
+
+    return x;
+}
+
+static unsigned int convert_b8g8r8a8_unorm_b8g8r8a8_unorm_color_key_sse2(const DWORD *src, DWORD *dst,
+        unsigned int width, const struct wined3d_color_key *color_key)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i low = _mm_set1_epi32(color_key->color_space_low_value ^ 0x80000000);
+    const __m128i high = _mm_set1_epi32(color_key->color_space_high_value ^ 0x80000000);
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+
+        c = _mm_andnot_si128(_mm_and_si128(color_in_range_sse2(c, low, high), alpha), c);
+        _mm_storeu_si128((__m128i *)&dst[x], c);
+    }
+
+    return x;
+}
+#endif
+
 static void convert_b5g6r5_unorm_b5g5r5a1_unorm_color_key(const BYTE *src, unsigned int src_pitch,
         BYTE *dst, unsigned int dst_pitch, unsigned int width, unsigned int height,
         const struct wined3d_color_key *color_key)
@@ -1181,7 +1540,11 @@ static void convert_b5g6r5_unorm_b5g5r5a1_unorm_color_key(const BYTE *src, unsig
     {
         src_row = (WORD *)&src[src_pitch * y];
         dst_row = (WORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef __SSE2__
+        x = convert_b5g6r5_unorm_b5g5r5a1_unorm_color_key_sse2(src_row, dst_row, width, color_key);
+#endif
+        for (; x < width; ++x)
         {
             WORD src_color = src_row[x];
             if (!color_in_range(color_key, src_color))
@@ -1204,7 +1567,11 @@ static void convert_b5g5r5x1_unorm_b5g5r5a1_unorm_color_key(const BYTE *src, uns
     {
         src_row = (WORD *)&src[src_pitch * y];
         dst_row = (WORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef __SSE2__
+        x = convert_b5g5r5x1_unorm_b5g5r5a1_unorm_color_key_sse2(src_row, dst_row, width, color_key);
+#endif
+        for (; x < width; ++x)
         {
             WORD src_color = src_row[x];
             if (color_in_range(color_key, src_color))
@@ -1248,7 +1615,11 @@ static void convert_b8g8r8x8_unorm_b8g8r8a8_unorm_color_key(const BYTE *src, uns
     {
         src_row = (DWORD *)&src[src_pitch * y];
         dst_row = (DWORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef __SSE2__
+        x = convert_b8g8r8x8_unorm_b8g8r8a8_unorm_color_key_sse2(src_row, dst_row, width, color_key);
+#endif
+        for (; x < width; ++x)
         {
             DWORD src_color = src_row[x];
             if (color_in_range(color_key, src_color))
@@ -1271,7 +1642,11 @@ static void convert_b8g8r8a8_unorm_b8g8r8a8_unorm_color_key(const BYTE *src, uns
     {
         src_row = (DWORD *)&src[src_pitch * y];
         dst_row = (DWORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef __SSE2__
+        x = convert_b8g8r8a8_unorm_b8g8r8a8_unorm_color_key_sse2(src_row, dst_row, width, color_key);
+#endif
+        for (; x < width; ++x)
         {
             DWORD src_color = src_row[x];
             if (color_in_range(color_key, src_color))
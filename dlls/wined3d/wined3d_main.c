@@ -110,6 +110,7 @@ CRITICAL_SECTION wined3d_command_cs = {&wined3d_command_cs_debug, -1, 0, 0, 0, 0
 struct wined3d_settings wined3d_settings =
 {
     .cs_multithreaded = WINED3D_CSMT_ENABLE,
+    .cs_spin_count = WINED3D_CS_SPIN_COUNT,
     .max_gl_version = MAKEDWORD_VERSION(4, 4),
     .offscreen_rendering_mode = ORM_FBO,
     .pci_vendor_id = PCI_VENDOR_NONE,
@@ -265,6 +266,8 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
     {
         if (!get_config_key_dword(hkey, appkey, "csmt", &wined3d_settings.cs_multithreaded))
             ERR_(winediag)("Setting multithreaded command stream to %#x.\n", wined3d_settings.cs_multithreaded);
+        if (!get_config_key_dword(hkey, appkey, "csmt_spin_count", &wined3d_settings.cs_spin_count))
+            ERR_(winediag)("Setting command stream spin count to %u.\n", wined3d_settings.cs_spin_count);
         if (!get_config_key_dword(hkey, appkey, "MaxVersionGL", &tmpvalue))
         {
             ERR_(winediag)("Setting maximum allowed wined3d GL version to %u.%u.\n",
@@ -398,6 +401,17 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             TRACE("Forcing all constant buffers to be write-mappable.\n");
             wined3d_settings.cb_access_map_w = TRUE;
         }
+        if (!get_config_key(hkey, appkey, "shader_cache_path", buffer, size) && *buffer)
+        {
+            size_t len = strlen(buffer) + 1;
+
+            if (!(wined3d_settings.shader_cache_path = heap_alloc(len)))
+                ERR("Failed to allocate shader cache path memory.\n");
+            else
+                memcpy(wined3d_settings.shader_cache_path, buffer, len);
+        }
+        if (!get_config_key_dword(hkey, appkey, "shader_cache_size", &wined3d_settings.shader_cache_size))
+            TRACE("Enabling the shader cache, limited to %u MiB.\n", wined3d_settings.shader_cache_size);
     }
 
     if (appkey) RegCloseKey( appkey );
@@ -412,6 +426,7 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     unsigned int i;
 
     wined3d_spirv_shader_backend_cleanup();
+    wined3d_shader_cache_cleanup();
 
     if (!TlsFree(wined3d_context_tls_idx))
     {
@@ -440,6 +455,7 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     heap_free(swapchain_state_table.hooks);
 
     heap_free(wined3d_settings.logo);
+    heap_free(wined3d_settings.shader_cache_path);
     UnregisterClassA(WINED3D_OPENGL_WINDOW_CLASS_NAME, hInstDLL);
 
     DeleteCriticalSection(&wined3d_command_cs);
@@ -477,6 +477,7 @@ enum wined3d_shader_backend
 struct wined3d_settings
 {
     unsigned int cs_multithreaded;
+    unsigned int cs_spin_count;
     DWORD max_gl_version;
     int offscreen_rendering_mode;
     unsigned short pci_vendor_id;
@@ -497,6 +498,8 @@ struct wined3d_settings
     enum wined3d_renderer renderer;
     enum wined3d_shader_backend shader_backend;
     BOOL cb_access_map_w;
+    char *shader_cache_path;
+    unsigned int shader_cache_size;
 };
 
 extern struct wined3d_settings wined3d_settings DECLSPEC_HIDDEN;
@@ -1540,6 +1543,23 @@ extern const struct wined3d_shader_backend_ops none_shader_backend DECLSPEC_HIDD
 const struct wined3d_shader_backend_ops *wined3d_spirv_shader_backend_init_vk(void) DECLSPEC_HIDDEN;
 void wined3d_spirv_shader_backend_cleanup(void) DECLSPEC_HIDDEN;
 
+struct wined3d_shader_cache_key
+{
+    uint64_t hash[2];
+};
+
+void wined3d_shader_cache_cleanup(void) DECLSPEC_HIDDEN;
+bool wined3d_shader_cache_enabled(void) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_key_init(struct wined3d_shader_cache_key *key, const char *backend) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_key_update(struct wined3d_shader_cache_key *key,
+        const void *data, size_t size) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_key_update_so_desc(struct wined3d_shader_cache_key *key,
+        const struct wined3d_stream_output_desc *so_desc) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_key_update_string(struct wined3d_shader_cache_key *key, const char *str) DECLSPEC_HIDDEN;
+void *wined3d_shader_cache_load(const struct wined3d_shader_cache_key *key, size_t *size) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_store(const struct wined3d_shader_cache_key *key,
+        const void *data, size_t size) DECLSPEC_HIDDEN;
+
 #define GL_EXTCALL(f) (gl_info->gl_ops.ext.p_##f)
 
 #define D3DCOLOR_B_R(dw) (((dw) >> 16) & 0xff)
@@ -3845,6 +3865,32 @@ struct wined3d_so_desc_entry
     struct wined3d_stream_output_element elements[1];
 };
 
+enum wined3d_redundant_state
+{
+    WINED3D_REDUNDANT_SHADER,
+    WINED3D_REDUNDANT_CONSTANT_BUFFERS,
+    WINED3D_REDUNDANT_BLEND_STATE,
+    WINED3D_REDUNDANT_DEPTH_STENCIL_STATE,
+    WINED3D_REDUNDANT_RASTERIZER_STATE,
+    WINED3D_REDUNDANT_VIEWPORTS,
+    WINED3D_REDUNDANT_SCISSOR_RECTS,
+    WINED3D_REDUNDANT_SHADER_RESOURCE_VIEWS,
+    WINED3D_REDUNDANT_SAMPLERS,
+    WINED3D_REDUNDANT_UNORDERED_ACCESS_VIEWS,
+    WINED3D_REDUNDANT_PREDICATION,
+    WINED3D_REDUNDANT_STREAM_SOURCES,
+    WINED3D_REDUNDANT_INDEX_BUFFER,
+    WINED3D_REDUNDANT_VERTEX_DECLARATION,
+    WINED3D_REDUNDANT_STREAM_OUTPUTS,
+    WINED3D_REDUNDANT_SHADER_CONSTANTS,
+    WINED3D_REDUNDANT_TRANSFORM,
+    WINED3D_REDUNDANT_RENDER_STATE,
+    WINED3D_REDUNDANT_SAMPLER_STATE,
+    WINED3D_REDUNDANT_TEXTURE_STATE,
+    WINED3D_REDUNDANT_TEXTURE,
+    WINED3D_REDUNDANT_COUNT,
+};
+
 struct wined3d_device
 {
     LONG ref;
@@ -3913,6 +3959,10 @@ struct wined3d_device
     /* Context management */
     struct wined3d_context **contexts;
     UINT context_count;
+
+    /* Number of state changes dropped because they matched the current
+     * state. Only counted when the d3d_perf channel is enabled. */
+    LONG redundant_state_count[WINED3D_REDUNDANT_COUNT];
 };
 
 void wined3d_device_cleanup(struct wined3d_device *device) DECLSPEC_HIDDEN;
@@ -4844,13 +4894,37 @@ enum wined3d_push_constants
 };
 
 #define WINED3D_CS_QUERY_POLL_INTERVAL  10u
-#define WINED3D_CS_QUEUE_SIZE           0x100000u
-#define WINED3D_CS_SPIN_COUNT           10000000u
+#define WINED3D_CS_QUEUE_CHUNK_SIZE     0x40000u
+#define WINED3D_CS_QUEUE_INITIAL_CHUNKS 4u
+#define WINED3D_CS_QUEUE_MAX_CHUNKS     64u
+#define WINED3D_CS_SPIN_COUNT           50000u
 
+struct wined3d_cs_queue_chunk
+{
+    SLIST_ENTRY entry;
+    struct wined3d_cs_queue_chunk *next;
+    BYTE data[WINED3D_CS_QUEUE_CHUNK_SIZE];
+};
+
+/* Packets are written to a linked list of chunks. Chunks the CS thread is
+ * done with are reused, and new ones are allocated, up to
+ * WINED3D_CS_QUEUE_MAX_CHUNKS, while it is behind. "head" and "tail" count
+ * the bytes submitted and executed so far. */
 struct wined3d_cs_queue
 {
     LONG head, tail;
-    BYTE data[WINED3D_CS_QUEUE_SIZE];
+    LONG waiting_for_space;
+
+    /* Only accessed by the submitting thread. */
+    struct wined3d_cs_queue_chunk *write_chunk;
+    SIZE_T write_offset;
+    /* Only accessed by the CS thread. */
+    struct wined3d_cs_queue_chunk *read_chunk;
+    SIZE_T read_offset;
+
+    SLIST_HEADER free_chunks;
+    struct wined3d_cs_queue_chunk *chunks[WINED3D_CS_QUEUE_MAX_CHUNKS];
+    unsigned int chunk_count;
 };
 
 struct wined3d_device_context_ops
@@ -4899,9 +4973,12 @@ struct wined3d_cs
     struct list query_poll_list;
     BOOL queries_flushed;
 
-    HANDLE event;
     BOOL waiting_for_event;
     LONG pending_presents;
+
+    /* Time spent waiting, in performance counter ticks. */
+    LONG64 producer_stall_time;
+    LONG64 consumer_idle_time;
 };
 
 static inline void wined3d_device_context_lock(struct wined3d_device_context *context)
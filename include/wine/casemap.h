@@ -0,0 +1,71 @@
+/*
+ * Case-insensitive string comparison helpers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_WINE_CASEMAP_H
+#define __WINE_WINE_CASEMAP_H
+
+#ifdef __SSE2__
+#include <x86intrin.h>
+#endif
+
+/* Return the number of leading characters of the two strings that are plain ASCII
+ * and equal ignoring case. The caller then only needs to go through the case mapping
+ * tables starting from the first non-ASCII or mismatched character, which gives the
+ * same result since the tables map ASCII characters only to other ASCII characters. */
+static inline unsigned int casemap_ascii_prefix( const WCHAR *str1, const WCHAR *str2, unsigned int len )
+{
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    const __m128i non_ascii = _mm_set1_epi16( (short)0xff80 );
+    const __m128i upper_min = _mm_set1_epi16( 'A' - 1 );
+    const __m128i upper_max = _mm_set1_epi16( 'Z' + 1 );
+    const __m128i case_bit = _mm_set1_epi16( 0x20 );
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i a = _mm_loadu_si128( (const __m128i *)(str1 + i) );
+        __m128i b = _mm_loadu_si128( (const __m128i *)(str2 + i) );
+        __m128i ascii = _mm_cmpeq_epi16( _mm_and_si128( _mm_or_si128( a, b ), non_ascii ), zero );
+        __m128i upper_a = _mm_and_si128( _mm_cmpgt_epi16( a, upper_min ), _mm_cmplt_epi16( a, upper_max ));
+        __m128i upper_b = _mm_and_si128( _mm_cmpgt_epi16( b, upper_min ), _mm_cmplt_epi16( b, upper_max ));
+        __m128i eq;
+        unsigned int mask;
+
+        a = _mm_or_si128( a, _mm_and_si128( upper_a, case_bit ));
+        b = _mm_or_si128( b, _mm_and_si128( upper_b, case_bit ));
+        eq = _mm_and_si128( _mm_cmpeq_epi16( a, b ), ascii );
+        if ((mask = _mm_movemask_epi8( eq )) != 0xffff)
+            return i + __builtin_ctz( ~mask ) / 2;
+    }
+#endif
+
+    for (; i < len; i++)
+    {
+        WCHAR ch1 = str1[i], ch2 = str2[i];
+
+        if ((ch1 | ch2) >= 0x80) break;
+        if (ch1 >= 'A' && ch1 <= 'Z') ch1 += 'a' - 'A';
+        if (ch2 >= 'A' && ch2 <= 'Z') ch2 += 'a' - 'A';
+        if (ch1 != ch2) break;
+    }
+    return i;
+}
+
+#endif  /* __WINE_WINE_CASEMAP_H */
@@ -283,7 +283,6 @@ static void create_user_shared_data(void)
     NtQuerySystemInformation( SystemCpuInformation, &sci, sizeof(sci), NULL );
 
     data->TickCountMultiplier         = 1 << 24;
-    data->LargePageMinimum            = 2 * 1024 * 1024;
     data->NtBuildNumber               = version.dwBuildNumber;
     data->NtProductType               = version.wProductType;
     data->ProductTypeIsValid          = TRUE;
@@ -1103,6 +1103,23 @@ int get_page_size(void)
     return page_mask + 1;
 }
 
+/* size of the transparent huge pages that the client uses for large page allocations */
+static unsigned int get_large_page_minimum(void)
+{
+    unsigned long size = 0;
+#ifdef __linux__
+    FILE *f;
+
+    if ((f = fopen( "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r" )))
+    {
+        if (fscanf( f, "%lu", &size ) != 1) size = 0;
+        fclose( f );
+    }
+    if (size & (size - 1)) size = 0;
+#endif
+    return size;
+}
+
 struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                          unsigned int attr, const struct security_descriptor *sd )
 {
@@ -1116,6 +1133,7 @@ struct object *create_user_data_mapping( struct object *root, const struct unico
     {
         user_shared_data = ptr;
         user_shared_data->SystemCall = 1;
+        user_shared_data->LargePageMinimum = get_large_page_minimum();
     }
     return &mapping->obj;
 }
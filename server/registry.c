@@ -33,6 +33,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -86,9 +87,13 @@ struct key
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
     struct key      **subkeys;     /* subkeys array */
+    struct key      **subkey_hash; /* hash index of the subkeys, for keys with many subkeys */
+    unsigned int      subkey_hash_size; /* size of the hash index (power of 2) */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    unsigned int     *value_hash;  /* hash index of the values (index + 1, 0 if free), for keys with many values */
+    unsigned int      value_hash_size; /* size of the hash index (power of 2) */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
@@ -102,6 +107,7 @@ struct key
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
 #define KEY_PREDEF   0x0040  /* key is marked as predefined */
+#define KEY_CHANGED  0x0080  /* key itself has been modified since the last save */
 
 /* a key value */
 struct key_value
@@ -114,7 +120,9 @@ struct key_value
 };
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
+#define MIN_HASHED_SUBKEYS 64  /* min. number of subkeys to build a hash index */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_HASHED_VALUES 64  /* min. number of values to build a hash index */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -140,8 +148,59 @@ struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *journal;       /* path of the journal of changes not yet saved to the main file */
+    char        *snapshot;      /* path of the binary snapshot of the main file */
+    off_t        file_size;     /* size of the main file when it was last saved */
+    off_t        journal_size;  /* size of the valid part of the journal */
+    struct list  deleted;       /* keys deleted since the last save */
+    int          compact;       /* the journal can't be used, save the full branch next time */
 };
 
+/* a key deleted since the last save */
+struct deleted_key
+{
+    struct list  entry;
+    data_size_t  len;           /* length of the path relative to the branch */
+    WCHAR        path[1];
+};
+
+#define MIN_JOURNAL_COMPACT (256 * 1024)  /* min. journal size before it is merged into the main file */
+
+/* binary snapshot of a registry file, used to avoid parsing the text file on startup */
+/* the header is followed by the branch key, each key by its values and then its subkeys */
+#define SNAPSHOT_VERSION 2
+
+struct snapshot_header
+{
+    char           magic[8];     /* "WINEREG\0" */
+    unsigned int   version;      /* SNAPSHOT_VERSION */
+    unsigned int   prefix_type;  /* prefix type at the time of the save */
+    file_pos_t     file_size;    /* size of the text file this is a snapshot of */
+    file_pos_t     file_inode;   /* inode of the text file */
+    timeout_t      file_mtime;   /* modification time of the text file, in nanoseconds */
+    file_pos_t     data_size;    /* size of the data following the header */
+};
+
+struct snapshot_key
+{
+    timeout_t      modif;        /* modification time */
+    unsigned int   nb_subkeys;   /* number of subkeys following the values */
+    unsigned int   nb_values;    /* number of values following the name and class */
+    unsigned short namelen;      /* length of the name following the header */
+    unsigned short classlen;     /* length of the class following the name */
+    unsigned int   flags;        /* KEY_SYMLINK */
+};
+
+struct snapshot_value
+{
+    unsigned int   type;         /* value type */
+    data_size_t    len;          /* length of the data following the name */
+    unsigned short namelen;      /* length of the name following the header */
+    unsigned short pad;
+};
+
+static const char snapshot_magic[8] = "WINEREG";
+
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
@@ -160,6 +219,7 @@ struct file_load_info
     int         line;     /* current input line */
     WCHAR      *tmp;      /* temp buffer to use while parsing input */
     size_t      tmplen;   /* length of temp buffer */
+    int         journal;  /* loading a journal, key sections replace the existing key contents */
 };
 
 
@@ -276,6 +336,25 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* save a single key and its values to a text file */
+static void save_key( const struct key *key, const struct key *base, FILE *f )
+{
+    int i;
+
+    fprintf( f, "\n[" );
+    if (key != base) dump_path( key, base, f );
+    fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+    if (key->class)
+    {
+        fprintf( f, "#class=\"" );
+        dump_strW( key->class, key->classlen, f, "\"\"" );
+        fprintf( f, "\"\n" );
+    }
+    if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+    for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+}
+
 /* save a registry and all its subkeys to a text file */
 static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
 {
@@ -285,23 +364,21 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
-    {
-        fprintf( f, "\n[" );
-        if (key != base) dump_path( key, base, f );
-        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
-        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
-        if (key->class)
-        {
-            fprintf( f, "#class=\"" );
-            dump_strW( key->class, key->classlen, f, "\"\"" );
-            fprintf( f, "\"\n" );
-        }
-        if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
-        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
-    }
+        save_key( key, base, f );
     for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
 }
 
+/* save the keys modified since the last save to a journal file */
+static void save_changed_subkeys( const struct key *key, const struct key *base, FILE *f )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(key->flags & KEY_DIRTY)) return;
+    if (key->flags & KEY_CHANGED) save_key( key, base, f );
+    for (i = 0; i <= key->last_subkey; i++) save_changed_subkeys( key->subkeys[i], base, f );
+}
+
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
 {
     fprintf( stderr, "%s key ", op );
@@ -461,12 +538,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free( key->value_hash );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_hash );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -529,9 +608,13 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
         key->subkeys     = NULL;
+        key->subkey_hash = NULL;
+        key->subkey_hash_size = 0;
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->value_hash  = NULL;
+        key->value_hash_size = 0;
         key->modif       = modif;
         key->parent      = NULL;
         list_init( &key->notify_list );
@@ -562,7 +645,7 @@ static void make_clean( struct key *key )
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    key->flags &= ~(KEY_DIRTY | KEY_CHANGED);
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
@@ -586,6 +669,7 @@ static void touch_key( struct key *key, unsigned int change )
 
     key->modif = current_time;
     make_dirty( key );
+    if (!(key->flags & KEY_VOLATILE)) key->flags |= KEY_CHANGED;
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -618,12 +702,55 @@ static int grow_subkeys( struct key *key )
     return 1;
 }
 
+/* add a subkey to the hash index, which must have a free slot */
+static void hash_subkey( struct key *key, struct key *subkey )
+{
+    unsigned int i = hash_strW( subkey->name, subkey->namelen, key->subkey_hash_size );
+
+    while (key->subkey_hash[i]) i = (i + 1) & (key->subkey_hash_size - 1);
+    key->subkey_hash[i] = subkey;
+}
+
+/* build the subkey hash index with room for at least twice the current number of subkeys */
+static void build_subkey_hash( struct key *key )
+{
+    unsigned int size = MIN_HASHED_SUBKEYS * 2;
+    int i;
+
+    while (size < (key->last_subkey + 1) * 4) size *= 2;
+    free( key->subkey_hash );
+    key->subkey_hash_size = 0;
+    /* without an index we fall back to the binary search */
+    if (!(key->subkey_hash = calloc( size, sizeof(*key->subkey_hash) ))) return;
+    key->subkey_hash_size = size;
+    for (i = 0; i <= key->last_subkey; i++) hash_subkey( key, key->subkeys[i] );
+}
+
+/* remove a subkey from the hash index */
+static void unhash_subkey( struct key *key, struct key *subkey )
+{
+    unsigned int mask = key->subkey_hash_size - 1;
+    unsigned int i, j, home;
+
+    i = hash_strW( subkey->name, subkey->namelen, key->subkey_hash_size );
+    while (key->subkey_hash[i] != subkey) i = (i + 1) & mask;
+
+    /* move back the following entries of the probe sequence that would no longer be reachable */
+    for (j = (i + 1) & mask; key->subkey_hash[j]; j = (j + 1) & mask)
+    {
+        home = hash_strW( key->subkey_hash[j]->name, key->subkey_hash[j]->namelen, key->subkey_hash_size );
+        if (((j - home) & mask) < ((j - i) & mask)) continue;
+        key->subkey_hash[i] = key->subkey_hash[j];
+        i = j;
+    }
+    key->subkey_hash[i] = NULL;
+}
+
 /* allocate a subkey for a given key, and return its index */
 static struct key *alloc_subkey( struct key *parent, const struct unicode_str *name,
                                  int index, timeout_t modif )
 {
     struct key *key;
-    int i;
 
     if (name->len > MAX_NAME_LEN * sizeof(WCHAR))
     {
@@ -638,9 +765,13 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
-        for (i = ++parent->last_subkey; i > index; i--)
-            parent->subkeys[i] = parent->subkeys[i-1];
+        memmove( parent->subkeys + index + 1, parent->subkeys + index,
+                 (++parent->last_subkey - index) * sizeof(*parent->subkeys) );
         parent->subkeys[index] = key;
+        if (parent->subkey_hash && (parent->last_subkey + 1) * 2 <= parent->subkey_hash_size)
+            hash_subkey( parent, key );
+        else if (parent->last_subkey + 1 >= MIN_HASHED_SUBKEYS)
+            build_subkey_hash( parent );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -651,13 +782,24 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
 static void free_subkey( struct key *parent, int index )
 {
     struct key *key;
-    int i, nb_subkeys;
+    int nb_subkeys;
 
     assert( index >= 0 );
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
-    for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    if (parent->subkey_hash)
+    {
+        if (parent->last_subkey < MIN_HASHED_SUBKEYS / 2)
+        {
+            free( parent->subkey_hash );
+            parent->subkey_hash = NULL;
+            parent->subkey_hash_size = 0;
+        }
+        else unhash_subkey( parent, key );
+    }
+    memmove( parent->subkeys + index, parent->subkeys + index + 1,
+             (parent->last_subkey - index) * sizeof(*parent->subkeys) );
     parent->last_subkey--;
     key->flags |= KEY_DELETED;
     key->parent = NULL;
@@ -678,7 +820,7 @@ static void free_subkey( struct key *parent, int index )
 }
 
 /* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+static struct key *find_subkey_index( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
@@ -703,6 +845,25 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     return NULL;
 }
 
+/* find the named child of a given key */
+/* index is only set when the child is not found, to the position where it should be inserted */
+static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+{
+    struct key *subkey;
+    unsigned int i;
+
+    if (!key->subkey_hash) return find_subkey_index( key, name, index );
+
+    for (i = hash_strW( name->str, name->len, key->subkey_hash_size );
+         (subkey = key->subkey_hash[i]);
+         i = (i + 1) & (key->subkey_hash_size - 1))
+    {
+        if (subkey->namelen == name->len && !memicmp_strW( subkey->name, name->str, name->len ))
+            return subkey;
+    }
+    return find_subkey_index( key, name, index );
+}
+
 /* return the wow64 variant of the key, or the key itself if none */
 static struct key *find_wow64_subkey( struct key *key, const struct unicode_str *name )
 {
@@ -860,7 +1021,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 
     if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
     if (options & REG_OPTION_VOLATILE) key->flags |= KEY_VOLATILE;
-    else key->flags |= KEY_DIRTY;
+    else key->flags |= KEY_DIRTY | KEY_CHANGED;
 
     if (sd) default_set_sd( &key->obj, sd, OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION |
                             DACL_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION );
@@ -878,7 +1039,9 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 }
 
 /* recursively create a subkey (for internal use only) */
-static struct key *create_key_recursive( struct key *key, const struct unicode_str *name, timeout_t modif )
+/* the last element is followed if it's a symlink unless follow_last is 0 */
+static struct key *create_key_recursive( struct key *key, const struct unicode_str *name, timeout_t modif,
+                                         int follow_last )
 {
     struct key *base;
     int index;
@@ -891,12 +1054,12 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
         struct key *subkey;
         if (!(subkey = find_subkey( key, &token, &index ))) break;
         key = subkey;
-        if (!(key = follow_symlink( key, 0 )))
+        get_path_token( name, &token );
+        if ((token.len || follow_last) && !(key = follow_symlink( key, 0 )))
         {
             set_error( STATUS_OBJECT_NAME_NOT_FOUND );
             return NULL;
         }
-        get_path_token( name, &token );
     }
 
     if (token.len)
@@ -1017,11 +1180,54 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
     if (debug_level > 1) dump_operation( key, NULL, "Enum" );
 }
 
+/* find the saved branch that contains a key */
+static struct save_branch_info *find_save_branch( const struct key *key )
+{
+    int i;
+
+    for (key = key->parent; key; key = key->parent)
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key) return &save_branch_info[i];
+    return NULL;
+}
+
+/* remember a key deletion so that it can be written to the branch journal */
+static void journal_deleted_key( const struct key *key )
+{
+    static const WCHAR backslash = '\\';
+    struct save_branch_info *info;
+    struct deleted_key *deleted;
+    const struct key *k;
+    data_size_t len = 0;
+    char *p;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(info = find_save_branch( key ))) return;
+
+    for (k = key; k != info->key; k = k->parent) len += k->namelen + sizeof(WCHAR);
+    len -= sizeof(WCHAR);
+    if (!(deleted = malloc( offsetof( struct deleted_key, path[len / sizeof(WCHAR)] ))))
+    {
+        info->compact = 1;  /* make sure the deletion isn't lost */
+        return;
+    }
+    deleted->len = len;
+    p = (char *)deleted->path + len;
+    for (k = key; k != info->key; k = k->parent)
+    {
+        p -= k->namelen;
+        memcpy( p, k->name, k->namelen );
+        if (k->parent != info->key) memcpy( p -= sizeof(WCHAR), &backslash, sizeof(WCHAR) );
+    }
+    list_add_tail( &info->deleted, &deleted->entry );
+}
+
 /* delete a key and its values */
 static int delete_key( struct key *key, int recurse )
 {
     int index;
     struct key *parent = key->parent;
+    struct unicode_str name;
 
     /* must find parent and index */
     if (key == root_key)
@@ -1041,9 +1247,10 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    name.str = key->name;
+    name.len = key->namelen;
+    find_subkey_index( parent, &name, &index );
+    assert( parent->subkeys[index] == key );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1053,6 +1260,7 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    journal_deleted_key( key );
     free_subkey( parent, index );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 0;
@@ -1083,8 +1291,73 @@ static int grow_values( struct key *key )
     return 1;
 }
 
+/* add a value to the hash index, which must have a free slot */
+static void hash_value( struct key *key, int index )
+{
+    const struct key_value *value = &key->values[index];
+    unsigned int i = hash_strW( value->name, value->namelen, key->value_hash_size );
+
+    while (key->value_hash[i]) i = (i + 1) & (key->value_hash_size - 1);
+    key->value_hash[i] = index + 1;
+}
+
+/* build the value hash index with room for at least twice the current number of values */
+static void build_value_hash( struct key *key )
+{
+    unsigned int size = MIN_HASHED_VALUES * 2;
+    int i;
+
+    while (size < (key->last_value + 1) * 4) size *= 2;
+    free( key->value_hash );
+    key->value_hash_size = 0;
+    /* without an index we fall back to the binary search */
+    if (!(key->value_hash = calloc( size, sizeof(*key->value_hash) ))) return;
+    key->value_hash_size = size;
+    for (i = 0; i <= key->last_value; i++) hash_value( key, i );
+}
+
+/* remove a value from the hash index */
+static void unhash_value( struct key *key, int index )
+{
+    unsigned int mask = key->value_hash_size - 1;
+    unsigned int i, j, home;
+    const struct key_value *value;
+
+    value = &key->values[index];
+    i = hash_strW( value->name, value->namelen, key->value_hash_size );
+    while (key->value_hash[i] != index + 1) i = (i + 1) & mask;
+
+    /* move back the following entries of the probe sequence that would no longer be reachable */
+    for (j = (i + 1) & mask; key->value_hash[j]; j = (j + 1) & mask)
+    {
+        value = &key->values[key->value_hash[j] - 1];
+        home = hash_strW( value->name, value->namelen, key->value_hash_size );
+        if (((j - home) & mask) < ((j - i) & mask)) continue;
+        key->value_hash[i] = key->value_hash[j];
+        i = j;
+    }
+    key->value_hash[i] = 0;
+}
+
+/* adjust the hash index after the values starting at index have moved by delta */
+static void shift_value_hash( struct key *key, int index, int delta )
+{
+    unsigned int i;
+
+    for (i = 0; i < key->value_hash_size; i++)
+        if (key->value_hash[i] > (unsigned int)index) key->value_hash[i] += delta;
+}
+
+/* free the value hash index */
+static void free_value_hash( struct key *key )
+{
+    free( key->value_hash );
+    key->value_hash = NULL;
+    key->value_hash_size = 0;
+}
+
 /* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
+static struct key_value *find_value_index( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
@@ -1109,12 +1382,33 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     return NULL;
 }
 
+/* find the named value of a given key and return its index in the array */
+static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
+{
+    struct key_value *value;
+    unsigned int i;
+
+    if (!key->value_hash) return find_value_index( key, name, index );
+
+    for (i = hash_strW( name->str, name->len, key->value_hash_size );
+         key->value_hash[i];
+         i = (i + 1) & (key->value_hash_size - 1))
+    {
+        value = &key->values[key->value_hash[i] - 1];
+        if (value->namelen == name->len && !memicmp_strW( value->name, name->str, name->len ))
+        {
+            *index = key->value_hash[i] - 1;
+            return value;
+        }
+    }
+    return find_value_index( key, name, index );
+}
+
 /* insert a new value; the index must have been returned by find_value */
 static struct key_value *insert_value( struct key *key, const struct unicode_str *name, int index )
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
@@ -1126,12 +1420,19 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         if (!grow_values( key )) return NULL;
     }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
-    for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
+    memmove( key->values + index + 1, key->values + index, (++key->last_value - index) * sizeof(*key->values) );
     value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (key->value_hash && (key->last_value + 1) * 2 <= key->value_hash_size)
+    {
+        shift_value_hash( key, index, 1 );
+        hash_value( key, index );
+    }
+    else if (key->last_value + 1 >= MIN_HASHED_VALUES)
+        build_value_hash( key );
     return value;
 }
 
@@ -1276,7 +1577,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 static void delete_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
-    int i, index, nb_values;
+    int index, nb_values;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1290,10 +1591,16 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    if (key->value_hash)
+    {
+        if (key->last_value < MIN_HASHED_VALUES / 2) free_value_hash( key );
+        else unhash_value( key, index );
+    }
     free( value->name );
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
+    memmove( key->values + index, key->values + index + 1, (key->last_value - index) * sizeof(*key->values) );
     key->last_value--;
+    if (key->value_hash) shift_value_hash( key, index + 1, -1 );
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
@@ -1458,7 +1765,27 @@ static struct key *load_key( struct key *base, const char *buffer, int prefix_le
     }
     name.str = p;
     name.len = len - (p - info->tmp + 1) * sizeof(WCHAR);
-    return create_key_recursive( base, &name, 0 );
+    /* a journal may reload a symlink key itself, so don't follow it */
+    return create_key_recursive( base, &name, 0, !info->journal );
+}
+
+/* clear the contents of a key before reloading it from a journal */
+static void reset_key( struct key *key )
+{
+    int i;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    key->last_value = -1;
+    free_value_hash( key );
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+    key->flags &= ~KEY_SYMLINK;
+    key->modif = 0;
 }
 
 /* update the modification time of a key (and its parents) after it has been loaded from a file */
@@ -1688,7 +2015,7 @@ static int get_prefix_len( struct key *key, const char *name, struct file_load_i
 
 /* load all the keys from the input file */
 /* prefix_len is the number of key name prefixes to skip, or -1 for autodetection */
-static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len )
+static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len, int journal )
 {
     struct key *subkey = NULL;
     struct file_load_info info;
@@ -1700,6 +2027,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     info.len    = 4;
     info.tmplen = 4;
     info.line   = 0;
+    info.journal = journal;
     if (!(info.buffer = mem_alloc( info.len ))) return;
     if (!(info.tmp = mem_alloc( info.tmplen )))
     {
@@ -1729,6 +2057,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
             if (prefix_len == -1) prefix_len = get_prefix_len( key, p + 1, &info );
             if (!(subkey = load_key( key, p + 1, prefix_len, &info, &modif )))
                 file_read_error( "Error creating key", &info );
+            else if (journal) reset_key( subkey );
             break;
         case '@':   /* default value */
         case '\"':  /* value */
@@ -1736,7 +2065,13 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
             else file_read_error( "Value without key", &info );
             break;
         case '#':   /* option */
-            if (subkey) load_key_option( subkey, p, &info );
+            if (subkey && journal && !strcmp( p, "#deleted" ))
+            {
+                delete_key( subkey, 1 );
+                release_object( subkey );
+                subkey = NULL;
+            }
+            else if (subkey) load_key_option( subkey, p, &info );
             else if (!load_global_option( p, &info )) goto done;
             break;
         case ';':   /* comment */
@@ -1772,33 +2107,389 @@ static void load_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "r" );
         if (f)
         {
-            load_keys( key, NULL, f, -1 );
+            struct save_branch_info *info;
+
+            load_keys( key, NULL, f, -1, 0 );
             fclose( f );
+            /* the loaded keys are not marked as changed, they can only be saved with the full branch */
+            if ((info = find_save_branch( key ))) info->compact = 1;
         }
         else file_set_error();
     }
 }
 
+/* return the modification time of a file in nanoseconds */
+static timeout_t get_file_mtime( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return (timeout_t)st->st_mtime * 1000000000 + st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return (timeout_t)st->st_mtime * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    return (timeout_t)st->st_mtime * 1000000000;
+#endif
+}
+
+/* check that a journal was written on top of the main file described by st */
+/* the journal starts with the size, inode and modification time of the main file at the time */
+static int is_journal_base( int fd, const struct stat *st )
+{
+    static const char header[] = "WINE REGISTRY Version 2\n#base=";
+    char buffer[sizeof(header) + 64];
+    unsigned long long size, inode, mtime;
+    ssize_t ret;
+
+    if ((ret = pread( fd, buffer, sizeof(buffer) - 1, 0 )) < (ssize_t)sizeof(header) - 1) return 0;
+    buffer[ret] = 0;
+    if (memcmp( buffer, header, sizeof(header) - 1 )) return 0;
+    if (sscanf( buffer + sizeof(header) - 1, "%llx,%llx,%llx\n", &size, &inode, &mtime ) != 3) return 0;
+    return size == st->st_size && inode == st->st_ino && mtime == get_file_mtime( st );
+}
+
+/* return the size of the journal up to the end of the last complete set of changes */
+static off_t get_journal_valid_size( int fd )
+{
+    static const char marker[] = "\n#commit\n";
+    char buffer[65536];
+    off_t pos = 0, size = 0;
+    unsigned int match = 0;
+    ssize_t i, ret;
+
+    while ((ret = read( fd, buffer, sizeof(buffer) )) > 0)
+    {
+        for (i = 0; i < ret; i++)
+        {
+            if (buffer[i] == marker[match]) match++;
+            else match = (buffer[i] == '\n');
+            if (match < sizeof(marker) - 1) continue;
+            size = pos + i + 1;
+            match = 1;
+        }
+        pos += ret;
+    }
+    return size;
+}
+
+/* replay the changes from a branch journal that didn't make it to the main file */
+static void load_journal( struct save_branch_info *info, const struct stat *file_st )
+{
+    FILE *f;
+    int fd;
+
+    if ((fd = open( info->journal, O_RDWR )) == -1) return;
+
+    /* discard a partially written set of changes, and journals of a previous version of the main file */
+    if (is_journal_base( fd, file_st ))
+        info->journal_size = get_journal_valid_size( fd );
+    if (!info->journal_size || ftruncate( fd, info->journal_size ) == -1 ||
+        lseek( fd, 0, SEEK_SET ) == -1 || !(f = fdopen( fd, "r" )))
+    {
+        close( fd );
+        unlink( info->journal );
+        info->journal_size = 0;
+        return;
+    }
+
+    load_keys( info->key, info->journal, f, 0, 1 );
+    fclose( f );
+    if (get_error() == STATUS_NOT_REGISTRY_FILE)
+    {
+        fprintf( stderr, "%s is not a valid registry journal\n", info->journal );
+        info->compact = 1;
+        clear_error();
+    }
+    make_clean( info->key );
+}
+
+/* save a key and its subkeys to a binary snapshot */
+static void save_snapshot_key( const struct key *key, FILE *f )
+{
+    struct snapshot_key hdr;
+    struct snapshot_value val;
+    int i;
+
+    hdr.modif      = key->modif;
+    hdr.nb_subkeys = 0;
+    hdr.nb_values  = key->last_value + 1;
+    hdr.namelen    = key->namelen;
+    hdr.classlen   = key->class ? key->classlen : 0;
+    hdr.flags      = key->flags & KEY_SYMLINK;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) hdr.nb_subkeys++;
+
+    fwrite( &hdr, sizeof(hdr), 1, f );
+    fwrite( key->name, hdr.namelen, 1, f );
+    fwrite( key->class, hdr.classlen, 1, f );
+    for (i = 0; i <= key->last_value; i++)
+    {
+        const struct key_value *value = &key->values[i];
+
+        val.type    = value->type;
+        val.len     = value->len;
+        val.namelen = value->namelen;
+        val.pad     = 0;
+        fwrite( &val, sizeof(val), 1, f );
+        fwrite( value->name, value->namelen, 1, f );
+        fwrite( value->data, value->len, 1, f );
+    }
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) save_snapshot_key( key->subkeys[i], f );
+}
+
+/* save a binary snapshot of a branch matching the text file described by st */
+static void save_snapshot( struct save_branch_info *info, const struct stat *st )
+{
+    struct snapshot_header header;
+    char *tmp;
+    FILE *f;
+    int ret;
+
+    if (!info->snapshot) return;
+    if (!(tmp = malloc( strlen( info->snapshot ) + sizeof(".tmp") ))) return;
+    sprintf( tmp, "%s.tmp", info->snapshot );
+
+    if (!(f = fopen( tmp, "wb" )))
+    {
+        free( tmp );
+        return;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    fwrite( &header, sizeof(header), 1, f );
+    save_snapshot_key( info->key, f );
+
+    memcpy( header.magic, snapshot_magic, sizeof(header.magic) );
+    header.version     = SNAPSHOT_VERSION;
+    header.prefix_type = prefix_type;
+    header.file_size   = st->st_size;
+    header.file_inode  = st->st_ino;
+    header.file_mtime  = get_file_mtime( st );
+    header.data_size   = ftell( f ) - sizeof(header);
+    /* write the header last so that an incomplete snapshot is never considered valid */
+    ret = !fflush( f ) && !fseek( f, 0, SEEK_SET ) && fwrite( &header, sizeof(header), 1, f ) == 1;
+    if (fclose( f )) ret = 0;
+
+    if (!ret || rename( tmp, info->snapshot ))
+    {
+        unlink( tmp );
+        unlink( info->snapshot );
+    }
+    free( tmp );
+}
+
+/* copy data from a snapshot */
+static int read_snapshot_data( const char **ptr, const char *end, void *data, size_t size )
+{
+    if ((size_t)(end - *ptr) < size) return 0;
+    memcpy( data, *ptr, size );
+    *ptr += size;
+    return 1;
+}
+
+/* check that a name stored in a snapshot sorts after the previous one, as the lookups expect */
+static int is_snapshot_name_after( const WCHAR *prev, data_size_t prev_len, const WCHAR *name, data_size_t len )
+{
+    int res = memicmp_strW( prev, name, min( prev_len, len ));
+
+    if (!res) res = prev_len - len;
+    return res < 0;
+}
+
+/* load the contents of a key from a snapshot, the key name has already been read */
+static int load_snapshot_key( struct key *key, const struct snapshot_key *hdr, const char **ptr, const char *end )
+{
+    struct snapshot_key sub_hdr;
+    struct snapshot_value val;
+    struct unicode_str name;
+    struct key_value *value;
+    struct key *subkey;
+    unsigned int i;
+
+    key->modif = hdr->modif;
+    key->flags |= hdr->flags & KEY_SYMLINK;
+    if (hdr->classlen)
+    {
+        if ((size_t)(end - *ptr) < hdr->classlen) return 0;
+        if (!(key->class = memdup( *ptr, hdr->classlen ))) return 0;
+        key->classlen = hdr->classlen;
+        *ptr += hdr->classlen;
+    }
+
+    /* the arrays are allocated with their final size, no need to grow them */
+    if (hdr->nb_values)
+    {
+        if (hdr->nb_values > (size_t)(end - *ptr) / sizeof(val)) return 0;
+        key->nb_values = max( hdr->nb_values, MIN_VALUES );
+        if (!(key->values = mem_alloc( key->nb_values * sizeof(*key->values) ))) return 0;
+        for (i = 0; i < hdr->nb_values; i++)
+        {
+            if (!read_snapshot_data( ptr, end, &val, sizeof(val) )) return 0;
+            if (val.namelen > MAX_VALUE_LEN * sizeof(WCHAR) || val.namelen % sizeof(WCHAR)) return 0;
+            if ((size_t)(end - *ptr) < (size_t)val.namelen + val.len) return 0;
+            if (key->last_value >= 0 &&
+                !is_snapshot_name_after( key->values[key->last_value].name, key->values[key->last_value].namelen,
+                                         (const WCHAR *)*ptr, val.namelen )) return 0;
+            value = &key->values[++key->last_value];
+            value->name    = NULL;
+            value->namelen = val.namelen;
+            value->type    = val.type;
+            value->len     = val.len;
+            value->data    = NULL;
+            if (val.namelen && !(value->name = memdup( *ptr, val.namelen ))) return 0;
+            *ptr += val.namelen;
+            if (val.len && !(value->data = memdup( *ptr, val.len ))) return 0;
+            *ptr += val.len;
+        }
+        if (key->last_value + 1 >= MIN_HASHED_VALUES) build_value_hash( key );
+    }
+
+    if (hdr->nb_subkeys)
+    {
+        if (hdr->nb_subkeys > (size_t)(end - *ptr) / sizeof(sub_hdr)) return 0;
+        key->nb_subkeys = max( hdr->nb_subkeys, MIN_SUBKEYS );
+        if (!(key->subkeys = mem_alloc( key->nb_subkeys * sizeof(*key->subkeys) ))) return 0;
+        for (i = 0; i < hdr->nb_subkeys; i++)
+        {
+            if (!read_snapshot_data( ptr, end, &sub_hdr, sizeof(sub_hdr) )) return 0;
+            if (!sub_hdr.namelen || sub_hdr.namelen > MAX_NAME_LEN * sizeof(WCHAR)) return 0;
+            if (sub_hdr.namelen % sizeof(WCHAR) || sub_hdr.classlen % sizeof(WCHAR)) return 0;
+            if ((size_t)(end - *ptr) < sub_hdr.namelen) return 0;
+            name.str = (const WCHAR *)*ptr;
+            name.len = sub_hdr.namelen;
+            if (key->last_subkey >= 0 &&
+                !is_snapshot_name_after( key->subkeys[key->last_subkey]->name, key->subkeys[key->last_subkey]->namelen,
+                                         name.str, name.len )) return 0;
+            *ptr += sub_hdr.namelen;
+            if (!(subkey = alloc_key( &name, sub_hdr.modif ))) return 0;
+            subkey->parent = key;
+            key->subkeys[++key->last_subkey] = subkey;
+            if (is_wow6432node( subkey->name, subkey->namelen ) && !is_wow6432node( key->name, key->namelen ))
+                key->flags |= KEY_WOW64;
+            if (!load_snapshot_key( subkey, &sub_hdr, ptr, end )) return 0;
+        }
+        if (key->last_subkey + 1 >= MIN_HASHED_SUBKEYS) build_subkey_hash( key );
+    }
+    return 1;
+}
+
+/* load a branch from its binary snapshot if it matches the text file described by st */
+static int load_snapshot( struct save_branch_info *info, const struct stat *st )
+{
+    struct snapshot_header header;
+    struct snapshot_key hdr;
+    struct stat snap_st;
+    struct key *key = info->key;
+    const char *ptr, *end;
+    void *map;
+    int fd, ret = 0;
+
+    if (!info->snapshot) return 0;
+    if (key->last_subkey >= 0 || key->last_value >= 0) return 0;
+    if ((fd = open( info->snapshot, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &snap_st ) || snap_st.st_size < sizeof(header))
+    {
+        close( fd );
+        return 0;
+    }
+    map = mmap( NULL, snap_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (map == MAP_FAILED) return 0;
+
+    ptr = map;
+    end = ptr + snap_st.st_size;
+    read_snapshot_data( &ptr, end, &header, sizeof(header) );
+    if (memcmp( header.magic, snapshot_magic, sizeof(header.magic) )) goto done;
+    if (header.version != SNAPSHOT_VERSION) goto done;
+    if (header.file_size != st->st_size || header.file_inode != st->st_ino) goto done;
+    if (header.file_mtime != get_file_mtime( st )) goto done;
+    if (header.data_size != snap_st.st_size - sizeof(header)) goto done;
+    if (header.prefix_type != PREFIX_UNKNOWN && prefix_type != PREFIX_UNKNOWN &&
+        header.prefix_type != prefix_type) goto done;
+
+    if (!read_snapshot_data( &ptr, end, &hdr, sizeof(hdr) )) goto done;
+    if ((size_t)(end - ptr) < hdr.namelen) goto done;
+    ptr += hdr.namelen;  /* the branch key already exists */
+    ret = load_snapshot_key( key, &hdr, &ptr, end ) && ptr == end;
+
+    if (ret)
+    {
+        if (prefix_type == PREFIX_UNKNOWN) prefix_type = header.prefix_type;
+    }
+    else
+    {
+        fprintf( stderr, "%s: invalid registry snapshot, ignoring it\n", info->snapshot );
+        while (key->last_subkey >= 0) free_subkey( key, key->last_subkey );
+        reset_key( key );
+        key->modif = current_time;
+        clear_error();
+    }
+
+done:
+    munmap( map, snap_st.st_size );
+    return ret;
+}
+
+/* build the path of a file associated with a registry branch */
+static char *get_branch_file( const char *path, const char *ext )
+{
+    char *ret;
+
+    if ((ret = malloc( strlen( path ) + strlen( ext ) + 1 )))
+    {
+        strcpy( ret, path );
+        strcat( ret, ext );
+    }
+    return ret;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *info;
+    struct stat st;
     FILE *f;
 
+    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+
+    info = &save_branch_info[save_branch_count];
+    info->path = filename;
+    info->key = key;
+    info->journal = get_branch_file( filename, ".journal" );
+    info->snapshot = get_branch_file( filename, ".snapshot" );
+    info->file_size = 0;
+    info->journal_size = 0;
+    info->compact = !info->journal;
+    list_init( &info->deleted );
+
     if ((f = fopen( filename, "r" )))
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        if (fstat( fileno( f ), &st )) memset( &st, 0, sizeof(st) );
+        if (!load_snapshot( info, &st ))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            load_keys( key, filename, f, 0, 0 );
+            if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            {
+                fprintf( stderr, "%s is not a valid registry file\n", filename );
+                fclose( f );
+                free( info->journal );
+                free( info->snapshot );
+                return 1;
+            }
+            save_snapshot( info, &st );
         }
+        fclose( f );
+        info->file_size = st.st_size;
+        if (info->journal) load_journal( info, &st );
+    }
+    else
+    {
+        /* a journal is only loaded together with its main file */
+        if (info->journal) unlink( info->journal );
+        info->compact = 1;
     }
 
-    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
-
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    save_branch_count++;
+    grab_object( key );
     make_object_permanent( &key->obj );
     return (f != NULL);
 }
@@ -1886,7 +2577,7 @@ void init_registry(void)
 
     /* load system.reg into Registry\Machine */
 
-    if (!(hklm = create_key_recursive( root_key, &HKLM_name, current_time )))
+    if (!(hklm = create_key_recursive( root_key, &HKLM_name, current_time, 1 )))
         fatal_error( "could not create Machine registry key\n" );
 
     if (!load_init_registry_from_file( "system.reg", hklm ))
@@ -1903,7 +2594,7 @@ void init_registry(void)
 
     /* load userdef.reg into Registry\User\.Default */
 
-    if (!(key = create_key_recursive( root_key, &HKU_name, current_time )))
+    if (!(key = create_key_recursive( root_key, &HKU_name, current_time, 1 )))
         fatal_error( "could not create User\\.Default registry key\n" );
 
     load_init_registry_from_file( "userdef.reg", key );
@@ -1914,7 +2605,7 @@ void init_registry(void)
     /* FIXME: match default user in token.c. should get from process token instead */
     current_user_path = format_user_registry_path( security_local_user_sid, &current_user_str );
     if (!current_user_path ||
-        !(hkcu = create_key_recursive( root_key, &current_user_str, current_time )))
+        !(hkcu = create_key_recursive( root_key, &current_user_str, current_time, 1 )))
         fatal_error( "could not create HKEY_CURRENT_USER registry key\n" );
     free( current_user_path );
     load_init_registry_from_file( "user.reg", hkcu );
@@ -1931,7 +2622,7 @@ void init_registry(void)
         case IMAGE_FILE_MACHINE_AMD64: name.str = classes_amd64; name.len = sizeof(classes_amd64); break;
         case IMAGE_FILE_MACHINE_ARM64: name.str = classes_arm64; name.len = sizeof(classes_arm64); break;
         }
-        if ((key = create_key_recursive( hklm, &name, current_time )))
+        if ((key = create_key_recursive( hklm, &name, current_time, 1 )))
         {
             key->flags |= KEY_WOWSHARE;
             release_object( key );
@@ -1939,7 +2630,7 @@ void init_registry(void)
         /* FIXME: handle HKCU too */
     }
 
-    if ((key = create_key_recursive( hklm, &perflib_name, current_time )))
+    if ((key = create_key_recursive( hklm, &perflib_name, current_time, 1 )))
     {
         key->flags |= KEY_PREDEF;
         release_object( key );
@@ -2018,20 +2709,94 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* forget about the keys deleted since the last save */
+static void free_deleted_keys( struct save_branch_info *info )
+{
+    struct deleted_key *deleted, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( deleted, next, &info->deleted, struct deleted_key, entry )
+    {
+        list_remove( &deleted->entry );
+        free( deleted );
+    }
+}
+
+/* append the changes made since the last save to the branch journal */
+static int save_journal( struct save_branch_info *info )
+{
+    struct deleted_key *deleted;
+    struct stat st, file_st;
+    int fd, ret;
+    FILE *f;
+
+    if (!info->journal_size && stat( info->path, &file_st )) return 0;
+    if ((fd = open( info->journal, O_WRONLY | O_CREAT | O_APPEND, 0666 )) == -1) return 0;
+    if (!(f = fdopen( fd, "a" )))
+    {
+        close( fd );
+        return 0;
+    }
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->journal );
+        dump_operation( info->key, NULL, "journaling" );
+    }
+
+    if (!info->journal_size)
+    {
+        fprintf( f, "WINE REGISTRY Version 2\n" );
+        fprintf( f, "#base=%llx,%llx,%llx\n", (unsigned long long)file_st.st_size,
+                 (unsigned long long)file_st.st_ino, (unsigned long long)get_file_mtime( &file_st ) );
+        fprintf( f, ";; Changes not yet saved to %s\n", info->path );
+    }
+    LIST_FOR_EACH_ENTRY( deleted, &info->deleted, struct deleted_key, entry )
+    {
+        fprintf( f, "\n[" );
+        dump_strW( deleted->path, deleted->len, f, "[]" );
+        fprintf( f, "]\n#deleted\n" );
+    }
+    save_changed_subkeys( info->key, info->key, f );
+    fprintf( f, "\n#commit\n" );
+
+    ret = !fflush( f ) && !fstat( fd, &st );
+    if (fclose( f )) ret = 0;
+    if (!ret)
+    {
+        /* drop the incomplete changes, the full branch will be saved instead */
+        if (truncate( info->journal, info->journal_size ) == -1)
+            info->compact = 1;  /* don't append after the incomplete changes */
+        return 0;
+    }
+    info->journal_size = st.st_size;
+    free_deleted_keys( info );
+    make_clean( info->key );
+    return 1;
+}
+
 /* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+/* changes are appended to the journal unless it has grown too large or compact is set */
+static int save_branch( struct save_branch_info *info, int compact )
 {
+    struct key *key = info->key;
+    const char *path = info->path;
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
+    off_t size = 0;
     FILE *f;
 
-    if (!(key->flags & KEY_DIRTY))
+    if (!(key->flags & KEY_DIRTY) && list_empty( &info->deleted ) && !(compact && info->journal_size))
     {
         if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
         return 1;
     }
 
+    if (!compact && !info->compact &&
+        info->journal_size < max( info->file_size / 4, MIN_JOURNAL_COMPACT ) &&
+        save_journal( info ))
+        return 1;
+
     /* test the file type */
 
     if ((fd = open( path, O_WRONLY )) != -1)
@@ -2077,6 +2842,7 @@ static int save_branch( struct key *key, const char *path )
     }
 
     save_all_subkeys( key, f );
+    size = ftell( f );
     ret = !fclose(f);
 
     if (tmp)
@@ -2088,7 +2854,17 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    if (ret)
+    {
+        /* everything is in the main file now */
+        if (info->journal) unlink( info->journal );
+        if (!stat( path, &st )) save_snapshot( info, &st );
+        info->file_size = size;
+        info->journal_size = 0;
+        info->compact = 0;
+        free_deleted_keys( info );
+        make_clean( key );
+    }
     return ret;
 }
 
@@ -2100,7 +2876,7 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+        save_branch( &save_branch_info[i], 0 );
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2120,7 +2896,7 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch( &save_branch_info[i], 1 ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -35,6 +35,7 @@
 #include "request.h"
 #include "unicode.h"
 #include "file.h"
+#include "wine/casemap.h"
 
 /* number of following bytes in sequence based on first byte value (for bytes above 0x7f) */
 static const char utf8_length[128] =
@@ -70,9 +71,14 @@ static inline WCHAR to_lower( WCHAR ch )
 
 int memicmp_strW( const WCHAR *str1, const WCHAR *str2, data_size_t len )
 {
+    unsigned int prefix;
     int ret = 0;
 
-    for (len /= sizeof(WCHAR); len; str1++, str2++, len--)
+    len /= sizeof(WCHAR);
+    prefix = casemap_ascii_prefix( str1, str2, len );
+    str1 += prefix;
+    str2 += prefix;
+    for (len -= prefix; len; str1++, str2++, len--)
         if ((ret = to_lower(*str1) - to_lower(*str2))) break;
     return ret;
 }